@@ -0,0 +1,737 @@
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define BENCH_FILE "benchbuffer.bin"
+#define BENCH_PINS 1000000
+
+// thread benchmark, a concurrent CLOCK pool that holds half of the working set, so about half of
+// the pins miss
+#define THREAD_FRAMES 4096
+#define THREAD_WORKING_SET 8192
+
+// file mode benchmark, a 64MB file read through a 4MB pool, so nearly every pin reads from the file
+#define FILE_MODE_FRAMES 1024
+#define FILE_MODE_PAGES 16384
+#define FILE_MODE_PINS 100000
+
+// asynchronous pin benchmark, the file mode setup with O_DIRECT so every miss goes to the device
+#define ASYNC_PINS 20000
+#define ASYNC_MAX_DEPTH 64
+
+// background writer benchmark, the file mode setup with O_DIRECT where every other pin dirties its page
+#define WRITER_PINS 50000
+
+// checkpoint benchmark, a pool as large as the file mode file with every page dirty, loaded in random order
+#define CHECKPOINT_PAGES 16384
+
+// file growth benchmark, a jump to page GROWTH_JUMP of a new file and appending GROWTH_PAGES pages one by one
+#define GROWTH_JUMP 1000000
+#define GROWTH_PAGES 65536
+#define GROWTH_FRAMES 64
+
+// checksum benchmark, reading the file mode file from the page cache, the worst case for the relative cost of checksums
+#define CHECKSUM_ROUNDS 10
+
+// compression benchmark, file mode pages each holding COMPRESSION_RECORDS short records and zeroes for the rest
+#define COMPRESSION_RECORDS 40
+
+// group commit benchmark, every thread logs a change to its own page and flushes the log GROUP_COMMITS times
+#define BENCH_LOG "benchbuffer.log"
+#define GROUP_COMMITS 2000
+#define GROUP_DELAY_US 200
+
+typedef struct ThreadArgs {
+  BM_BufferPool *bm;
+  WAL_Log *log;
+  unsigned int seed;
+} ThreadArgs;
+
+// benchmarks
+static void benchPinLatency (int numPages);
+static void benchThreads (int numThreads);
+static void *pinWorker (void *arg);
+static void benchFileMode (char *mode, BM_PoolOptions *options);
+static void benchAsyncPins (int depth, bool asyncThreads);
+static void benchReadahead (int window);
+static void benchWriter (int dirtyTarget);
+static void benchCheckpoint (char *mode, BM_PoolOptions *options);
+static void benchGrowth (bool preallocate);
+static double benchChecksums (int createFlags);
+static void benchCompression (char *format, int createFlags);
+static void benchGroupCommit (int numThreads, int groupDelayUs);
+static void *commitWorker (void *arg);
+
+// helper methods
+static double nowNanos (void);
+static unsigned int nextRandom (unsigned int *state);
+static void dropFileCache (char *fileName);
+static long cachedBytes (char *fileName);
+static int compareDoubles (const void *a, const void *b);
+
+// main method, the arguments are the largest pool size (default 1M frames) and the largest number
+// of threads (default 32) to try. The file mode, asynchronous pin, readahead, background writer,
+// checkpoint, file growth, checksum, compression and group commit comparisons run when the third argument
+// is not 0.
+int
+main (int argc, char *argv[])
+{
+  int maxPages = (argc > 1) ? atoi(argv[1]) : (1 << 20);
+  int maxThreads = (argc > 2) ? atoi(argv[2]) : 32;
+  int fileModes = (argc > 3) ? atoi(argv[3]) : 1;
+  int numPages, numThreads;
+  double readRate, checksumRate;
+  BM_PoolOptions options = { 0 };
+
+  initStorageManager();
+
+  printf("%10s %14s %10s\n", "frames", "ns/pin+unpin", "init ms");
+  for (numPages = 16; numPages <= maxPages; numPages *= 4)
+    benchPinLatency(numPages);
+
+  printf("\n%10s %14s\n", "threads", "pins/s");
+  for (numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    benchThreads(numThreads);
+
+  if (fileModes)
+    {
+      printf("\n%10s %14s %14s %14s\n", "mode", "pins/s", "pool MB", "page cache MB");
+      benchFileMode("buffered", &options);
+      options.directIO = true;
+      benchFileMode("direct", &options);
+      options.directIO = false;
+      options.mappedFile = true;
+      benchFileMode("mmap", &options);
+
+      printf("\n%10s %14s %14s\n", "depth", "io_uring/s", "threads/s");
+      for (numThreads = 1; numThreads <= ASYNC_MAX_DEPTH; numThreads *= 4)
+	{
+	  printf("%10i", numThreads);
+	  benchAsyncPins(numThreads, false);
+	  benchAsyncPins(numThreads, true);
+	  printf("\n");
+	}
+
+      printf("\n%10s %14s\n", "readahead", "scan pins/s");
+      benchReadahead(0);
+      benchReadahead(8);
+      benchReadahead(32);
+      benchReadahead(128);
+
+      printf("\n%10s %14s %14s %14s\n", "dirty %", "pins/s", "p99 us", "max us");
+      benchWriter(0);
+      benchWriter(5);
+      benchWriter(20);
+
+      printf("\n%10s %14s %14s\n", "mode", "flush ms", "MB/s");
+      options.mappedFile = false;
+      benchCheckpoint("buffered", &options);
+      options.directIO = true;
+      benchCheckpoint("direct", &options);
+      options.directIO = false;
+
+      printf("\n%10s %14s %14s\n", "prealloc", "jump ms", "append/s");
+      benchGrowth(false);
+      benchGrowth(true);
+
+      printf("\n%10s %14s %14s\n", "checksums", "reads/s", "overhead %");
+      readRate = benchChecksums(0);
+      printf("%10s %14.0f\n", "no", readRate);
+      checksumRate = benchChecksums(SM_CREATE_CHECKSUMS);
+      printf("%10s %14.0f %14.1f\n", "yes", checksumRate, 100 * (readRate / checksumRate - 1));
+
+      printf("\n%10s %14s %14s %14s\n", "format", "file MB", "writes/s", "cold reads/s");
+      benchCompression("plain", 0);
+      benchCompression("compressed", SM_CREATE_COMPRESSED);
+
+      printf("\n%10s %14s %14s %14s\n", "threads", "delay us", "commits/s", "commits/sync");
+      for (numThreads = 1; numThreads <= 16; numThreads *= 4)
+	{
+	  benchGroupCommit(numThreads, 0);
+	  benchGroupCommit(numThreads, GROUP_DELAY_US);
+	}
+    }
+
+  return 0;
+}
+
+// fill a pool of numPages frames with numPages distinct pages and time pinning random resident pages,
+// so every pin is a hit and the latency only depends on the lookup cost
+void
+benchPinLatency (int numPages)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  unsigned int seed = 42;
+  double start, elapsed, init;
+  int i;
+
+  CHECK(createPageFile(BENCH_FILE));
+
+  start = nowNanos();
+  CHECK(initBufferPool(bm, BENCH_FILE, numPages, RS_LRU, NULL));
+  init = nowNanos() - start;
+
+  // warm up, every page gets its own frame
+  for (i = 0; i < numPages; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+
+  start = nowNanos();
+  for (i = 0; i < BENCH_PINS; i++)
+    {
+      CHECK(pinPage(bm, h, nextRandom(&seed) % numPages));
+      CHECK(unpinPage(bm, h));
+    }
+  elapsed = nowNanos() - start;
+
+  printf("%10i %14.1f %10.2f\n", numPages, elapsed / BENCH_PINS, init / 1e6);
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  free(bm);
+  free(h);
+}
+
+// every thread pins random pages of the working set, the pins/s are summed over all threads
+void
+benchThreads (int numThreads)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  pthread_t *threads = malloc(sizeof(pthread_t) * numThreads);
+  ThreadArgs *args = malloc(sizeof(ThreadArgs) * numThreads);
+  double start, elapsed;
+  int i;
+
+  CHECK(createPageFile(BENCH_FILE));
+
+  // make the file as large as the working set before the threads start
+  CHECK(initBufferPool(bm, BENCH_FILE, 1, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, THREAD_WORKING_SET - 1));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  options.concurrent = true;
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, THREAD_FRAMES, RS_CLOCK, NULL, &options));
+
+  start = nowNanos();
+  for (i = 0; i < numThreads; i++)
+    {
+      args[i].bm = bm;
+      args[i].seed = 42 + i;
+      pthread_create(&threads[i], NULL, pinWorker, &args[i]);
+    }
+  for (i = 0; i < numThreads; i++)
+    pthread_join(threads[i], NULL);
+  elapsed = nowNanos() - start;
+
+  printf("%10i %14.0f\n", numThreads, (double) numThreads * BENCH_PINS / (elapsed / 1e9));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  free(threads);
+  free(args);
+  free(bm);
+  free(h);
+}
+
+// uniform random pins over a file much larger than the pool. The pool memory is the same in all
+// modes, the buffered and mmap modes also fill the OS page cache with a second copy of the pages
+// they read.
+void
+benchFileMode (char *mode, BM_PoolOptions *options)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  unsigned int seed = 42;
+  double start, elapsed;
+  int i;
+
+  CHECK(createPageFile(BENCH_FILE));
+
+  CHECK(initBufferPool(bm, BENCH_FILE, 1, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, FILE_MODE_PAGES - 1));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  // start every mode with none of the file cached
+  dropFileCache(BENCH_FILE);
+
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, FILE_MODE_FRAMES, RS_CLOCK, NULL, options));
+
+  start = nowNanos();
+  for (i = 0; i < FILE_MODE_PINS; i++)
+    {
+      CHECK(pinPage(bm, h, nextRandom(&seed) % FILE_MODE_PAGES));
+      CHECK(unpinPage(bm, h));
+    }
+  elapsed = nowNanos() - start;
+
+  printf("%10s %14.0f %14.1f %14.1f\n", mode, FILE_MODE_PINS / (elapsed / 1e9),
+	 (double) FILE_MODE_FRAMES * PAGE_SIZE / (1 << 20), (double) cachedBytes(BENCH_FILE) / (1 << 20));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  free(bm);
+  free(h);
+}
+
+// a sequential scan over the whole file with O_DIRECT, with readahead windows up to window pages
+void
+benchReadahead (int window)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  double start, elapsed;
+  int i;
+
+  CHECK(createPageFile(BENCH_FILE));
+
+  CHECK(initBufferPool(bm, BENCH_FILE, 1, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, FILE_MODE_PAGES - 1));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  options.directIO = true;
+  options.readahead = window;
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, FILE_MODE_FRAMES, RS_CLOCK, NULL, &options));
+
+  start = nowNanos();
+  for (i = 0; i < FILE_MODE_PAGES; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  elapsed = nowNanos() - start;
+
+  printf("%10i %14.0f\n", window, FILE_MODE_PAGES / (elapsed / 1e9));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  free(bm);
+  free(h);
+}
+
+// random pins, every other one dirties its page. Without the background writer (dirtyTarget 0) a miss
+// writes its dirty victim before it reads, which shows in the tail latency.
+void
+benchWriter (int dirtyTarget)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  double *latency = malloc(sizeof(double) * WRITER_PINS);
+  unsigned int seed = 42;
+  double start, elapsed;
+  int i;
+
+  CHECK(createPageFile(BENCH_FILE));
+
+  CHECK(initBufferPool(bm, BENCH_FILE, 1, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, FILE_MODE_PAGES - 1));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  options.directIO = true;
+  options.dirtyTarget = dirtyTarget;
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, FILE_MODE_FRAMES, RS_CLOCK, NULL, &options));
+
+  elapsed = 0;
+  for (i = 0; i < WRITER_PINS; i++)
+    {
+      start = nowNanos();
+      CHECK(pinPage(bm, h, nextRandom(&seed) % FILE_MODE_PAGES));
+      latency[i] = nowNanos() - start;
+      elapsed += latency[i];
+
+      if (i % 2 == 0)
+	CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  qsort(latency, WRITER_PINS, sizeof(double), compareDoubles);
+  printf("%10i %14.0f %14.1f %14.1f\n", dirtyTarget, WRITER_PINS / (elapsed / 1e9),
+	 latency[WRITER_PINS / 100 * 99] / 1e3, latency[WRITER_PINS - 1] / 1e3);
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  free(latency);
+  free(bm);
+  free(h);
+}
+
+// dirty every page of the pool, in random order so frame order and page order differ, then time forceFlushPool
+void
+benchCheckpoint (char *mode, BM_PoolOptions *options)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int *order = malloc(sizeof(int) * CHECKPOINT_PAGES);
+  unsigned int seed = 42;
+  double start, elapsed;
+  int i, j, swap;
+
+  CHECK(createPageFile(BENCH_FILE));
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, CHECKPOINT_PAGES, RS_FIFO, NULL, options));
+
+  for (i = 0; i < CHECKPOINT_PAGES; i++)
+    order[i] = i;
+  for (i = CHECKPOINT_PAGES - 1; i > 0; i--)
+    {
+      j = nextRandom(&seed) % (i + 1);
+      swap = order[i];
+      order[i] = order[j];
+      order[j] = swap;
+    }
+
+  for (i = 0; i < CHECKPOINT_PAGES; i++)
+    {
+      CHECK(pinPage(bm, h, order[i]));
+      memset(h->data, 'x', PAGE_SIZE);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  start = nowNanos();
+  CHECK(forceFlushPool(bm));
+  elapsed = nowNanos() - start;
+
+  printf("%10s %14.1f %14.0f\n", mode, elapsed / 1e6,
+	 (double)CHECKPOINT_PAGES * PAGE_SIZE / (1 << 20) / (elapsed / 1e9));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  free(order);
+  free(bm);
+  free(h);
+}
+
+// pin a page far past the end of a new file, then append pages to another new file one at a time
+void
+benchGrowth (bool preallocate)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  double start, jump, append;
+  int i;
+
+  options.preallocate = preallocate;
+
+  CHECK(createPageFile(BENCH_FILE));
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, GROWTH_FRAMES, RS_FIFO, NULL, &options));
+  start = nowNanos();
+  CHECK(pinPage(bm, h, GROWTH_JUMP));
+  jump = nowNanos() - start;
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  CHECK(createPageFile(BENCH_FILE));
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, GROWTH_FRAMES, RS_FIFO, NULL, &options));
+  start = nowNanos();
+  for (i = 0; i < GROWTH_PAGES; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      memset(h->data, 'x', PAGE_SIZE);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(shutdownBufferPool(bm));
+  append = nowNanos() - start;
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  printf("%10s %14.1f %14.0f\n", preallocate ? "yes" : "no", jump / 1e6, GROWTH_PAGES / (append / 1e9));
+
+  free(bm);
+  free(h);
+}
+
+// write every page of a new file through the storage manager, then read it back several times and return the reads/s
+double
+benchChecksums (int createFlags)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  double start, elapsed;
+  int i, round;
+
+  ph = aligned_alloc(4096, PAGE_SIZE);
+  memset(ph, 'x', PAGE_SIZE);
+
+  CHECK(createPageFileWithFlags(BENCH_FILE, createFlags));
+  CHECK(openPageFile(BENCH_FILE, &fh));
+  CHECK(ensureCapacity(FILE_MODE_PAGES, &fh));
+  for (i = 0; i < FILE_MODE_PAGES; i++)
+    CHECK(writeBlock(i, &fh, ph));
+
+  start = nowNanos();
+  for (round = 0; round < CHECKSUM_ROUNDS; round++)
+    for (i = 0; i < FILE_MODE_PAGES; i++)
+      CHECK(readBlock(i, &fh, ph));
+  elapsed = nowNanos() - start;
+
+  CHECK(closePageFile(&fh));
+  CHECK(destroyPageFile(BENCH_FILE));
+  free(ph);
+
+  return CHECKSUM_ROUNDS * FILE_MODE_PAGES / (elapsed / 1e9);
+}
+
+// write every page of a new file with some records, then read it back with a cold page cache
+void
+benchCompression (char *format, int createFlags)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph = malloc(PAGE_SIZE);
+  double start, writeTime, readTime;
+  long size;
+  int i, record, pos, fd;
+
+  CHECK(createPageFileWithFlags(BENCH_FILE, createFlags));
+  CHECK(openPageFile(BENCH_FILE, &fh));
+  CHECK(ensureCapacity(FILE_MODE_PAGES, &fh));
+
+  start = nowNanos();
+  for (i = 0; i < FILE_MODE_PAGES; i++)
+    {
+      memset(ph, 0, PAGE_SIZE);
+      for (record = 0, pos = 0; record < COMPRESSION_RECORDS; record++)
+	pos += sprintf(ph + pos, "%08i|user%05i|%i.%02i;", i * COMPRESSION_RECORDS + record,
+		       (i * 7 + record * 13) % 100000, record * 31 % 1000, record % 100);
+      CHECK(writeBlock(i, &fh, ph));
+    }
+  CHECK(syncPageFile(&fh));
+  writeTime = nowNanos() - start;
+
+  dropFileCache(BENCH_FILE);
+  start = nowNanos();
+  for (i = 0; i < FILE_MODE_PAGES; i++)
+    CHECK(readBlock(i, &fh, ph));
+  readTime = nowNanos() - start;
+
+  CHECK(closePageFile(&fh));
+  fd = open(BENCH_FILE, O_RDONLY);
+  size = lseek(fd, 0, SEEK_END);
+  close(fd);
+  CHECK(destroyPageFile(BENCH_FILE));
+  free(ph);
+
+  printf("%10s %14.1f %14.0f %14.0f\n", format, size / 1048576.0, FILE_MODE_PAGES / (writeTime / 1e9),
+	 FILE_MODE_PAGES / (readTime / 1e9));
+}
+
+// every thread commits changes to its own page: it logs the change and waits until the log is on disk.
+// The commits/sync show how many commits share one fdatasync of the log.
+void
+benchGroupCommit (int numThreads, int groupDelayUs)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PoolOptions options = { 0 };
+  WAL_Log log;
+  pthread_t *threads = malloc(sizeof(pthread_t) * numThreads);
+  ThreadArgs *args = malloc(sizeof(ThreadArgs) * numThreads);
+  double start, elapsed;
+  int i;
+
+  remove(BENCH_LOG);
+  CHECK(createPageFile(BENCH_FILE));
+  CHECK(openLog(&log, BENCH_LOG, groupDelayUs));
+
+  options.concurrent = true;
+  options.log = &log;
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, 64, RS_CLOCK, NULL, &options));
+
+  start = nowNanos();
+  for (i = 0; i < numThreads; i++)
+    {
+      args[i].bm = bm;
+      args[i].log = &log;
+      args[i].seed = i;
+      pthread_create(&threads[i], NULL, commitWorker, &args[i]);
+    }
+  for (i = 0; i < numThreads; i++)
+    pthread_join(threads[i], NULL);
+  elapsed = nowNanos() - start;
+
+  printf("%10i %14i %14.0f %14.1f\n", numThreads, groupDelayUs, numThreads * GROUP_COMMITS / (elapsed / 1e9),
+	 (double) numThreads * GROUP_COMMITS / getNumLogSyncs(&log));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(closeLog(&log));
+  CHECK(destroyPageFile(BENCH_FILE));
+  remove(BENCH_LOG);
+
+  free(threads);
+  free(args);
+  free(bm);
+}
+
+// one thread keeps depth random pins in flight: it starts depth pins, then waits for all of them and
+// unpins them before starting the next batch
+void
+benchAsyncPins (int depth, bool asyncThreads)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = malloc(sizeof(BM_PageHandle) * depth);
+  BM_PinToken *tokens = malloc(sizeof(BM_PinToken) * depth);
+  BM_PoolOptions options = { 0 };
+  unsigned int seed = 42;
+  double start, elapsed;
+  int i, j;
+
+  CHECK(createPageFile(BENCH_FILE));
+
+  CHECK(initBufferPool(bm, BENCH_FILE, 1, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, FILE_MODE_PAGES - 1));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  options.directIO = true;
+  options.asyncDepth = depth;
+  options.asyncThreads = asyncThreads;
+  CHECK(initBufferPoolWithOptions(bm, BENCH_FILE, FILE_MODE_FRAMES, RS_CLOCK, NULL, &options));
+
+  start = nowNanos();
+  for (i = 0; i < ASYNC_PINS; i += depth)
+    {
+      for (j = 0; j < depth; j++)
+	CHECK(pinPageAsync(bm, &h[j], nextRandom(&seed) % FILE_MODE_PAGES, &tokens[j]));
+      for (j = 0; j < depth; j++)
+	{
+	  CHECK(waitPinPage(bm, tokens[j]));
+	  CHECK(unpinPage(bm, &h[j]));
+	}
+    }
+  elapsed = nowNanos() - start;
+
+  printf(" %14.0f", i / (elapsed / 1e9));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(BENCH_FILE));
+
+  free(bm);
+  free(h);
+  free(tokens);
+}
+
+void *
+pinWorker (void *arg)
+{
+  ThreadArgs *args = (ThreadArgs *) arg;
+  BM_PageHandle h;
+  int i;
+
+  for (i = 0; i < BENCH_PINS; i++)
+    {
+      CHECK(pinPage(args->bm, &h, nextRandom(&args->seed) % THREAD_WORKING_SET));
+      CHECK(unpinPage(args->bm, &h));
+    }
+
+  return NULL;
+}
+
+void *
+commitWorker (void *arg)
+{
+  ThreadArgs *args = (ThreadArgs *) arg;
+  BM_PageHandle h;
+  WAL_Lsn lsn;
+  int i, length;
+
+  for (i = 0; i < GROUP_COMMITS; i++)
+    {
+      CHECK(pinPage(args->bm, &h, args->seed));
+      length = sprintf(h.data, "Commit-%i", i);
+      CHECK(markDirtyLogged(args->bm, &h, 0, length, &lsn));
+      CHECK(unpinPage(args->bm, &h));
+      CHECK(flushLog(args->log, lsn));
+    }
+
+  return NULL;
+}
+
+double
+nowNanos (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// xorshift32, cheap enough not to show up in the measurements
+unsigned int
+nextRandom (unsigned int *state)
+{
+  unsigned int x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+// write back and evict the file from the OS page cache
+void
+dropFileCache (char *fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+// bytes of the file that are in the OS page cache
+long
+cachedBytes (char *fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+  long size = lseek(fd, 0, SEEK_END);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  long numPages = (size + pageSize - 1) / pageSize;
+  unsigned char *resident = malloc(numPages);
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  long i, cached = 0;
+
+  mincore(map, size, resident);
+  for (i = 0; i < numPages; i++)
+    cached += resident[i] & 1;
+
+  munmap(map, size);
+  free(resident);
+  close(fd);
+
+  return cached * pageSize;
+}
+
+int
+compareDoubles (const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
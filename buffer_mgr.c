@@ -3,6 +3,13 @@
 #include <stdlib.h>
 #include "dberror.h"
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 // Include bool DT
 #include "dt.h"
@@ -22,8 +29,150 @@ declaration (if necessary).
 // Data Types and Structures
 
 
-int g_tick = 0;
-
+//number of page table stripes of a concurrent pool
+#define BM_LATCH_STRIPES 64
+
+//size of a transparent huge page, a huge page arena is aligned and rounded up to it
+#define BM_HUGE_PAGE_SIZE (2*1024*1024)
+
+//fields that a concurrent pool reads or writes without holding the latch that protects them, like the pin
+//counts during victim selection. Single threaded these are plain loads and stores.
+#define RELAXED_LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define RELAXED_STORE(x,v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+//a pin count seen at 0 before the frame's data is written back or reused, it pairs with the release of the
+//last unpin so the changes made under that pin are seen
+#define UNPINNED(frame) (__atomic_load_n(&(frame).pin_fix_count, __ATOMIC_ACQUIRE)==0)
+
+//LFU, the position of a frame in the list of its frequency bucket
+typedef struct LFU_Node {
+  int prev;   //more recently used frame in the same bucket, -1 at the head
+  int next;   //less recently used frame in the same bucket, -1 at the tail
+  int bucket;
+} LFU_Node;
+
+//LFU, all frames referenced count times, from the most (head) to the least (tail) recently used.
+//The buckets are linked in increasing count order.
+typedef struct LFU_Bucket {
+  int count;
+  int head;
+  int tail;
+  int prev;
+  int next;
+} LFU_Bucket;
+
+//ARC, a frame or a ghost entry in one of the four lists
+typedef struct ARC_Node {
+  int prev;   //more recently used entry, -1 at the head
+  int next;   //less recently used entry, -1 at the tail
+  int list;
+} ARC_Node;
+
+typedef struct ARC_List {
+  int head;
+  int tail;
+  int size;
+} ARC_List;
+
+#define ARC_T1 0
+#define ARC_T2 1
+#define ARC_B1 2
+#define ARC_B2 3
+
+//open-addressing hash table from page numbers to ints
+typedef struct BM_HashTable {
+  PageNumber *keys;   //NO_PAGE marks an empty slot
+  int *values;
+  int mask;           //table size minus 1, the table size is always a power of two
+  int count;
+} BM_HashTable;
+
+//one stripe of the page table. In a concurrent pool the latch protects the table and the pin counts of
+//the frames registered in it, every stripe sits on its own cache line.
+typedef struct BM_Stripe {
+  pthread_mutex_t latch;
+  pthread_cond_t loaded;   //broadcast when a frame of this stripe has been read in
+  BM_HashTable table;
+} __attribute__((aligned(64))) BM_Stripe;
+
+//pinPageAsync, the state of one token
+typedef struct BM_AsyncPin {
+  BM_PageHandle *page;
+  PageNumber pageNum;
+  int frame;
+  int state;
+  RC rc;
+} BM_AsyncPin;
+
+#define ASYNC_FREE 0      //the token is not in use
+#define ASYNC_READING 1   //the page is being read into frame
+#define ASYNC_WAITING 2   //frame is pinned, another pin is still reading the page into it
+#define ASYNC_DONE 3      //rc is the result, waitPinPage has not been called yet
+
+//number of reads pinPageAsync keeps in flight, unless the pool options say otherwise
+#define BM_ASYNC_DEPTH 64
+
+//smallest readahead window, a new sequential run starts with it
+#define BM_RA_MIN_WINDOW 4
+
+//the background writer looks at the pool this often, and whenever a miss had to write its victim itself
+#define BM_WRITER_INTERVAL_MS 10
+
+//the background writer keeps this share of the unpinned frames, those next in line for eviction, clean
+#define BM_WRITER_HORIZON 8
+
+//forceFlushPool and the background writer pin at most this many frames at once for writing
+#define BM_FLUSH_BATCH 64
+
+//default sizes of the access rings. A scan ring stays in the CPU caches, a bulk write ring is larger so its dirty
+//frames are not written back as soon as they are unpinned.
+#define BM_SCAN_RING_FRAMES 32
+#define BM_BULK_WRITE_RING_FRAMES 256
+
+//a frame has no logged change that is not written yet
+#define BM_NO_LSN LLONG_MAX
+
+//trace records collected before they are written to the trace file
+#define BM_TRACE_BUFFER 4096
+
+//statistics, every live thread owns one slot, so threads do not share the cache lines they count in and add to
+//their counters without a locked instruction. A thread gives its slot back when it exits. While BM_STAT_SLOTS
+//threads own a slot the others count in the shared slot BM_STAT_SLOTS with atomic adds.
+#define BM_STAT_SLOTS 64
+#define BM_STAT_SHARED BM_STAT_SLOTS
+
+#define STAT_HITS 0
+#define STAT_MISSES 1
+#define STAT_EVICTIONS 2
+#define STAT_DIRTY_EVICTIONS 3
+#define STAT_READS 4
+#define STAT_WRITES 5
+#define BM_NUM_COUNTERS 6
+
+#define TIMER_PIN 0
+#define TIMER_READ 1
+#define TIMER_WRITE 2
+#define BM_NUM_TIMERS 3
+
+typedef struct BM_ThreadStats {
+  long long counters[BM_NUM_COUNTERS];
+  long long histograms[BM_NUM_TIMERS][BM_HISTOGRAM_BUCKETS];
+} __attribute__((aligned(64))) BM_ThreadStats;
+
+//a frame and the key it is sorted by, the page number for flushing and the eviction order for the writer
+typedef struct BM_FrameEntry {
+  int key;
+  int frame;
+} BM_FrameEntry;
+
+//an access ring, the frames its misses used and the pages they read into them. next is the slot recycled next.
+//size slots are allocated, the ring uses as many of them as its share of the pool allows.
+typedef struct BM_RingData {
+  int *frames;
+  PageNumber *pages;
+  int next;
+  int size;
+} BM_RingData;
 
 //the BM_mgmtData structure comprises:
 //1, the pointer to the memory space that contains the pages.
@@ -33,527 +182,3604 @@ typedef struct BM_mgmtData {
   BM_PageHandle *pages; //buffer initial address
   SM_FileHandle *fileHandle;
 
-  //add two features, the number of pages in the pool that is occupied.
-  int page_count;
+  //every per frame array has room for capacity frames, resizeBufferPool only changes how many of them are used
+  int capacity;
+
+  //the frames are carved from one page aligned arena, frame i starts at arena+i*PAGE_SIZE. arenaSize is
+  //the size of the mapping, 0 if the arena came from posix_memalign because mmap failed.
+  char *arena;
+  size_t arenaSize;
+
+  //frames that hold no page, used before any victim is chosen. freeFrames is a stack, so the frames
+  //are handed out from frame 0 upwards.
+  int *freeFrames;
+  int freeCount;
+
+  //statistics, one slot per thread number. The operations are only timed with latencyStats.
+  BM_ThreadStats *stats;
+  bool latencyStats;
+
+  int *LRU_Order; //hold the accumulative number of LRU, use pointer to point to an array.
+  int tick;       //logical clock of this pool for LRU and LRU-K, always advanced atomically
+
+  //CLOCK, one reference bit per frame and the position of the clock hand
+  char *refBits;
+  int clockHand;
+
+  //LRU-K, history[frame*lruK+i] is the time of the (i+1)-th most recent uncorrelated reference to the
+  //page in that frame, -1 if there is none. lastRef is the time of the very last reference.
+  int lruK;
+  int correlatedPeriod;
+  int retainedPeriod;
+  int *history;
+  int *lastRef;
+
+  //LRU-K retained information, the history of evicted pages in a direct-mapped table indexed by the
+  //page number hash. A newer page simply overwrites the slot.
+  PageNumber *retainedPages;
+  int *retainedLast;
+  int *retainedHistory;
+  int retainedMask;
+
+  //LFU, one node per frame, at most one bucket per frame plus a spare. lfuLowest is the bucket with
+  //the smallest count, unused buckets are chained through next starting at lfuFreeBucket.
+  LFU_Node *lfuNodes;
+  LFU_Bucket *lfuBuckets;
+  int lfuLowest;
+  int lfuFreeBucket;
+  int agingPeriod;    //halve all counts every agingPeriod references, 0 never
+  int agingCountdown;
+
+  //ARC, the resident lists T1 and T2 link the frames, the ghost lists B1 and B2 link ghost entries that
+  //only remember a page number. arcTarget is the adaptive target size of T1.
+  ARC_List arcLists[4];
+  ARC_Node *arcFrames;
+  ARC_Node *arcGhosts;
+  PageNumber *arcGhostPages;
+  int arcFreeGhost;
+  BM_HashTable arcGhostTable;
+  int arcTarget;
+
+  //page table, maps a page number to the frame that holds it. It is split in 1<<stripeBits stripes by
+  //the page number hash, a pool that is not concurrent has a single stripe.
+  BM_Stripe *stripes;
+  int stripeBits;
+
+  //concurrent pools only. The replacement latch protects the free frames and the strategy state, it is
+  //always taken before a stripe latch. loading[frame] is set while the frame is being read from disk.
+  //extendLatch lets only one thread at a time grow the page file.
+  bool concurrent;
+  pthread_mutex_t replacementLatch;
+  pthread_mutex_t extendLatch;
+  char *loading;
+
+  //pinPageAsync, the token of a pin is its index in asyncPins. The I/O engine of the page file is started
+  //by the first asynchronous pin. asyncLatch protects the tokens, it is taken before the replacement latch.
+  BM_AsyncPin *asyncPins;
+  int numAsyncPins;
+  int asyncDepth;
+  int asyncMode;
+  pthread_mutex_t asyncLatch;
+
+  //readahead, protected by asyncLatch. A sequential run pins raLast+1 after raLast, raNext is the first page
+  //of the run not prefetched yet. The window of pages kept prefetched ahead of the run doubles whenever a
+  //prefetched page is used and halves when one is evicted unused (counted in raWasted), it stays between
+  //BM_RA_MIN_WINDOW and raMaxWindow. prefetched[frame] marks a frame read ahead and not pinned since.
+  int raMaxWindow;
+  int raWindow;
+  PageNumber raLast;
+  PageNumber raNext;
+  int raWasted;
+  int raInFlight;
+  char *prefetched;
+
+  //background writer, runs while dirtyTarget (percent of the frames) is above 0. It sleeps on writerWake
+  //under writerLatch, writerStop ends it. writerRanks and writerOrder are its scratch space.
+  int dirtyTarget;
+  bool writerStop;
+  pthread_t writer;
+  pthread_mutex_t writerLatch;
+  pthread_cond_t writerWake;
+  int *writerRanks;
+  BM_FrameEntry *writerOrder;
+
+  //write-ahead log, NULL unless the pool options give one. pageLsns[frame] is the LSN of the last logged change
+  //of the page in the frame, the log is flushed up to it before the page is written. recLsns[frame] is a log
+  //position at or before the oldest logged change not written yet, BM_NO_LSN if there is none. Both are changed
+  //under the stripe latch of the page. unsyncedLsn is the oldest recLsn of the pages written since the last
+  //checkpoint synced the page file, it only changes atomically.
+  WAL_Log *log;
+  WAL_Lsn *pageLsns;
+  WAL_Lsn *recLsns;
+  WAL_Lsn unsyncedLsn;
+
+  //access trace, traceFd is -1 unless the pool options give a trace file. The records are collected in traceBuffer
+  //under traceLatch and written out whenever it is full, their times count from traceStart. traceDropped counts
+  //the records a failed write lost.
+  int traceFd;
+  pthread_mutex_t traceLatch;
+  BM_TraceRecord *traceBuffer;
+  int traceUsed;
+  long long traceStart;
+  long long traceDropped;
+
+  //a simulated pool has no page file, reads and writes are only counted
+  bool simulated;
+
+} BM_mgmtData;
+
+//threads are numbered for the access traces when they first use any pool
+static __thread int threadNum=-1;
+static int numThreads=0;
+
+//the statistics slot of the thread and which slots live threads own, one bit each. The key releases the slot
+//when the thread exits.
+static __thread int statSlotNum=-1;
+static unsigned long long statSlotsOwned=0;
+static pthread_key_t statSlotKey;
+static pthread_once_t statSlotOnce=PTHREAD_ONCE_INIT;
+
+/*
+	Hash table helpers, used for the page table and the ARC ghost directory.
+	1, open addressing with linear probing, the table has at least twice as many slots as entries so the
+	probe sequences stay short. It doubles when an insert would break that.
+	2, removal uses backward shifting instead of tombstones, so lookups never slow down as pages are evicted.
+*/
+
+//murmur3 finalizer, the low bits index the tables and the high bits pick the page table stripe
+static unsigned int hashPage (PageNumber pageNum){
+
+  unsigned int h=(unsigned int)pageNum;
+
+  h^=h>>16;
+  h*=0x85ebca6bu;
+  h^=h>>13;
+  h*=0xc2b2ae35u;
+  h^=h>>16;
+
+  return h;
+
+}
+
+static void hashTableInit (BM_HashTable *table, int maxEntries){
+
+  int tableSize=16;
+
+  while(tableSize<2*maxEntries){
+    tableSize*=2;
+  }
+
+  //all bytes 0xff makes every key NO_PAGE
+  table->keys=(PageNumber *)malloc(sizeof(PageNumber)*tableSize);
+  memset(table->keys, -1, sizeof(PageNumber)*tableSize);
+  table->values=(int *)malloc(sizeof(int)*tableSize);
+  table->mask=tableSize-1;
+  table->count=0;
+
+}
+
+static void hashTableFree (BM_HashTable *table){
+
+  free(table->keys);
+  free(table->values);
+
+}
+
+//return the value stored for pageNum, or -1 if there is none
+static int hashTableFind (BM_HashTable *table, PageNumber pageNum){
+
+  int slot=(int)(hashPage(pageNum) & (unsigned int)table->mask);
+  PageNumber key;
+
+  while((key=table->keys[slot])!=NO_PAGE){
+
+    if(key==pageNum){
+      return table->values[slot];
+    }
+
+    slot=(slot+1)&table->mask;
+  }
+
+  return -1;
+
+}
+
+static void hashTableInsert (BM_HashTable *table, PageNumber pageNum, int value){
+
+  int slot;
+
+  if(2*(table->count+1)>table->mask+1){
+
+    BM_HashTable old=*table;
+    int i;
+
+    hashTableInit(table, old.count+1);
+
+    for(i=0;i<=old.mask;i++){
+      if(old.keys[i]!=NO_PAGE){
+        hashTableInsert(table, old.keys[i], old.values[i]);
+      }
+    }
+
+    hashTableFree(&old);
+  }
+
+  table->count++;
+  slot=(int)(hashPage(pageNum) & (unsigned int)table->mask);
+
+  while(table->keys[slot]!=NO_PAGE){
+    slot=(slot+1)&table->mask;
+  }
+
+  table->keys[slot]=pageNum;
+  table->values[slot]=value;
+
+}
+
+static void hashTableRemove (BM_HashTable *table, PageNumber pageNum){
+
+  int hole, slot, home;
+
+  hole=(int)(hashPage(pageNum) & (unsigned int)table->mask);
+
+  while(table->keys[hole]!=pageNum){
+    if(table->keys[hole]==NO_PAGE){
+      return;
+    }
+    hole=(hole+1)&table->mask;
+  }
+
+  table->count--;
+
+  //shift the following entries of the cluster back, so that no entry ends up in front of its home slot
+  slot=hole;
+
+  while(1){
+
+    slot=(slot+1)&table->mask;
+
+    if(table->keys[slot]==NO_PAGE){
+      break;
+    }
+
+    home=(int)(hashPage(table->keys[slot]) & (unsigned int)table->mask);
+
+    //the entry can stay if its home slot lies cyclically in (hole, slot]
+    if(hole<=slot ? (hole<home && home<=slot) : (hole<home || home<=slot)){
+      continue;
+    }
+
+    table->keys[hole]=table->keys[slot];
+    table->values[hole]=table->values[slot];
+    hole=slot;
+  }
+
+  table->keys[hole]=NO_PAGE;
+
+}
+
+/*
+	Page table and latch helpers.
+	1, findFrame, pageTableInsert and pageTableRemove must be called with the stripe of the page latched.
+	2, latch and unlatch do nothing in a pool that is not concurrent.
+	3, pin counts only go up under the stripe latch of the page, so a frame seen unpinned under that latch
+	stays unpinned until the latch is released. They may go down at any time.
+*/
+
+static BM_Stripe *stripeOf (BM_mgmtData *mgmtData, PageNumber pageNum){
+
+  if(mgmtData->stripeBits==0){
+    return mgmtData->stripes;
+  }
+
+  return mgmtData->stripes+(hashPage(pageNum)>>(32-mgmtData->stripeBits));
+
+}
+
+static void latch (BM_mgmtData *mgmtData, pthread_mutex_t *mutex){
+
+  if(mgmtData->concurrent){
+    pthread_mutex_lock(mutex);
+  }
+
+}
+
+static void unlatch (BM_mgmtData *mgmtData, pthread_mutex_t *mutex){
+
+  if(mgmtData->concurrent){
+    pthread_mutex_unlock(mutex);
+  }
+
+}
+
+//counters that are updated without a latch, atomic only in a concurrent pool where they are shared
+static int fetchAndAdd (BM_mgmtData *mgmtData, int *counter, int delta){
+
+  if(mgmtData->concurrent){
+    return __atomic_fetch_add(counter, delta, __ATOMIC_ACQ_REL);
+  }
+
+  *counter+=delta;
+  return *counter-delta;
+
+}
+
+static int nextTick (BM_mgmtData *mgmtData){
+
+  return fetchAndAdd(mgmtData, &mgmtData->tick, 1);
+
+}
+
+static void pinFrame (BM_mgmtData *mgmtData, int frame){
+
+  fetchAndAdd(mgmtData, &mgmtData->pages[frame].pin_fix_count, 1);
+
+}
+
+static void unpinFrame (BM_mgmtData *mgmtData, int frame){
+
+  fetchAndAdd(mgmtData, &mgmtData->pages[frame].pin_fix_count, -1);
+
+}
+
+//return the frame holding pageNum, or -1 if the page is not in the buffer pool
+static int findFrame (BM_mgmtData *mgmtData, PageNumber pageNum){
+
+  return hashTableFind(&stripeOf(mgmtData, pageNum)->table, pageNum);
+
+}
+
+//register a frame under the page number it currently holds
+static void pageTableInsert (BM_mgmtData *mgmtData, int frame){
+
+  PageNumber pageNum=mgmtData->pages[frame].pageNum;
+
+  hashTableInsert(&stripeOf(mgmtData, pageNum)->table, pageNum, frame);
+
+}
+
+//remove the frame from the table, the frame still has to hold the page number it was inserted with
+static void pageTableRemove (BM_mgmtData *mgmtData, int frame){
+
+  PageNumber pageNum=mgmtData->pages[frame].pageNum;
+
+  hashTableRemove(&stripeOf(mgmtData, pageNum)->table, pageNum);
+
+}
+
+static long long nowNanos (void){
+
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (long long)now.tv_sec*1000000000LL+now.tv_nsec;
+
+}
+
+static int threadNumber (void){
+
+  if(threadNum<0){
+    threadNum=__atomic_fetch_add(&numThreads, 1, __ATOMIC_RELAXED);
+  }
+
+  return threadNum;
+
+}
+
+//the release clears the bit with release order, so the next owner of the slot sees the counts of this thread
+static void releaseStatSlot (void *slot){
+
+  __atomic_fetch_and(&statSlotsOwned, ~(1ULL<<((intptr_t)slot-1)), __ATOMIC_RELEASE);
+
+}
+
+static void statSlotInit (void){
+
+  pthread_key_create(&statSlotKey, releaseStatSlot);
+
+}
+
+//the slot of the calling thread, the lowest free one the first time or the shared slot if there is none
+static int statSlot (void){
+
+  unsigned long long owned;
+  int slot;
+
+  if(statSlotNum>=0){
+    return statSlotNum;
+  }
+
+  pthread_once(&statSlotOnce, statSlotInit);
+
+  owned=__atomic_load_n(&statSlotsOwned, __ATOMIC_RELAXED);
+  do{
+    if(owned==~0ULL){
+      statSlotNum=BM_STAT_SHARED;
+      return statSlotNum;
+    }
+    slot=__builtin_ctzll(~owned);
+  } while(!__atomic_compare_exchange_n(&statSlotsOwned, &owned, owned|(1ULL<<slot), false, __ATOMIC_ACQUIRE,
+                                       __ATOMIC_RELAXED));
+
+  pthread_setspecific(statSlotKey, (void *)(intptr_t)(slot+1));
+  statSlotNum=slot;
+
+  return statSlotNum;
+
+}
+
+//add to a counter in the slot of the calling thread. Only the owner writes its slot, so a plain add does, the
+//relaxed load and store only keep getPoolStats from reading a torn value. The shared slot needs the atomic add.
+static void addStat (long long *value, long long delta){
+
+  if(statSlotNum==BM_STAT_SHARED){
+    __atomic_fetch_add(value, delta, __ATOMIC_RELAXED);
+  }
+  else{
+    __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED)+delta, __ATOMIC_RELAXED);
+  }
+
+}
+
+static void countStat (BM_mgmtData *mgmtData, int counter, long long delta){
+
+  addStat(&mgmtData->stats[statSlot()].counters[counter], delta);
+
+}
+
+//time an operation for its histogram, only with latencyStats
+static long long startTimer (BM_mgmtData *mgmtData){
+
+  return mgmtData->latencyStats ? nowNanos() : 0;
+
+}
+
+//bucket i counts the times from 2^i to 2^(i+1)-1 nanoseconds, the last bucket everything longer
+static void stopTimer (BM_mgmtData *mgmtData, int timer, long long start){
+
+  long long elapsed;
+  int bucket;
+
+  if(!mgmtData->latencyStats){
+    return;
+  }
+
+  elapsed=nowNanos()-start;
+  bucket=(elapsed>1) ? 63-__builtin_clzll(elapsed) : 0;
+  bucket=(bucket<BM_HISTOGRAM_BUCKETS) ? bucket : BM_HISTOGRAM_BUCKETS-1;
+
+  addStat(&mgmtData->stats[statSlot()].histograms[timer][bucket], 1);
+
+}
+
+//write the collected trace records. A failed write loses them but does not affect the pool, they are counted in
+//traceDropped and the user of the pool finds them in getPoolStats.
+static void flushTrace (BM_mgmtData *mgmtData){
+
+  ssize_t written=0;
+
+  if(mgmtData->traceUsed>0){
+    written=write(mgmtData->traceFd, mgmtData->traceBuffer, sizeof(BM_TraceRecord)*mgmtData->traceUsed);
+  }
+
+  if(written<(ssize_t)(sizeof(BM_TraceRecord)*mgmtData->traceUsed)){
+    written=(written>0) ? written/(ssize_t)sizeof(BM_TraceRecord) : 0;
+    __atomic_store_n(&mgmtData->traceDropped, mgmtData->traceDropped+mgmtData->traceUsed-written, __ATOMIC_RELAXED);
+  }
+
+  mgmtData->traceUsed=0;
+
+}
+
+//record an operation of the pool's user in the access trace, if there is one. The time is taken under the latch,
+//so the records are in time order.
+static void traceOp (BM_mgmtData *mgmtData, int op, PageNumber pageNum){
+
+  BM_TraceRecord *record;
+
+  if(mgmtData->traceFd<0){
+    return;
+  }
+
+  int thread=threadNumber();
+
+  latch(mgmtData, &mgmtData->traceLatch);
+
+  record=&mgmtData->traceBuffer[mgmtData->traceUsed++];
+  record->time=nowNanos()-mgmtData->traceStart;
+  record->pageNum=pageNum;
+  record->thread=(short)thread;
+  record->op=(char)op;
+  record->reserved=0;
+
+  if(mgmtData->traceUsed==BM_TRACE_BUFFER){
+    flushTrace(mgmtData);
+  }
+
+  unlatch(mgmtData, &mgmtData->traceLatch);
+
+}
+
+//block I/O of the pool. The storage manager reads and writes at explicit offsets, so threads do their I/O
+//in parallel.
+static RC readFrame (BM_mgmtData *mgmtData, PageNumber pageNum, int frame){
+
+  long long start=startTimer(mgmtData);
+  RC ret;
+
+  ret=mgmtData->simulated ? RC_OK : readBlock(pageNum, mgmtData->fileHandle, mgmtData->pages[frame].data);
+
+  if(ret==RC_OK){
+    stopTimer(mgmtData, TIMER_READ, start);
+    countStat(mgmtData, STAT_READS, 1);
+  }
+
+  return ret;
+
+}
+
+//write-ahead logging, the log is flushed up to lsn, the last logged change of the page, before the page is written
+static RC writeFrame (BM_mgmtData *mgmtData, PageNumber pageNum, SM_PageHandle data, WAL_Lsn lsn){
+
+  RC ret;
+
+  if(mgmtData->log!=NULL && lsn>0 && (ret=flushLog(mgmtData->log, lsn))!=RC_OK){
+    return ret;
+  }
+
+  long long start=startTimer(mgmtData);
+
+  ret=mgmtData->simulated ? RC_OK : writeBlock(pageNum, mgmtData->fileHandle, data);
+
+  //a failed page stays dirty and is written again, only the write that lands counts
+  if(ret==RC_OK){
+    stopTimer(mgmtData, TIMER_WRITE, start);
+    countStat(mgmtData, STAT_WRITES, 1);
+  }
+
+  return ret;
+
+}
+
+//write the pages firstPage to firstPage+numPages-1 at once, every page counts as one write. lsn is the last
+//logged change of any of them.
+static RC writeFrames (BM_mgmtData *mgmtData, PageNumber firstPage, int numPages, SM_PageHandle *data, WAL_Lsn lsn){
+
+  RC ret;
+
+  if(mgmtData->log!=NULL && lsn>0 && (ret=flushLog(mgmtData->log, lsn))!=RC_OK){
+    return ret;
+  }
+
+  long long start=startTimer(mgmtData);
+
+  ret=mgmtData->simulated ? RC_OK : writeBlocks(firstPage, numPages, mgmtData->fileHandle, data);
+
+  //a failed page stays dirty and is written again, only the write that lands counts
+  if(ret==RC_OK){
+    stopTimer(mgmtData, TIMER_WRITE, start);
+    countStat(mgmtData, STAT_WRITES, numPages);
+  }
+
+  return ret;
+
+}
+
+//lower an LSN shared by several threads to lsn, unless it is lower already
+static void lowerLsn (WAL_Lsn *target, WAL_Lsn lsn){
+
+  WAL_Lsn current=__atomic_load_n(target, __ATOMIC_ACQUIRE);
+
+  while(lsn<current && !__atomic_compare_exchange_n(target, &current, lsn, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+}
+
+//a frame still pinned by its writer has been written, recLsn was its recLsn when it was marked clean. The changes
+//only need the log until the next checkpoint has synced the page file, so unsyncedLsn takes over before recLsn is
+//cleared, a checkpoint that does not see one sees the other. A frame dirtied again during the write keeps recLsn.
+static void frameWritten (BM_mgmtData *mgmtData, int frame, WAL_Lsn recLsn){
+
+  BM_Stripe *stripe;
+
+  if(mgmtData->log==NULL || recLsn==BM_NO_LSN){
+    return;
+  }
+
+  lowerLsn(&mgmtData->unsyncedLsn, recLsn);
+
+  stripe=stripeOf(mgmtData, mgmtData->pages[frame].pageNum);
+  latch(mgmtData, &stripe->latch);
+
+  if(mgmtData->recLsns[frame]==recLsn && !mgmtData->pages[frame].dirty){
+    __atomic_store_n(&mgmtData->recLsns[frame], BM_NO_LSN, __ATOMIC_RELEASE);
+  }
+
+  unlatch(mgmtData, &stripe->latch);
+
+}
+
+//the write of a frame still pinned by its writer failed, the page is dirty again so it is not dropped at eviction
+static void frameNotWritten (BM_mgmtData *mgmtData, int frame){
+
+  BM_Stripe *stripe=stripeOf(mgmtData, mgmtData->pages[frame].pageNum);
+
+  latch(mgmtData, &stripe->latch);
+  RELAXED_STORE(mgmtData->pages[frame].dirty, 1);
+  unlatch(mgmtData, &stripe->latch);
+
+}
+
+/*
+	Frame arena.
+	1, one anonymous mapping holds every frame, so the frames are page aligned (usable for O_DIRECT) and
+	contiguous, and initializing a pool does not touch the frames.
+	2, with huge pages the arena is aligned and rounded up to BM_HUGE_PAGE_SIZE and advised MADV_HUGEPAGE,
+	so a large pool needs far fewer TLB entries. The kernel may still ignore the advice.
+	3, if mmap fails the arena comes from posix_memalign, still page aligned and freed at once.
+*/
+
+static void allocArena (BM_mgmtData *mgmtData, int numPages, bool hugePages){
+
+  size_t size=(size_t)numPages*PAGE_SIZE;
+  size_t align=hugePages ? BM_HUGE_PAGE_SIZE : PAGE_SIZE;
+  char *map;
+
+  size=(size+align-1)/align*align;
+
+  //map one alignment unit more than needed and trim both ends to the alignment
+  map=(char *)mmap(NULL, size+align-PAGE_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+  if(map==MAP_FAILED){
+    posix_memalign((void **)&mgmtData->arena, PAGE_SIZE, size);
+    mgmtData->arenaSize=0;
+    return;
+  }
+
+  char *start=(char *)(((size_t)map+align-1)/align*align);
+  char *end=start+size;
+  char *mapEnd=map+size+align-PAGE_SIZE;
+
+  if(start>map){
+    munmap(map, start-map);
+  }
+  if(mapEnd>end){
+    munmap(end, mapEnd-end);
+  }
+
+#ifdef MADV_HUGEPAGE
+  if(hugePages){
+    madvise(start, size, MADV_HUGEPAGE);
+  }
+#endif
+
+  mgmtData->arena=start;
+  mgmtData->arenaSize=size;
+
+}
+
+static void freeArena (BM_mgmtData *mgmtData){
+
+  if(mgmtData->arenaSize>0){
+    munmap(mgmtData->arena, mgmtData->arenaSize);
+  }
+  else{
+    free(mgmtData->arena);
+  }
+
+}
+
+// convenience macros
+
+/*
+char * const a;
+means that the pointer is constant and immutable but the pointed data is not.
+
+const char * a;
+means that the pointed data cannot be written to using the pointer a.
+
+const char * const
+which is a pointer that you cannot change, to a char (or multiple chars) that you cannot change. 
+*/
+
+
+
+// Buffer Manager Interface Pool Handling
+
+//stratData holds strategy specific parameters, a BM_LRUKParams for RS_LRU_K and a BM_LFUParams for RS_LFU.
+//NULL uses the defaults.
+RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
+		  const int numPages, ReplacementStrategy strategy, 
+		  void *stratData){
+
+    return initBufferPoolWithOptions(bm, pageFileName, numPages, strategy, stratData, NULL);
+
+}
+
+static void *writerMain (void *arg);
+
+//options may be NULL, which gives the same pool as initBufferPool
+RC initBufferPoolWithOptions(BM_BufferPool *const bm, const char *const pageFileName, 
+		  const int numPages, ReplacementStrategy strategy, 
+		  void *stratData, const BM_PoolOptions *options){
+
+    bool simulated=(options!=NULL && options->simulated);
+    int traceFd=-1;
+
+    //with a write-ahead log, the changes a crash kept from the page file are redone first
+    if(options!=NULL && options->log!=NULL && !simulated){
+
+      RC ret=recoverLog(options->log, (char *)pageFileName);
+
+      if(ret!=RC_OK){
+        return ret;
+      }
+    }
+
+    //a pool that cannot record the trace it was asked for is not created
+    if(options!=NULL && options->traceFile!=NULL){
+
+      BM_TraceHeader header;
+
+      traceFd=open(options->traceFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+      if(traceFd<0){
+        return RC_FILE_NOT_FOUND;
+      }
+
+      memset(&header, 0, sizeof(BM_TraceHeader));
+      memcpy(header.magic, BM_TRACE_MAGIC, sizeof(header.magic));
+      header.version=BM_TRACE_VERSION;
+      header.numFrames=numPages;
+      header.strategy=strategy;
+
+      if(write(traceFd, &header, sizeof(BM_TraceHeader))!=sizeof(BM_TraceHeader)){
+        close(traceFd);
+        return RC_WRITE_FAILED;
+      }
+    }
+
+    //open the page file before anything is allocated, a simulated pool takes every page as existing and never
+    //touches the file
+    SM_FileHandle *fileHandle=(SM_FileHandle *)malloc(sizeof(SM_FileHandle));
+
+    int openFlags=0;
+
+    if(options!=NULL){
+      openFlags|=options->directIO ? SM_OPEN_DIRECT : 0;
+      openFlags|=options->mappedFile ? SM_OPEN_MMAP : 0;
+      openFlags|=options->preallocate ? SM_OPEN_PREALLOC : 0;
+    }
+
+    if(simulated){
+      fileHandle->fileName=(char *)pageFileName;
+      fileHandle->totalNumPages=INT_MAX;
+      fileHandle->curPagePos=0;
+      fileHandle->mgmtInfo=NULL;
+    }
+    else{
+
+      RC ret=openPageFileWithFlags((char *)pageFileName, fileHandle, openFlags);
+
+      if(ret!=RC_OK){
+        free(fileHandle);
+        if(traceFd>=0){
+          close(traceFd);
+        }
+        return ret;
+      }
+    }
+
+    //initialize the BM_mgmtData
+    //1, create an BM_mgmtData object. Everything kept per frame has room for capacity frames, so
+    //resizeBufferPool never moves it.
+    BM_mgmtData *mgmtDataPool=(BM_mgmtData *)malloc(sizeof(BM_mgmtData));
+    int capacity=(options!=NULL && options->maxFrames>numPages) ? options->maxFrames : numPages;
+
+    mgmtDataPool->capacity=capacity;
+
+    //create BM_PageHandle array
+    BM_PageHandle *BM_pages=(BM_PageHandle *)malloc(sizeof(BM_PageHandle) * capacity);
+
+    int i, k;
+
+    //all frames come from one arena, the kernel only backs it with memory once a frame is touched
+    allocArena(mgmtDataPool, capacity, options!=NULL && options->hugePages);
+
+    for (i=0;i<capacity;i++){
+
+        //when using [], the pointer turns to object, so we use '.'
+        BM_pages[i].pageNum=-1;   //at beginning, set all page number to be -1.
+        BM_pages[i].data=mgmtDataPool->arena+(size_t)i*PAGE_SIZE;
+        BM_pages[i].pin_fix_count=0;
+        BM_pages[i].dirty=0;
+
+    }
+
+    //assign the BM_PageHandle array to BM_mgmtData
+    mgmtDataPool->pages = BM_pages;
+
+
+
+    //2, save the SM_FileHandle into BM_mgmtData
+    mgmtDataPool->simulated=simulated;
+    mgmtDataPool->fileHandle=fileHandle;
+
+    //3, initialize the int array that contains the dirty information, make them all 0.
+    int *LRU_Order=(int *)malloc(sizeof(int)*capacity);
+
+    memset(LRU_Order, 0, sizeof(int) * capacity);
+
+    mgmtDataPool->LRU_Order=LRU_Order;
+    mgmtDataPool->tick=0;
+
+    //reference bits and clock hand for CLOCK
+    mgmtDataPool->refBits=(char *)malloc(capacity);
+    memset(mgmtDataPool->refBits, 0, capacity);
+    mgmtDataPool->clockHand=0;
+
+    //LRU-K, the parameters come from stratData, NULL means K=2 and no correlated or retained period
+    BM_LRUKParams *lruKParams=(BM_LRUKParams *)stratData;
+
+    mgmtDataPool->lruK=2;
+    mgmtDataPool->correlatedPeriod=0;
+    mgmtDataPool->retainedPeriod=0;
+
+    if(strategy==RS_LRU_K && lruKParams!=NULL){
+      if(lruKParams->k>0){
+        mgmtDataPool->lruK=lruKParams->k;
+      }
+      mgmtDataPool->correlatedPeriod=lruKParams->correlatedPeriod;
+      mgmtDataPool->retainedPeriod=lruKParams->retainedPeriod;
+    }
+
+    mgmtDataPool->history=NULL;
+    mgmtDataPool->lastRef=NULL;
+    mgmtDataPool->retainedPages=NULL;
+    mgmtDataPool->retainedLast=NULL;
+    mgmtDataPool->retainedHistory=NULL;
+
+    if(strategy==RS_LRU_K){
+
+      int lruK=mgmtDataPool->lruK;
+      int retainedSize=16;
+
+      while(retainedSize<numPages){
+        retainedSize*=2;
+      }
+
+      //all bytes 0xff makes every int -1, no reference yet
+      mgmtDataPool->history=(int *)malloc(sizeof(int)*capacity*lruK);
+      memset(mgmtDataPool->history, -1, sizeof(int)*capacity*lruK);
+      mgmtDataPool->lastRef=(int *)malloc(sizeof(int)*capacity);
+      memset(mgmtDataPool->lastRef, -1, sizeof(int)*capacity);
+
+      mgmtDataPool->retainedPages=(PageNumber *)malloc(sizeof(PageNumber)*retainedSize);
+      memset(mgmtDataPool->retainedPages, -1, sizeof(PageNumber)*retainedSize);
+      mgmtDataPool->retainedLast=(int *)malloc(sizeof(int)*retainedSize);
+      mgmtDataPool->retainedHistory=(int *)malloc(sizeof(int)*retainedSize*lruK);
+      mgmtDataPool->retainedMask=retainedSize-1;
+    }
+
+    //LFU, aging is configured by a BM_LFUParams in stratData
+    BM_LFUParams *lfuParams=(BM_LFUParams *)stratData;
+
+    mgmtDataPool->lfuNodes=NULL;
+    mgmtDataPool->lfuBuckets=NULL;
+    mgmtDataPool->lfuLowest=-1;
+    mgmtDataPool->lfuFreeBucket=-1;
+    mgmtDataPool->agingPeriod=0;
+
+    if(strategy==RS_LFU){
+
+      mgmtDataPool->lfuNodes=(LFU_Node *)malloc(sizeof(LFU_Node)*capacity);
+      //one spare bucket, a reference creates the bucket for count+1 before it frees the old one
+      mgmtDataPool->lfuBuckets=(LFU_Bucket *)malloc(sizeof(LFU_Bucket)*(capacity+1));
+
+      for(i=0;i<=capacity;i++){
+        mgmtDataPool->lfuBuckets[i].next=(i<capacity) ? i+1 : -1;
+      }
+      mgmtDataPool->lfuFreeBucket=0;
+
+      if(lfuParams!=NULL){
+        mgmtDataPool->agingPeriod=lfuParams->agingPeriod;
+      }
+      mgmtDataPool->agingCountdown=mgmtDataPool->agingPeriod;
+    }
+
+    //ARC, the lists start empty and the target size of T1 at 0
+    mgmtDataPool->arcFrames=NULL;
+    mgmtDataPool->arcGhosts=NULL;
+    mgmtDataPool->arcGhostPages=NULL;
+    mgmtDataPool->arcTarget=0;
+
+    if(strategy==RS_ARC){
+
+      for(i=0;i<4;i++){
+        mgmtDataPool->arcLists[i].head=-1;
+        mgmtDataPool->arcLists[i].tail=-1;
+        mgmtDataPool->arcLists[i].size=0;
+      }
+
+      mgmtDataPool->arcFrames=(ARC_Node *)malloc(sizeof(ARC_Node)*capacity);
+
+      //B1 and B2 together hold at most as many ghosts as there are frames, plus the one added by an eviction before the
+      //lists are trimmed again
+      mgmtDataPool->arcGhosts=(ARC_Node *)malloc(sizeof(ARC_Node)*(capacity+1));
+      mgmtDataPool->arcGhostPages=(PageNumber *)malloc(sizeof(PageNumber)*(capacity+1));
+
+      for(i=0;i<=capacity;i++){
+        mgmtDataPool->arcGhosts[i].next=(i<capacity) ? i+1 : -1;
+      }
+      mgmtDataPool->arcFreeGhost=0;
+
+      hashTableInit(&mgmtDataPool->arcGhostTable, numPages+1);
+    }
+
+    //4, free frames, all of them at the beginning
+    mgmtDataPool->freeFrames=(int *)malloc(sizeof(int)*capacity);
+
+    for(i=0;i<numPages;i++){
+      mgmtDataPool->freeFrames[i]=numPages-1-i;
+    }
+    mgmtDataPool->freeCount=numPages;
+
+    //5, latches of a concurrent pool, the background writer is a second thread so it needs them too
+    mgmtDataPool->dirtyTarget=(options!=NULL && options->dirtyTarget>0) ? options->dirtyTarget : 0;
+    mgmtDataPool->concurrent=(options!=NULL && options->concurrent) || mgmtDataPool->dirtyTarget>0;
+    mgmtDataPool->loading=(char *)malloc(capacity);
+    memset(mgmtDataPool->loading, 0, capacity);
+
+    if(mgmtDataPool->concurrent){
+      pthread_mutex_init(&mgmtDataPool->replacementLatch, NULL);
+      pthread_mutex_init(&mgmtDataPool->extendLatch, NULL);
+      pthread_mutex_init(&mgmtDataPool->asyncLatch, NULL);
+    }
+
+    //no asynchronous pins yet
+    mgmtDataPool->asyncPins=NULL;
+    mgmtDataPool->numAsyncPins=0;
+    mgmtDataPool->asyncDepth=(options!=NULL && options->asyncDepth>0) ? options->asyncDepth : BM_ASYNC_DEPTH;
+    mgmtDataPool->asyncMode=(options!=NULL && options->asyncThreads) ? SM_ASYNC_THREADS : SM_ASYNC_RING;
+
+    //readahead is off unless the pool options give a window
+    mgmtDataPool->raMaxWindow=(options==NULL || simulated) ? 0 : (options->readahead>BM_RA_MIN_WINDOW) ? options->readahead :
+      (options->readahead>0) ? BM_RA_MIN_WINDOW : 0;
+    mgmtDataPool->raWindow=BM_RA_MIN_WINDOW;
+    mgmtDataPool->raLast=NO_PAGE;
+    mgmtDataPool->raNext=0;
+    mgmtDataPool->raWasted=0;
+    mgmtDataPool->raInFlight=0;
+    mgmtDataPool->prefetched=(char *)malloc(capacity);
+    memset(mgmtDataPool->prefetched, 0, capacity);
+
+    //6, no statistics yet, every slot on its own cache lines
+    posix_memalign((void **)&mgmtDataPool->stats, 64, sizeof(BM_ThreadStats)*(BM_STAT_SLOTS+1));
+    memset(mgmtDataPool->stats, 0, sizeof(BM_ThreadStats)*(BM_STAT_SLOTS+1));
+    mgmtDataPool->latencyStats=(options!=NULL && options->latencyStats);
+
+    //the write-ahead log, no frame has a logged change yet
+    mgmtDataPool->log=(options!=NULL && !simulated) ? options->log : NULL;
+    mgmtDataPool->pageLsns=NULL;
+    mgmtDataPool->recLsns=NULL;
+    mgmtDataPool->unsyncedLsn=BM_NO_LSN;
+
+    if(mgmtDataPool->log!=NULL){
+      mgmtDataPool->pageLsns=(WAL_Lsn *)calloc(capacity, sizeof(WAL_Lsn));
+      mgmtDataPool->recLsns=(WAL_Lsn *)malloc(sizeof(WAL_Lsn)*capacity);
+
+      for(i=0;i<capacity;i++){
+        mgmtDataPool->recLsns[i]=BM_NO_LSN;
+      }
+    }
+
+    //the access trace starts with a header that describes the pool
+    mgmtDataPool->traceFd=traceFd;
+    mgmtDataPool->traceBuffer=NULL;
+    mgmtDataPool->traceUsed=0;
+    mgmtDataPool->traceDropped=0;
+
+    if(traceFd>=0){
+      mgmtDataPool->traceBuffer=(BM_TraceRecord *)malloc(sizeof(BM_TraceRecord)*BM_TRACE_BUFFER);
+      mgmtDataPool->traceStart=nowNanos();
+      pthread_mutex_init(&mgmtDataPool->traceLatch, NULL);
+    }
+
+    //7, the page table, the stripes grow on their own if the pages do not spread evenly
+    int numStripes=mgmtDataPool->concurrent ? BM_LATCH_STRIPES : 1;
+
+    mgmtDataPool->stripeBits=0;
+    while((1<<mgmtDataPool->stripeBits)<numStripes){
+      mgmtDataPool->stripeBits++;
+    }
+
+    posix_memalign((void **)&mgmtDataPool->stripes, 64, sizeof(BM_Stripe)*numStripes);
+
+    for(i=0;i<numStripes;i++){
+      hashTableInit(&mgmtDataPool->stripes[i].table, numPages/numStripes+1);
+
+      if(mgmtDataPool->concurrent){
+        pthread_mutex_init(&mgmtDataPool->stripes[i].latch, NULL);
+        pthread_cond_init(&mgmtDataPool->stripes[i].loaded, NULL);
+      }
+    }
+
+    //by now, the BM_mgmtData object has the memory space as well as all info about the file on disk.
+
+    //at last, save all info into BM_BufferPool, including the BM_mgmtData just created.
+    bm->pageFile=(char *)pageFileName;
+    bm->numPages=numPages;
+    bm->strategy=strategy;
+    bm->mgmtData=mgmtDataPool;
+
+    //8, start the background writer once the pool is complete
+    mgmtDataPool->writerRanks=NULL;
+    mgmtDataPool->writerOrder=NULL;
+
+    if(mgmtDataPool->dirtyTarget>0){
+      mgmtDataPool->writerRanks=(int *)malloc(sizeof(int)*capacity);
+      mgmtDataPool->writerOrder=(BM_FrameEntry *)malloc(sizeof(BM_FrameEntry)*capacity);
+      mgmtDataPool->writerStop=false;
+      pthread_mutex_init(&mgmtDataPool->writerLatch, NULL);
+      pthread_cond_init(&mgmtDataPool->writerWake, NULL);
+      pthread_create(&mgmtDataPool->writer, NULL, writerMain, bm);
+    }
+
+
+    return RC_OK;
+
+
+}
+
+
+//the pool must not be used by any other thread any more
+RC shutdownBufferPool(BM_BufferPool *const bm){
+
+    int i;
+    RC ret;
+
+    BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+
+    //stop the background writer first, the final flush below writes what it left
+    if(mgmtData->dirtyTarget>0){
+      pthread_mutex_lock(&mgmtData->writerLatch);
+      mgmtData->writerStop=true;
+      pthread_cond_signal(&mgmtData->writerWake);
+      pthread_mutex_unlock(&mgmtData->writerLatch);
+
+      pthread_join(mgmtData->writer, NULL);
+      pthread_mutex_destroy(&mgmtData->writerLatch);
+      pthread_cond_destroy(&mgmtData->writerWake);
+    }
+
+    //with a log the pages are synced too, so the log is empty and the next pool has nothing to redo. The pool is
+    //released even if a page could not be written, the error tells the caller that page is lost.
+    if(mgmtData->log!=NULL){
+      ret=checkpointBufferPool(bm);
+    }
+    else{
+      ret=forceFlushPool(bm);
+    }
+
+    //close the file before the handle is freed, this also waits for asynchronous reads still in flight and writes
+    //the checksum blocks a failed write left
+    if(!mgmtData->simulated && closePageFile(mgmtData->fileHandle)!=RC_OK && ret==RC_OK){
+      ret=RC_WRITE_FAILED;
+    }
+
+    //records lost by the last flush can no longer be found in getPoolStats, the error reports them
+    if(mgmtData->traceFd>=0){
+      long long dropped=mgmtData->traceDropped;
+
+      flushTrace(mgmtData);
+      if(mgmtData->traceDropped>dropped && ret==RC_OK){
+        ret=RC_WRITE_FAILED;
+      }
+      close(mgmtData->traceFd);
+      free(mgmtData->traceBuffer);
+      pthread_mutex_destroy(&mgmtData->traceLatch);
+    }
+
+    //release all of the frames at once
+    freeArena(mgmtData);
+
+    //free mgmtData
+    free(mgmtData->pages);
+    free(mgmtData->fileHandle);
+    free(mgmtData->LRU_Order);
+    free(mgmtData->refBits);
+    free(mgmtData->history);
+    free(mgmtData->lastRef);
+    free(mgmtData->retainedPages);
+    free(mgmtData->retainedLast);
+    free(mgmtData->retainedHistory);
+    free(mgmtData->lfuNodes);
+    free(mgmtData->lfuBuckets);
+
+    if(bm->strategy==RS_ARC){
+      free(mgmtData->arcFrames);
+      free(mgmtData->arcGhosts);
+      free(mgmtData->arcGhostPages);
+      hashTableFree(&mgmtData->arcGhostTable);
+    }
+
+    for(i=0;i<(1<<mgmtData->stripeBits);i++){
+      hashTableFree(&mgmtData->stripes[i].table);
+
+      if(mgmtData->concurrent){
+        pthread_mutex_destroy(&mgmtData->stripes[i].latch);
+        pthread_cond_destroy(&mgmtData->stripes[i].loaded);
+      }
+    }
+    free(mgmtData->stripes);
+
+    if(mgmtData->concurrent){
+      pthread_mutex_destroy(&mgmtData->replacementLatch);
+      pthread_mutex_destroy(&mgmtData->extendLatch);
+      pthread_mutex_destroy(&mgmtData->asyncLatch);
+    }
+
+    free(mgmtData->freeFrames);
+    free(mgmtData->loading);
+    free(mgmtData->asyncPins);
+    free(mgmtData->prefetched);
+    free(mgmtData->writerRanks);
+    free(mgmtData->writerOrder);
+    free(mgmtData->pageLsns);
+    free(mgmtData->recLsns);
+    free(mgmtData->stats);
+    free(mgmtData);
+
+    return ret;
+
+}
+
+static int compareFrameEntries (const void *a, const void *b){
+
+  int x=((const BM_FrameEntry *)a)->key;
+  int y=((const BM_FrameEntry *)b)->key;
+
+  return (x>y)-(x<y);
+
+}
+
+/*
+	Write back the frames in entries, each with its page number as key, that are still dirty and not pinned.
+	Returns the number of pages that could not be written, they are dirty again.
+	1, the frames are sorted by page number, so the file is written in ascending order and a run of consecutive
+	pages goes out with a single writeBlocks call.
+	2, they are taken BM_FLUSH_BATCH at a time. Each is pinned and marked clean under its stripe latch, then the
+	batch is written without any latch, so pins of other pages go on meanwhile.
+	3, a page dirtied again during the write keeps its dirty flag and is written by the next flush.
+*/
+static int flushFrames (BM_BufferPool *const bm, BM_mgmtData *mgmtData, BM_FrameEntry *entries, int count){
+
+  int i, j, k, frame, batchSize, numPinned, runStart, numFailed=0;
+  int pinned[BM_FLUSH_BATCH];
+  bool written[BM_FLUSH_BATCH];
+  PageNumber pages[BM_FLUSH_BATCH];
+  SM_PageHandle data[BM_FLUSH_BATCH];
+  WAL_Lsn lsns[BM_FLUSH_BATCH], recLsns[BM_FLUSH_BATCH], runLsn;
+  PageNumber pageNum;
+  BM_Stripe *stripe;
+
+  //keep most of a small pool available to other threads
+  batchSize=RELAXED_LOAD(bm->numPages)/4+1;
+  batchSize=(batchSize<BM_FLUSH_BATCH) ? batchSize : BM_FLUSH_BATCH;
+
+  qsort(entries, count, sizeof(BM_FrameEntry), compareFrameEntries);
+
+  for(i=0;i<count;){
+
+    //1, pin the next batch
+    for(numPinned=0;i<count && numPinned<batchSize;i++){
+
+      frame=entries[i].frame;
+      pageNum=entries[i].key;
+      stripe=stripeOf(mgmtData, pageNum);
+      latch(mgmtData, &stripe->latch);
+
+      //check again, the frame may have been replaced since it was looked at
+      if(RELAXED_LOAD(mgmtData->pages[frame].pageNum)!=pageNum || !UNPINNED(mgmtData->pages[frame])
+         || mgmtData->pages[frame].dirty==0 || mgmtData->loading[frame]){
+        unlatch(mgmtData, &stripe->latch);
+        continue;
+      }
+
+      pinFrame(mgmtData, frame);
+      RELAXED_STORE(mgmtData->pages[frame].dirty, 0);
+
+      pinned[numPinned]=frame;
+      pages[numPinned]=pageNum;
+      data[numPinned]=mgmtData->pages[frame].data;
+      lsns[numPinned]=(mgmtData->log!=NULL) ? mgmtData->pageLsns[frame] : 0;
+      recLsns[numPinned]=(mgmtData->log!=NULL) ? mgmtData->recLsns[frame] : BM_NO_LSN;
+      numPinned++;
+
+      unlatch(mgmtData, &stripe->latch);
+    }
+
+    //2, write the runs of consecutive pages, after the log up to the last change of any of them
+    for(runStart=0, runLsn=0, j=1;j<=numPinned;j++){
+
+      runLsn=(lsns[j-1]>runLsn) ? lsns[j-1] : runLsn;
+
+      if(j==numPinned || pages[j]!=pages[j-1]+1){
+
+        //pages not written keep their recLsn and become dirty again
+        bool ok=(writeFrames(mgmtData, pages[runStart], j-runStart, data+runStart, runLsn)==RC_OK);
+
+        for(k=runStart;k<j;k++){
+          written[k]=ok;
+        }
+        numFailed+=ok ? 0 : j-runStart;
+        runStart=j;
+        runLsn=0;
+      }
+    }
+
+    for(j=0;j<numPinned;j++){
+      if(written[j]){
+        frameWritten(mgmtData, pinned[j], recLsns[j]);
+      }
+      else{
+        frameNotWritten(mgmtData, pinned[j]);
+      }
+      unpinFrame(mgmtData, pinned[j]);
+    }
+  }
+
+  return numFailed;
+
+}
+
+//write back every dirty page that is not pinned, RC_WRITE_FAILED if any of them could not be written
+RC forceFlushPool(BM_BufferPool *const bm){
+
+  int i, count=0, numFailed;
+  int numPages=RELAXED_LOAD(bm->numPages);
+  PageNumber pageNum;
+
+  //because mgmtData is void type in struct, so have to coerce it into BM_mgmtData
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_FrameEntry *entries=(BM_FrameEntry *)malloc(sizeof(BM_FrameEntry)*numPages);
+
+  for(i=0;i<numPages;i++){
+
+    pageNum=RELAXED_LOAD(mgmtData->pages[i].pageNum);
+
+    if(pageNum!=NO_PAGE && RELAXED_LOAD(mgmtData->pages[i].dirty)){
+      entries[count].key=pageNum;
+      entries[count].frame=i;
+      count++;
+    }
+  }
+
+  numFailed=flushFrames(bm, mgmtData, entries, count);
+
+  free(entries);
+
+  return (numFailed>0) ? RC_WRITE_FAILED : RC_OK;
+
+}
+
+// Buffer Manager Interface Access Pages
+RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
+
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_Stripe *stripe=stripeOf(mgmtData, page->pageNum);
+
+  traceOp(mgmtData, BM_TRACE_DIRTY, page->pageNum);
+
+  //find the page in the buffer pool
+  latch(mgmtData, &stripe->latch);
+
+  int position=findFrame(mgmtData, page->pageNum);
+
+  if(position!=-1){
+
+    RELAXED_STORE(mgmtData->pages[position].dirty, 1);
+
+  }
+
+  unlatch(mgmtData, &stripe->latch);
+
+  return RC_OK;
+
+}
+
+/*
+	markDirty for a pool with a write-ahead log, the caller has changed the length bytes from offset on of a
+	pinned page.
+	1, a redo record with the new bytes is appended to the log, lsn is its LSN. flushLog(log, lsn) commits it.
+	2, the frame remembers the LSN, so the page is not written before the record is on disk. The log end taken
+	before appending is its recLsn if the frame had no unwritten logged change yet, a checkpoint keeps the log
+	from there on.
+*/
+RC markDirtyLogged (BM_BufferPool *const bm, BM_PageHandle *const page, int offset, int length, WAL_Lsn *lsn){
+
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_Stripe *stripe=stripeOf(mgmtData, page->pageNum);
+  WAL_Lsn start, end;
+  RC ret;
+
+  if(mgmtData->log==NULL){
+    return RC_WRITE_FAILED;
+  }
+
+  traceOp(mgmtData, BM_TRACE_DIRTY, page->pageNum);
+
+  start=getLogEnd(mgmtData->log);
+
+  ret=appendLogRecord(mgmtData->log, page->pageNum, offset, length, page->data+offset, &end);
+
+  if(ret!=RC_OK){
+    return ret;
+  }
+
+  latch(mgmtData, &stripe->latch);
+
+  int position=findFrame(mgmtData, page->pageNum);
+
+  if(position!=-1){
+
+    RELAXED_STORE(mgmtData->pages[position].dirty, 1);
+
+    if(mgmtData->pageLsns[position]<end){
+      mgmtData->pageLsns[position]=end;
+    }
+    if(mgmtData->recLsns[position]==BM_NO_LSN){
+      __atomic_store_n(&mgmtData->recLsns[position], start, __ATOMIC_RELEASE);
+    }
+
+  }
+
+  unlatch(mgmtData, &stripe->latch);
+
+  if(lsn!=NULL){
+    *lsn=end;
+  }
+
+  return RC_OK;
+
+}
+
+/*
+	Write back the dirty pages, sync the page file and drop the log records no page needs any more.
+	1, the log end is taken first, the pages written below hold every change logged before it.
+	2, after forceFlushPool the oldest unwritten change is looked up in recLsns, pages still dirty (pinned) or
+	being written by another thread have one. Then unsyncedLsn is taken for the pages written since the last
+	checkpoint, only after that the page file is synced, so every one of those writes is on disk.
+	3, the log is truncated at the oldest of these positions.
+	A pool without a log is just flushed and synced. If a page cannot be written the checkpoint stops there and
+	leaves the log as it is.
+*/
+RC checkpointBufferPool(BM_BufferPool *const bm){
+
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  WAL_Lsn lsn, recLsn, unsynced;
+  int i, numPages=RELAXED_LOAD(bm->numPages);
+
+  if(mgmtData->log==NULL){
+    if(forceFlushPool(bm)!=RC_OK){
+      return RC_WRITE_FAILED;
+    }
+    return mgmtData->simulated ? RC_OK : syncPageFile(mgmtData->fileHandle);
+  }
+
+  lsn=getLogEnd(mgmtData->log);
+
+  if(forceFlushPool(bm)!=RC_OK){
+    return RC_WRITE_FAILED;
+  }
+
+  for(i=0;i<numPages;i++){
+    recLsn=__atomic_load_n(&mgmtData->recLsns[i], __ATOMIC_ACQUIRE);
+    lsn=(recLsn<lsn) ? recLsn : lsn;
+  }
+
+  unsynced=__atomic_exchange_n(&mgmtData->unsyncedLsn, BM_NO_LSN, __ATOMIC_ACQ_REL);
+  lsn=(unsynced<lsn) ? unsynced : lsn;
+
+  if(syncPageFile(mgmtData->fileHandle)!=RC_OK){
+    lowerLsn(&mgmtData->unsyncedLsn, unsynced);
+    return RC_WRITE_FAILED;
+  }
+
+  return truncateLog(mgmtData->log, lsn);
+
+}
+
+
+RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page){
+
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_Stripe *stripe=stripeOf(mgmtData, page->pageNum);
+
+  traceOp(mgmtData, BM_TRACE_UNPIN, page->pageNum);
+
+  //find the page in the buffer pool, the caller's pin keeps it there after the latch is released
+  latch(mgmtData, &stripe->latch);
+
+  int position=findFrame(mgmtData, page->pageNum);
+
+  unlatch(mgmtData, &stripe->latch);
+
+  if(position!=-1){
+
+    unpinFrame(mgmtData, position);
+
+  }
+
+  
+  return RC_OK;
+
+}
+
+
+//assume that input BM_PageHandle has the page number and the data.
+RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page){
+  
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_Stripe *stripe=stripeOf(mgmtData, page->pageNum);
+  WAL_Lsn lsn=0, recLsn=BM_NO_LSN;
+
+  traceOp(mgmtData, BM_TRACE_FORCE, page->pageNum);
+
+  //find the page in the buffer pool, pin it for the write and change the dirty to 0
+  latch(mgmtData, &stripe->latch);
+
+  int position=findFrame(mgmtData, page->pageNum);
+
+  if(position!=-1){
+    pinFrame(mgmtData, position);
+    RELAXED_STORE(mgmtData->pages[position].dirty, 0);
+
+    if(mgmtData->log!=NULL){
+      lsn=mgmtData->pageLsns[position];
+      recLsn=mgmtData->recLsns[position];
+    }
+  }
+
+  unlatch(mgmtData, &stripe->latch);
+
+  RC ret=writeFrame(mgmtData, page->pageNum, page->data, lsn);
+
+  //a failed write leaves the page dirty, it is written again later
+  if(position!=-1){
+    if(ret==RC_OK){
+      frameWritten(mgmtData, position, recLsn);
+    }
+    else{
+      frameNotWritten(mgmtData, position);
+    }
+    unpinFrame(mgmtData, position);
+  }
+
+  return ret;
+
+}
+
+/*
+	Replacement strategy hooks. pinPage only calls these, so a strategy lives entirely in them.
+	1, strategyHit() is called when a pin finds its page already in the buffer pool, the frame is pinned.
+	2, strategyLoad() is called after a page has been read into a frame.
+	3, chooseVictim() returns an unpinned frame to replace for pageNum, or -1 if every frame is pinned. It is
+	only called when there is no free frame. The pin counts may change under it in a concurrent pool, the
+	caller checks the victim again under its stripe latch.
+	4, strategyEvict() is called for the victim while the frame still holds the old page.
+	5, strategyMove() is called when resizeBufferPool() moves an unpinned page to another frame.
+	All but strategyHit() run under the replacement latch.
+*/
+
+/*
+	LRU-K, following O'Neil et al.
+	1, a reference within correlatedPeriod ticks of the last one is correlated, it only moves lastRef. An
+	uncorrelated reference shifts the history by one and closes the correlated period of the previous one,
+	by moving the older history entries forward by its length.
+	2, the victim is the unpinned, uncorrelated page with the largest backward K-distance, that is the
+	oldest K-th reference. Pages with less than K references have an infinite distance and are taken first,
+	the least recently used among them.
+	3, the history of an evicted page is retained, so a page that comes back within retainedPeriod ticks
+	(0 means no limit) continues its history instead of starting over like a page seen by a one-off scan.
+*/
+
+static void lruKReference (BM_mgmtData *mgmtData, int frame, int now){
+
+  int *hist=mgmtData->history+frame*mgmtData->lruK;
+  int i, correlated;
+
+  if(now-mgmtData->lastRef[frame]>mgmtData->correlatedPeriod){
+
+    correlated=mgmtData->lastRef[frame]-hist[0];
+
+    for(i=mgmtData->lruK-1;i>0;i--){
+      hist[i]=(hist[i-1]==-1) ? -1 : hist[i-1]+correlated;
+    }
+
+    hist[0]=now;
+  }
+
+  mgmtData->lastRef[frame]=now;
+
+}
+
+static void lruKLoad (BM_mgmtData *mgmtData, int frame, int now){
+
+  int *hist=mgmtData->history+frame*mgmtData->lruK;
+  int slot=(int)(hashPage(mgmtData->pages[frame].pageNum) & (unsigned int)mgmtData->retainedMask);
+  int i;
+
+  if(mgmtData->retainedPages[slot]==mgmtData->pages[frame].pageNum
+     && (mgmtData->retainedPeriod==0 || now-mgmtData->retainedLast[slot]<=mgmtData->retainedPeriod)){
+
+    int *retained=mgmtData->retainedHistory+slot*mgmtData->lruK;
+
+    for(i=mgmtData->lruK-1;i>0;i--){
+      hist[i]=retained[i-1];
+    }
+
+    mgmtData->retainedPages[slot]=NO_PAGE;
+  }
+  else{
+
+    for(i=1;i<mgmtData->lruK;i++){
+      hist[i]=-1;
+    }
+  }
+
+  hist[0]=now;
+  mgmtData->lastRef[frame]=now;
+
+}
+
+static void lruKEvict (BM_mgmtData *mgmtData, int frame){
+
+  int slot=(int)(hashPage(mgmtData->pages[frame].pageNum) & (unsigned int)mgmtData->retainedMask);
+
+  mgmtData->retainedPages[slot]=mgmtData->pages[frame].pageNum;
+  mgmtData->retainedLast[slot]=mgmtData->lastRef[frame];
+  memcpy(mgmtData->retainedHistory+slot*mgmtData->lruK, mgmtData->history+frame*mgmtData->lruK,
+         sizeof(int)*mgmtData->lruK);
+
+}
+
+/*
+	LFU with frequency buckets.
+	1, every frame sits in the bucket of its reference count, a reference moves it to the head of the
+	bucket with count+1, which is either the next bucket or a new one linked right after its own.
+	2, the victim is the least recently used unpinned frame of the lowest bucket, so ties are broken by LRU.
+	3, both steps are O(1), only pinned frames at the tail of the lowest buckets can make the search longer.
+	4, with aging on, all counts are halved every agingPeriod references. Buckets that end up with the same
+	count are merged, which is O(numPages) but happens at most once per agingPeriod references.
+*/
+
+static int lfuNewBucket (BM_mgmtData *mgmtData, int count, int prev){
+
+  int b=mgmtData->lfuFreeBucket;
+  LFU_Bucket *bucket=mgmtData->lfuBuckets+b;
+
+  mgmtData->lfuFreeBucket=bucket->next;
+
+  bucket->count=count;
+  bucket->head=-1;
+  bucket->tail=-1;
+  bucket->prev=prev;
+
+  if(prev==-1){
+    bucket->next=mgmtData->lfuLowest;
+    mgmtData->lfuLowest=b;
+  }
+  else{
+    bucket->next=mgmtData->lfuBuckets[prev].next;
+    mgmtData->lfuBuckets[prev].next=b;
+  }
+
+  if(bucket->next!=-1){
+    mgmtData->lfuBuckets[bucket->next].prev=b;
+  }
+
+  return b;
+
+}
+
+static void lfuFreeBucket (BM_mgmtData *mgmtData, int b){
+
+  LFU_Bucket *bucket=mgmtData->lfuBuckets+b;
+
+  if(bucket->prev==-1){
+    mgmtData->lfuLowest=bucket->next;
+  }
+  else{
+    mgmtData->lfuBuckets[bucket->prev].next=bucket->next;
+  }
+
+  if(bucket->next!=-1){
+    mgmtData->lfuBuckets[bucket->next].prev=bucket->prev;
+  }
+
+  bucket->next=mgmtData->lfuFreeBucket;
+  mgmtData->lfuFreeBucket=b;
+
+}
+
+static void lfuPushHead (BM_mgmtData *mgmtData, int b, int frame){
+
+  LFU_Node *node=mgmtData->lfuNodes+frame;
+  LFU_Bucket *bucket=mgmtData->lfuBuckets+b;
+
+  node->bucket=b;
+  node->prev=-1;
+  node->next=bucket->head;
+
+  if(bucket->head!=-1){
+    mgmtData->lfuNodes[bucket->head].prev=frame;
+  }
+  else{
+    bucket->tail=frame;
+  }
+
+  bucket->head=frame;
+
+}
+
+//take the frame out of its bucket, the bucket itself stays even if it is empty now
+static void lfuUnlink (BM_mgmtData *mgmtData, int frame){
+
+  LFU_Node *node=mgmtData->lfuNodes+frame;
+  LFU_Bucket *bucket=mgmtData->lfuBuckets+node->bucket;
+
+  if(node->prev!=-1){
+    mgmtData->lfuNodes[node->prev].next=node->next;
+  }
+  else{
+    bucket->head=node->next;
+  }
+
+  if(node->next!=-1){
+    mgmtData->lfuNodes[node->next].prev=node->prev;
+  }
+  else{
+    bucket->tail=node->prev;
+  }
+
+}
+
+static void lfuAge (BM_mgmtData *mgmtData){
+
+  int b, next, frame, count;
+  int last=-1;
+
+  for(b=mgmtData->lfuLowest;b!=-1;b=next){
+
+    LFU_Bucket *bucket=mgmtData->lfuBuckets+b;
+
+    next=bucket->next;
+    count=bucket->count/2;
+    if(count<1){
+      count=1;
+    }
+
+    if(last==-1 || mgmtData->lfuBuckets[last].count!=count){
+      bucket->count=count;
+      last=b;
+      continue;
+    }
+
+    //same count as the bucket before, the frames of this one were used more often so they go to the head
+    for(frame=bucket->head;frame!=-1;frame=mgmtData->lfuNodes[frame].next){
+      mgmtData->lfuNodes[frame].bucket=last;
+    }
+
+    if(bucket->head!=-1){
+      LFU_Bucket *merged=mgmtData->lfuBuckets+last;
+
+      mgmtData->lfuNodes[bucket->tail].next=merged->head;
+      if(merged->head!=-1){
+        mgmtData->lfuNodes[merged->head].prev=bucket->tail;
+      }
+      else{
+        merged->tail=bucket->tail;
+      }
+      merged->head=bucket->head;
+    }
+
+    lfuFreeBucket(mgmtData, b);
+  }
+
+}
+
+static void lfuReference (BM_mgmtData *mgmtData, int frame){
+
+  int b=mgmtData->lfuNodes[frame].bucket;
+  int next=mgmtData->lfuBuckets[b].next;
+  int count=mgmtData->lfuBuckets[b].count+1;
+
+  if(next==-1 || mgmtData->lfuBuckets[next].count!=count){
+    next=lfuNewBucket(mgmtData, count, b);
+  }
+
+  lfuUnlink(mgmtData, frame);
+  lfuPushHead(mgmtData, next, frame);
+
+  if(mgmtData->lfuBuckets[b].head==-1){
+    lfuFreeBucket(mgmtData, b);
+  }
+
+  if(mgmtData->agingPeriod>0 && --mgmtData->agingCountdown==0){
+    lfuAge(mgmtData);
+    mgmtData->agingCountdown=mgmtData->agingPeriod;
+  }
+
+}
+
+static void lfuLoad (BM_mgmtData *mgmtData, int frame){
+
+  int b=mgmtData->lfuLowest;
+
+  if(b==-1 || mgmtData->lfuBuckets[b].count!=1){
+    b=lfuNewBucket(mgmtData, 1, -1);
+  }
+
+  lfuPushHead(mgmtData, b, frame);
+
+}
+
+static void lfuEvict (BM_mgmtData *mgmtData, int frame){
+
+  int b=mgmtData->lfuNodes[frame].bucket;
+
+  lfuUnlink(mgmtData, frame);
+
+  if(mgmtData->lfuBuckets[b].head==-1){
+    lfuFreeBucket(mgmtData, b);
+  }
+
+}
+
+//the page of frame from moves to frame to, which takes over its place in the bucket
+static void lfuMove (BM_mgmtData *mgmtData, int from, int to){
+
+  LFU_Node *node=mgmtData->lfuNodes+to;
+  LFU_Bucket *bucket=mgmtData->lfuBuckets+mgmtData->lfuNodes[from].bucket;
+
+  *node=mgmtData->lfuNodes[from];
+
+  if(node->prev!=-1){
+    mgmtData->lfuNodes[node->prev].next=to;
+  }
+  else{
+    bucket->head=to;
+  }
+
+  if(node->next!=-1){
+    mgmtData->lfuNodes[node->next].prev=to;
+  }
+  else{
+    bucket->tail=to;
+  }
+
+}
+
+static int lfuVictim (BM_mgmtData *mgmtData){
+
+  int b, frame;
+
+  for(b=mgmtData->lfuLowest;b!=-1;b=mgmtData->lfuBuckets[b].next){
+
+    for(frame=mgmtData->lfuBuckets[b].tail;frame!=-1;frame=mgmtData->lfuNodes[frame].prev){
+
+      if(RELAXED_LOAD(mgmtData->pages[frame].pin_fix_count)==0){
+        return frame;
+      }
+    }
+  }
+
+  return -1;
+
+}
+
+/*
+	ARC, following Megiddo and Modha.
+	1, T1 holds pages seen once recently, T2 pages seen at least twice. B1 and B2 remember the pages
+	last evicted from T1 and T2.
+	2, a miss that hits a ghost in B1 means T1 was too small, arcTarget grows. A ghost in B2 shrinks it. This is
+	done once per miss when the page is loaded, so the target takes effect from the next victim on.
+	3, the victim comes from T1 while T1 is larger than arcTarget, otherwise from T2, the least recently used
+	unpinned frame of that list. If all frames of that list are pinned the other list is used.
+	4, evicted pages become ghosts, and the ghost lists are trimmed to the bounds of the paper, with c the pool
+	size: |T1|+|B1| <= c, and |T1|+|T2|+|B1|+|B2| <= 2c.
+*/
+
+static void arcPushHead (BM_mgmtData *mgmtData, ARC_Node *nodes, int list, int entry){
+
+  ARC_List *l=mgmtData->arcLists+list;
+
+  nodes[entry].list=list;
+  nodes[entry].prev=-1;
+  nodes[entry].next=l->head;
+
+  if(l->head!=-1){
+    nodes[l->head].prev=entry;
+  }
+  else{
+    l->tail=entry;
+  }
+
+  l->head=entry;
+  l->size++;
+
+}
+
+static void arcUnlink (BM_mgmtData *mgmtData, ARC_Node *nodes, int entry){
+
+  ARC_List *l=mgmtData->arcLists+nodes[entry].list;
+
+  if(nodes[entry].prev!=-1){
+    nodes[nodes[entry].prev].next=nodes[entry].next;
+  }
+  else{
+    l->head=nodes[entry].next;
+  }
+
+  if(nodes[entry].next!=-1){
+    nodes[nodes[entry].next].prev=nodes[entry].prev;
+  }
+  else{
+    l->tail=nodes[entry].prev;
+  }
+
+  l->size--;
+
+}
+
+static void arcDropGhost (BM_mgmtData *mgmtData, int ghost){
+
+  arcUnlink(mgmtData, mgmtData->arcGhosts, ghost);
+  hashTableRemove(&mgmtData->arcGhostTable, mgmtData->arcGhostPages[ghost]);
+
+  mgmtData->arcGhosts[ghost].next=mgmtData->arcFreeGhost;
+  mgmtData->arcFreeGhost=ghost;
+
+}
+
+//the least recently used unpinned frame of T1 or T2
+static int arcLRUUnpinned (BM_mgmtData *mgmtData, int list){
+
+  int frame;
+
+  for(frame=mgmtData->arcLists[list].tail;frame!=-1;frame=mgmtData->arcFrames[frame].prev){
+    if(RELAXED_LOAD(mgmtData->pages[frame].pin_fix_count)==0){
+      return frame;
+    }
+  }
+
+  return -1;
+
+}
+
+static int arcVictim (BM_mgmtData *mgmtData, PageNumber pageNum){
+
+  int ghost=hashTableFind(&mgmtData->arcGhostTable, pageNum);
+  int ghostList=(ghost!=-1) ? mgmtData->arcGhosts[ghost].list : -1;
+  int t1=mgmtData->arcLists[ARC_T1].size;
+  int first, victim;
+
+  if(t1>0 && (t1>mgmtData->arcTarget || (ghostList==ARC_B2 && t1==mgmtData->arcTarget))){
+    first=ARC_T1;
+  }
+  else{
+    first=ARC_T2;
+  }
+
+  victim=arcLRUUnpinned(mgmtData, first);
+
+  if(victim==-1){
+    victim=arcLRUUnpinned(mgmtData, (first==ARC_T1) ? ARC_T2 : ARC_T1);
+  }
+
+  return victim;
+
+}
+
+static void arcEvict (BM_mgmtData *mgmtData, int frame){
+
+  int ghost;
+  int list=(mgmtData->arcFrames[frame].list==ARC_T1) ? ARC_B1 : ARC_B2;
+
+  arcUnlink(mgmtData, mgmtData->arcFrames, frame);
+
+  //in a concurrent pool frames that are still being read are in no list yet, so the trimming in arcLoad
+  //can fall behind, make room here instead
+  if(mgmtData->arcFreeGhost==-1){
+    arcDropGhost(mgmtData, mgmtData->arcLists[ARC_B1].size>0 ? mgmtData->arcLists[ARC_B1].tail
+                                                             : mgmtData->arcLists[ARC_B2].tail);
+  }
+
+  ghost=mgmtData->arcFreeGhost;
+
+  mgmtData->arcFreeGhost=mgmtData->arcGhosts[ghost].next;
+  mgmtData->arcGhostPages[ghost]=mgmtData->pages[frame].pageNum;
+  arcPushHead(mgmtData, mgmtData->arcGhosts, list, ghost);
+  hashTableInsert(&mgmtData->arcGhostTable, mgmtData->pages[frame].pageNum, ghost);
+
+}
+
+//drop the oldest ghosts until |T1|+|B1| fits the pool size and all four lists fit twice the pool size. The oldest
+//ghosts of B2 go first for the second bound, B1 only once B2 is empty.
+static void arcTrimGhosts (BM_BufferPool *const bm, BM_mgmtData *mgmtData){
+
+  ARC_List *lists=mgmtData->arcLists;
+
+  while(lists[ARC_B1].size>0 && lists[ARC_T1].size+lists[ARC_B1].size>bm->numPages){
+    arcDropGhost(mgmtData, lists[ARC_B1].tail);
+  }
+
+  while(lists[ARC_B1].size+lists[ARC_B2].size>0
+        && lists[ARC_T1].size+lists[ARC_T2].size+lists[ARC_B1].size+lists[ARC_B2].size>2*bm->numPages){
+    arcDropGhost(mgmtData, lists[ARC_B2].size>0 ? lists[ARC_B2].tail : lists[ARC_B1].tail);
+  }
+
+}
+
+static void arcLoad (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int frame){
+
+  int ghost=hashTableFind(&mgmtData->arcGhostTable, mgmtData->pages[frame].pageNum);
+  int b1=mgmtData->arcLists[ARC_B1].size;
+  int b2=mgmtData->arcLists[ARC_B2].size;
+
+  //a page coming back from a ghost list has been seen twice, and adapts the target size of T1
+  if(ghost!=-1){
+    if(mgmtData->arcGhosts[ghost].list==ARC_B1){
+      mgmtData->arcTarget+=(b2>b1) ? b2/b1 : 1;
+      if(mgmtData->arcTarget>bm->numPages){
+        mgmtData->arcTarget=bm->numPages;
+      }
+    }
+    else{
+      mgmtData->arcTarget-=(b1>b2) ? b1/b2 : 1;
+      if(mgmtData->arcTarget<0){
+        mgmtData->arcTarget=0;
+      }
+    }
+
+    arcDropGhost(mgmtData, ghost);
+    arcPushHead(mgmtData, mgmtData->arcFrames, ARC_T2, frame);
+  }
+  else{
+    arcPushHead(mgmtData, mgmtData->arcFrames, ARC_T1, frame);
+  }
+
+  arcTrimGhosts(bm, mgmtData);
+
+}
+
+//the page of frame from moves to frame to, which takes over its place in T1 or T2
+static void arcMove (BM_mgmtData *mgmtData, int from, int to){
+
+  ARC_Node *nodes=mgmtData->arcFrames;
+  ARC_List *l=mgmtData->arcLists+nodes[from].list;
+
+  nodes[to]=nodes[from];
+
+  if(nodes[to].prev!=-1){
+    nodes[nodes[to].prev].next=to;
+  }
+  else{
+    l->head=to;
+  }
+
+  if(nodes[to].next!=-1){
+    nodes[nodes[to].next].prev=to;
+  }
+  else{
+    l->tail=to;
+  }
+
+}
+
+static void arcReference (BM_mgmtData *mgmtData, int frame){
+
+  arcUnlink(mgmtData, mgmtData->arcFrames, frame);
+  arcPushHead(mgmtData, mgmtData->arcFrames, ARC_T2, frame);
+
+}
+
+static int lruKVictim (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int now){
+
+  int g, position, fallback, kth, first;
+  int lruK=mgmtData->lruK;
+
+  position=-1;
+  fallback=-1;
+
+  for(g=0;g<bm->numPages;g++){
+
+    if(RELAXED_LOAD(mgmtData->pages[g].pin_fix_count)>0){
+      continue;
+    }
+
+    //only used if every unpinned page is still inside its correlated period
+    if(fallback==-1 || mgmtData->lastRef[g]<mgmtData->lastRef[fallback]){
+      fallback=g;
+    }
+
+    if(now-mgmtData->lastRef[g]<=mgmtData->correlatedPeriod){
+      continue;
+    }
+
+    if(position==-1){
+      position=g;
+      continue;
+    }
+
+    //-1 is an infinite distance, compare the K-th reference first and the most recent one on a tie
+    kth=mgmtData->history[g*lruK+lruK-1];
+    first=mgmtData->history[position*lruK+lruK-1];
+
+    if(kth<first || (kth==first && mgmtData->history[g*lruK]<mgmtData->history[position*lruK])){
+      position=g;
+    }
+  }
+
+  return (position!=-1) ? position : fallback;
+
+}
+
+static void strategyHit (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int frame){
+
+  switch(bm->strategy){
+
+    case RS_LRU:
+      RELAXED_STORE(mgmtData->LRU_Order[frame], nextTick(mgmtData));
+      break;
+
+    case RS_CLOCK:
+      //a hit only sets the reference bit, the clock hand gives the frame a second chance
+      RELAXED_STORE(mgmtData->refBits[frame], 1);
+      break;
+
+    //the list based strategies need the replacement latch even on a hit
+    case RS_LRU_K:
+      latch(mgmtData, &mgmtData->replacementLatch);
+      lruKReference(mgmtData, frame, nextTick(mgmtData));
+      unlatch(mgmtData, &mgmtData->replacementLatch);
+      break;
+
+    case RS_LFU:
+      latch(mgmtData, &mgmtData->replacementLatch);
+      lfuReference(mgmtData, frame);
+      unlatch(mgmtData, &mgmtData->replacementLatch);
+      break;
+
+    case RS_ARC:
+      latch(mgmtData, &mgmtData->replacementLatch);
+      arcReference(mgmtData, frame);
+      unlatch(mgmtData, &mgmtData->replacementLatch);
+      break;
+
+    default:
+      //FIFO keeps the load order
+      break;
+  }
+
+}
+
+static void strategyLoad (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int frame){
+
+  switch(bm->strategy){
+
+    case RS_CLOCK:
+      RELAXED_STORE(mgmtData->refBits[frame], 1);
+      break;
+
+    case RS_LRU_K:
+      lruKLoad(mgmtData, frame, nextTick(mgmtData));
+      break;
+
+    case RS_LFU:
+      lfuLoad(mgmtData, frame);
+      break;
+
+    case RS_ARC:
+      arcLoad(bm, mgmtData, frame);
+      break;
+
+    default:
+      RELAXED_STORE(mgmtData->LRU_Order[frame], nextTick(mgmtData));
+      break;
+  }
+
+}
+
+static void strategyEvict (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int frame){
+
+  switch(bm->strategy){
+
+    case RS_LRU_K:
+      lruKEvict(mgmtData, frame);
+      break;
+
+    case RS_LFU:
+      lfuEvict(mgmtData, frame);
+      break;
+
+    case RS_ARC:
+      arcEvict(mgmtData, frame);
+      break;
+
+    default:
+      break;
+  }
+
+}
+
+static void strategyMove (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int from, int to){
+
+  switch(bm->strategy){
+
+    case RS_CLOCK:
+      RELAXED_STORE(mgmtData->refBits[to], RELAXED_LOAD(mgmtData->refBits[from]));
+      break;
+
+    case RS_LRU_K:
+      memcpy(mgmtData->history+to*mgmtData->lruK, mgmtData->history+from*mgmtData->lruK, sizeof(int)*mgmtData->lruK);
+      mgmtData->lastRef[to]=mgmtData->lastRef[from];
+      break;
+
+    case RS_LFU:
+      lfuMove(mgmtData, from, to);
+      break;
+
+    case RS_ARC:
+      arcMove(mgmtData, from, to);
+      break;
+
+    default:
+      RELAXED_STORE(mgmtData->LRU_Order[to], RELAXED_LOAD(mgmtData->LRU_Order[from]));
+      break;
+  }
+
+}
+
+//FIFO and LRU, the unpinned frame with the smallest LRU_Order number
+static int lruVictim (BM_BufferPool *const bm, BM_mgmtData *mgmtData){
+
+  int g, position, min_value;
+
+  position = -1;
+  min_value = 0;
+
+  for (g=0;g<bm->numPages;g++){
+
+    if(RELAXED_LOAD(mgmtData->pages[g].pin_fix_count) == 0
+       && (position == -1 || RELAXED_LOAD(mgmtData->LRU_Order[g])<min_value))
+    {
+      min_value=RELAXED_LOAD(mgmtData->LRU_Order[g]);
+      position=g;
+    }
+  }
+
+  return position;
+
+}
+
+/*
+	CLOCK (second chance).
+	1, the hand sweeps the frames in a circle, a frame with its reference bit set loses the bit and is skipped.
+	2, the first unpinned frame without reference bit is the victim, the hand stops right after it.
+	3, every bit the hand clears was set by one access, so the sweep is amortized O(1) per eviction. Two full
+	turns are enough, if nothing is found by then every frame is pinned.
+*/
+static int clockVictim (BM_BufferPool *const bm, BM_mgmtData *mgmtData){
+
+  int i, frame;
+
+  for(i=0;i<2*bm->numPages;i++){
+
+    frame=mgmtData->clockHand;
+
+    mgmtData->clockHand++;
+    if(mgmtData->clockHand==bm->numPages){
+      mgmtData->clockHand=0;
+    }
+
+    if(RELAXED_LOAD(mgmtData->pages[frame].pin_fix_count)>0){
+      continue;
+    }
+
+    if(RELAXED_LOAD(mgmtData->refBits[frame])){
+      RELAXED_STORE(mgmtData->refBits[frame], 0);
+      continue;
+    }
+
+    return frame;
+  }
+
+  return -1;
+
+}
+
+static int chooseVictim (BM_BufferPool *const bm, BM_mgmtData *mgmtData, PageNumber pageNum){
+
+  switch(bm->strategy){
+
+    case RS_CLOCK:
+      return clockVictim(bm, mgmtData);
+
+    case RS_LRU_K:
+      return lruKVictim(bm, mgmtData, mgmtData->tick);
+
+    case RS_LFU:
+      return lfuVictim(mgmtData);
+
+    case RS_ARC:
+      return arcVictim(mgmtData, pageNum);
+
+    default:
+      return lruVictim(bm, mgmtData);
+  }
+
+}
+
+/*
+	The order chooseVictim() would evict the frames in, for the background writer. ranks[frame] gets a number
+	that is smaller the sooner the frame is evicted, frames outside the order get INT_MAX. Runs under the
+	replacement latch.
+	1, FIFO and LRU evict by LRU_Order, LRU-K by the K-th reference, where -1 (infinite distance) comes first.
+	2, CLOCK evicts by the distance ahead of the hand, a frame with its reference bit set only after a full turn.
+	3, LFU evicts bucket by bucket from the lowest count, each bucket from its tail. ARC evicts from the list
+	arcVictim() currently prefers first, each list from its tail.
+*/
+static void strategyRanks (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int *ranks){
+
+  int i, b, list, frame, rank;
+  int n=bm->numPages;
+
+  switch(bm->strategy){
+
+    case RS_CLOCK:
+      for(i=0;i<n;i++){
+        ranks[i]=(i-mgmtData->clockHand+n)%n+(RELAXED_LOAD(mgmtData->refBits[i]) ? n : 0);
+      }
+      break;
+
+    case RS_LRU_K:
+      for(i=0;i<n;i++){
+        ranks[i]=mgmtData->history[i*mgmtData->lruK+mgmtData->lruK-1];
+      }
+      break;
+
+    case RS_LFU:
+      for(i=0;i<n;i++){
+        ranks[i]=INT_MAX;
+      }
+
+      rank=0;
+      for(b=mgmtData->lfuLowest;b!=-1;b=mgmtData->lfuBuckets[b].next){
+        for(frame=mgmtData->lfuBuckets[b].tail;frame!=-1;frame=mgmtData->lfuNodes[frame].prev){
+          ranks[frame]=rank++;
+        }
+      }
+      break;
+
+    case RS_ARC:
+      for(i=0;i<n;i++){
+        ranks[i]=INT_MAX;
+      }
+
+      list=(mgmtData->arcLists[ARC_T1].size>mgmtData->arcTarget) ? ARC_T1 : ARC_T2;
+
+      rank=0;
+      for(i=0;i<2;i++){
+        for(frame=mgmtData->arcLists[list].tail;frame!=-1;frame=mgmtData->arcFrames[frame].prev){
+          ranks[frame]=rank++;
+        }
+        list=(list==ARC_T1) ? ARC_T2 : ARC_T1;
+      }
+      break;
+
+    default:
+      for(i=0;i<n;i++){
+        ranks[i]=RELAXED_LOAD(mgmtData->LRU_Order[i]);
+      }
+      break;
+  }
+
+}
+
+//a ring uses at most an eighth of the frames of the pool as it is now, so it follows a resize
+static void ringCap (BM_BufferPool *const bm, BM_AccessRing *ring){
+
+  BM_RingData *ringData=(BM_RingData *)ring->mgmtData;
+  int limit=RELAXED_LOAD(bm->numPages)/8;
+
+  ring->numFrames=(ringData->size<limit) ? ringData->size : ((limit>0) ? limit : 1);
+
+  if(ringData->next>=ring->numFrames){
+    ringData->next=0;
+  }
+
+}
+
+//the frame of the ring's next slot, if it still holds the page the ring read into it and nobody has it pinned.
+//A scan leaves a frame that somebody dirtied to the replacement strategy, a bulk write has it written back.
+//Returns -1 if the slot cannot be recycled. Runs under the replacement latch, where the page of a frame cannot change.
+static int ringVictim (BM_BufferPool *const bm, BM_mgmtData *mgmtData, BM_AccessRing *ring){
+
+  BM_RingData *ringData=(BM_RingData *)ring->mgmtData;
+  int frame;
+
+  ringCap(bm, ring);
+  frame=ringData->frames[ringData->next];
+
+  if(frame==-1 || mgmtData->pages[frame].pageNum!=ringData->pages[ringData->next]
+     || RELAXED_LOAD(mgmtData->pages[frame].pin_fix_count)>0){
+    return -1;
+  }
+
+  if(ring->hint==BM_HINT_SCAN && RELAXED_LOAD(mgmtData->pages[frame].dirty)){
+    return -1;
+  }
+
+  return frame;
+
+}
+
+/*
+	Find a frame for pageNum after a miss.
+	1, the frame of an access ring is recycled first, then a free frame is used, otherwise the strategy picks a
+	victim. The victim is checked again under its stripe latch, where its pin count cannot go up.
+	2, a dirty victim is written back while it is still registered under its old page, so nobody reads a stale
+	copy from disk in the meantime. It is pinned for the write, in a concurrent pool the caller starts over
+	afterwards. If the write fails the victim stays dirty in its frame and -3 is returned. With cleanOnly a dirty
+	victim is left alone and -1 returned.
+	3, the frame is registered under pageNum, pinned and marked as loading. If another thread registered the
+	page first, the frame goes back to the free frames and the caller starts over.
+	Returns the frame, -1 if every frame is pinned, -2 if the caller has to start over or -3 if the victim could
+	not be written.
+*/
+static int claimFrame (BM_BufferPool *const bm, BM_mgmtData *mgmtData, PageNumber pageNum, bool cleanOnly,
+                       BM_AccessRing *ring){
+
+  int position;
+  PageNumber victimPage;
+  BM_Stripe *stripe;
+
+  latch(mgmtData, &mgmtData->replacementLatch);
+
+  //a ring keeps to its own frames even while there are free ones
+  position=(ring!=NULL) ? ringVictim(bm, mgmtData, ring) : -1;
+
+  if(position==-1 && mgmtData->freeCount>0){
+
+    position=mgmtData->freeFrames[--mgmtData->freeCount];
+
+  }
+  else{
+
+    while(1){
+
+      if(position==-1){
+        position=chooseVictim(bm, mgmtData, pageNum);
+      }
+
+      //every frame is pinned
+      if(position==-1){
+        unlatch(mgmtData, &mgmtData->replacementLatch);
+        return -1;
+      }
+
+      victimPage=mgmtData->pages[position].pageNum;
+      stripe=stripeOf(mgmtData, victimPage);
+      latch(mgmtData, &stripe->latch);
+
+      if(UNPINNED(mgmtData->pages[position])){
+        break;
+      }
+
+      unlatch(mgmtData, &stripe->latch);
+      position=-1;
+    }
+
+    //readahead gives up rather than writing a victim back
+    if(cleanOnly && mgmtData->pages[position].dirty==1){
+      unlatch(mgmtData, &stripe->latch);
+      unlatch(mgmtData, &mgmtData->replacementLatch);
+      return -1;
+    }
+
+    //write the victim back before it is overwritten, the background writer was too slow so wake it up
+    if(mgmtData->pages[position].dirty==1){
+
+      if(mgmtData->dirtyTarget>0){
+        pthread_cond_signal(&mgmtData->writerWake);
+      }
+
+      WAL_Lsn lsn=(mgmtData->log!=NULL) ? mgmtData->pageLsns[position] : 0;
+      WAL_Lsn recLsn=(mgmtData->log!=NULL) ? mgmtData->recLsns[position] : BM_NO_LSN;
+
+      pinFrame(mgmtData, position);
+      RELAXED_STORE(mgmtData->pages[position].dirty, 0);
+      unlatch(mgmtData, &stripe->latch);
+      unlatch(mgmtData, &mgmtData->replacementLatch);
+
+      //write-ahead logging happens in writeFrame, a page is never on disk before the log that changed it
+      bool written=(writeFrame(mgmtData, victimPage, mgmtData->pages[position].data, lsn)==RC_OK);
+
+      if(written){
+        countStat(mgmtData, STAT_DIRTY_EVICTIONS, 1);
+        frameWritten(mgmtData, position, recLsn);
+      }
+      else{
+        frameNotWritten(mgmtData, position);
+      }
+      unpinFrame(mgmtData, position);
+
+      //the victim keeps its frame, the pin fails rather than lose the page
+      if(!written){
+        return -3;
+      }
+
+      //single threaded nothing can have changed meanwhile, go on with the same victim
+      if(mgmtData->concurrent){
+        return -2;
+      }
+    }
+
+    //a page read ahead that nobody pinned
+    if(RELAXED_LOAD(mgmtData->prefetched[position])){
+      RELAXED_STORE(mgmtData->prefetched[position], 0);
+      fetchAndAdd(mgmtData, &mgmtData->raWasted, 1);
+    }
+
+    countStat(mgmtData, STAT_EVICTIONS, 1);
+    strategyEvict(bm, mgmtData, position);
+    pageTableRemove(mgmtData, position);
+    RELAXED_STORE(mgmtData->pages[position].pageNum, NO_PAGE);
+    unlatch(mgmtData, &stripe->latch);
+
+  }
+
+  //register the frame under the new page, unless another thread was faster
+  stripe=stripeOf(mgmtData, pageNum);
+  latch(mgmtData, &stripe->latch);
+
+  if(findFrame(mgmtData, pageNum)!=-1){
+    mgmtData->freeFrames[mgmtData->freeCount++]=position;
+    unlatch(mgmtData, &stripe->latch);
+    unlatch(mgmtData, &mgmtData->replacementLatch);
+    return -2;
+  }
+
+  RELAXED_STORE(mgmtData->pages[position].pageNum, pageNum);
+  RELAXED_STORE(mgmtData->pages[position].dirty, 0);
+  mgmtData->loading[position]=1;
+
+  //the changes of the old page that could not be written still need the log
+  if(mgmtData->log!=NULL){
+    lowerLsn(&mgmtData->unsyncedLsn, mgmtData->recLsns[position]);
+    mgmtData->pageLsns[position]=0;
+    __atomic_store_n(&mgmtData->recLsns[position], BM_NO_LSN, __ATOMIC_RELEASE);
+  }
+  pinFrame(mgmtData, position);
+  pageTableInsert(mgmtData, position);
+
+  unlatch(mgmtData, &stripe->latch);
+  unlatch(mgmtData, &mgmtData->replacementLatch);
+
+  return position;
+
+}
+
+/*
+	The end of reading a page into a frame, for pinPage as well as pinPageAsync.
+	1, a page that was read is handed to the replacement strategy.
+	2, if the read failed the frame is unregistered and goes back to the free frames. The replacement latch is held
+	throughout, so resizeBufferPool() never sees a frame that holds no page and is not free.
+	3, either way the pins waiting for the frame are woken up.
+*/
+static void finishLoad (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int position, RC ret){
+
+  BM_Stripe *stripe=stripeOf(mgmtData, mgmtData->pages[position].pageNum);
+
+  latch(mgmtData, &mgmtData->replacementLatch);
+
+  if(ret==RC_OK){
+    strategyLoad(bm, mgmtData, position);
+    unlatch(mgmtData, &mgmtData->replacementLatch);
+  }
+
+  latch(mgmtData, &stripe->latch);
+
+  mgmtData->loading[position]=0;
+
+  if(ret!=RC_OK){
+    pageTableRemove(mgmtData, position);
+    RELAXED_STORE(mgmtData->pages[position].pageNum, NO_PAGE);
+    unpinFrame(mgmtData, position);
+  }
+
+  if(mgmtData->concurrent){
+    pthread_cond_broadcast(&stripe->loaded);
+  }
+
+  unlatch(mgmtData, &stripe->latch);
+
+  if(ret!=RC_OK){
+    mgmtData->freeFrames[mgmtData->freeCount++]=position;
+    unlatch(mgmtData, &mgmtData->replacementLatch);
+  }
+
+}
+
+//set the features of PageHandle that has been passed in, the frame is pinned
+static void fillHandle (BM_mgmtData *mgmtData, BM_PageHandle *const page, PageNumber pageNum, int position){
+
+  page->pageNum=pageNum;
+  page->data=mgmtData->pages[position].data;
+  page->pin_fix_count=RELAXED_LOAD(mgmtData->pages[position].pin_fix_count);
+  page->dirty=RELAXED_LOAD(mgmtData->pages[position].dirty);
+
+}
+
+static int reapPins (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int wait);
+static void readahead (BM_BufferPool *const bm, BM_mgmtData *mgmtData, PageNumber pageNum, int position);
+
+/*
+	Pin a page, different strategies are plugged in through the hooks above.
+	1, a hit pins the frame under the stripe latch of the page, if the page is still being read by another
+	thread it waits for the read to finish. A page read by pinPageAsync may only finish when somebody reaps
+	its completion, so with asynchronous pins around the waiting thread reaps instead of sleeping.
+	2, a miss claims a frame and reads the page without holding any latch, other threads that want the same
+	page find the frame and wait for it.
+	3, if the read fails the frame is unregistered and goes back to the free frames.
+	4, with readahead on, the pin may start reading the pages that follow it.
+	5, a pin with an access ring recycles the ring's oldest frame on a miss, like PostgreSQL's buffer access
+	strategies, so a scan only ever holds a few frames. Its hits leave the replacement strategy alone, and it
+	starts no readahead, whose frames would not be in the ring.
+*/
+RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
+	    const PageNumber pageNum){
+
+  return pinPageHinted(bm, page, pageNum, NULL);
+
+}
+
+RC pinPageHinted (BM_BufferPool *const bm, BM_PageHandle *const page, 
+		  const PageNumber pageNum, BM_AccessRing *ring){
+
+  //get the position of this page
+  int position;
+  RC ret;
+
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_Stripe *stripe=stripeOf(mgmtData, pageNum);
+  long long start=startTimer(mgmtData);
+
+  if(ring!=NULL && ring->mgmtData==NULL){
+    ring=NULL;
+  }
+
+  if (pageNum  >= __atomic_load_n(&mgmtData->fileHandle->totalNumPages, __ATOMIC_ACQUIRE)) {
+    latch(mgmtData, &mgmtData->extendLatch);
+    ensureCapacity(pageNum + 1, mgmtData->fileHandle);
+    unlatch(mgmtData, &mgmtData->extendLatch);
+  }
+
+  while(1){
+
+    //check if the page is already in the buffer
+    latch(mgmtData, &stripe->latch);
+
+    position=findFrame(mgmtData, pageNum);
+
+    if(position!=-1){
+
+      //if it exists in buffer pool, then increase the fix count
+      pinFrame(mgmtData, position);
+
+      while(mgmtData->loading[position] && mgmtData->pages[position].pageNum==pageNum){
+
+        if(RELAXED_LOAD(mgmtData->asyncPins)!=NULL){
+          unlatch(mgmtData, &stripe->latch);
+
+          latch(mgmtData, &mgmtData->asyncLatch);
+          int reaped=reapPins(bm, mgmtData, 1);
+          unlatch(mgmtData, &mgmtData->asyncLatch);
+
+          latch(mgmtData, &stripe->latch);
+
+          if(reaped>0){
+            continue;
+          }
+          if(!mgmtData->loading[position]){
+            break;
+          }
+        }
+
+        pthread_cond_wait(&stripe->loaded, &stripe->latch);
+      }
+
+      //the read failed, try again
+      if(mgmtData->pages[position].pageNum!=pageNum){
+        unpinFrame(mgmtData, position);
+        unlatch(mgmtData, &stripe->latch);
+        continue;
+      }
+
+      unlatch(mgmtData, &stripe->latch);
+
+      countStat(mgmtData, STAT_HITS, 1);
+      if(ring==NULL){
+        strategyHit(bm, mgmtData, position);
+      }
+      break;
+    }
+
+    unlatch(mgmtData, &stripe->latch);
+
+    position=claimFrame(bm, mgmtData, pageNum, false, ring);
+
+    //frames pinned by reads ahead are freed by reaping them
+    if(position==-1 && RELAXED_LOAD(mgmtData->raInFlight)>0){
+      latch(mgmtData, &mgmtData->asyncLatch);
+      reapPins(bm, mgmtData, 1);
+      unlatch(mgmtData, &mgmtData->asyncLatch);
+      continue;
+    }
+
+    if(position==-1){
+      return -1;
+    }
+
+    if(position==-2){
+      continue;
+    }
+
+    if(position==-3){
+      return RC_WRITE_FAILED;
+    }
+
+    //read a page from disk to this position in buffer pool
+    ret=readFrame(mgmtData, pageNum, position);
+
+    finishLoad(bm, mgmtData, position, ret);
+
+    if(ret!=RC_OK){
+      return ret;
+    }
+
+    countStat(mgmtData, STAT_MISSES, 1);
+
+    //the ring recycles this frame once it has gone round
+    if(ring!=NULL){
+      BM_RingData *ringData=(BM_RingData *)ring->mgmtData;
+
+      ringData->frames[ringData->next]=position;
+      ringData->pages[ringData->next]=pageNum;
+      ringData->next=(ringData->next+1)%ring->numFrames;
+    }
+
+    break;
+  }
+
+  if(mgmtData->raMaxWindow>0 && ring==NULL){
+    readahead(bm, mgmtData, pageNum, position);
+  }
+
+  fillHandle(mgmtData, page, pageNum, position);
+
+  stopTimer(mgmtData, TIMER_PIN, start);
+  traceOp(mgmtData, BM_TRACE_PIN, pageNum);
+
+  return RC_OK;
+
+}
+
+// Buffer Manager Interface Access Hints
+RC initAccessRing (BM_BufferPool *const bm, BM_AccessRing *ring, BM_AccessHint hint, int numFrames){
+
+  BM_RingData *ringData;
+  int i;
+
+  ring->hint=hint;
+  ring->numFrames=0;
+  ring->mgmtData=NULL;
+
+  //a normal pin needs no ring
+  if(hint==BM_HINT_NORMAL){
+    return RC_OK;
+  }
+
+  if(numFrames<=0){
+    numFrames=(hint==BM_HINT_BULK_WRITE) ? BM_BULK_WRITE_RING_FRAMES : BM_SCAN_RING_FRAMES;
+  }
+
+  ringData=(BM_RingData *)malloc(sizeof(BM_RingData));
+  ringData->frames=(int *)malloc(sizeof(int)*numFrames);
+  ringData->pages=(PageNumber *)malloc(sizeof(PageNumber)*numFrames);
+  ringData->next=0;
+  ringData->size=numFrames;
+
+  for(i=0;i<numFrames;i++){
+    ringData->frames[i]=-1;
+    ringData->pages[i]=NO_PAGE;
+  }
+
+  ring->mgmtData=ringData;
+  ringCap(bm, ring);
+
+  return RC_OK;
+
+}
+
+//the pages of the ring stay in the pool, the strategy evicts them like any other
+RC freeAccessRing (BM_AccessRing *ring){
+
+  BM_RingData *ringData=(BM_RingData *)ring->mgmtData;
+
+  if(ringData!=NULL){
+    free(ringData->frames);
+    free(ringData->pages);
+    free(ringData);
+    ring->mgmtData=NULL;
+  }
+
+  return RC_OK;
+
+}
+
+/*
+	Asynchronous pins.
+	1, startPin does what pinPage does up to the read, which is only submitted. A hit completes the pin at once,
+	a hit on a frame still being read makes the pin wait for that read.
+	2, reapPins finishes the reads that have completed like pinPage does, then checks the waiting pins. A
+	waiting pin whose read failed starts over. Reads ahead are tagged with -1-frame instead of a token.
+	3, all of this runs under asyncLatch.
+*/
+static void completePin (BM_mgmtData *mgmtData, BM_AsyncPin *pin, RC rc){
+
+  if(rc==RC_OK){
+    fillHandle(mgmtData, pin->page, pin->pageNum, pin->frame);
+  }
+
+  pin->rc=rc;
+  pin->state=ASYNC_DONE;
+
+}
+
+//the first asynchronous pin or read ahead starts the I/O engine
+static void startAsync (BM_mgmtData *mgmtData){
+
+  if(mgmtData->asyncPins==NULL){
+    initAsyncIO(mgmtData->fileHandle, mgmtData->asyncDepth, mgmtData->asyncMode);
+    mgmtData->numAsyncPins=mgmtData->asyncDepth;
+    RELAXED_STORE(mgmtData->asyncPins, (BM_AsyncPin *)calloc(mgmtData->numAsyncPins, sizeof(BM_AsyncPin)));
+  }
+
+}
+
+static RC startPin (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int token){
+
+  BM_AsyncPin *pin=&mgmtData->asyncPins[token];
+  BM_Stripe *stripe=stripeOf(mgmtData, pin->pageNum);
+  int position;
+  RC ret;
+
+  while(1){
+
+    latch(mgmtData, &stripe->latch);
+
+    position=findFrame(mgmtData, pin->pageNum);
+
+    if(position!=-1){
+
+      pinFrame(mgmtData, position);
+      pin->frame=position;
+
+      if(mgmtData->loading[position]){
+        pin->state=ASYNC_WAITING;
+        unlatch(mgmtData, &stripe->latch);
+        return RC_OK;
+      }
+
+      unlatch(mgmtData, &stripe->latch);
+
+      countStat(mgmtData, STAT_HITS, 1);
+      strategyHit(bm, mgmtData, position);
+      completePin(mgmtData, pin, RC_OK);
+      return RC_OK;
+    }
+
+    unlatch(mgmtData, &stripe->latch);
+
+    position=claimFrame(bm, mgmtData, pin->pageNum, false, NULL);
+
+    if(position==-1){
+      return -1;
+    }
+
+    if(position==-2){
+      continue;
+    }
+
+    if(position==-3){
+      return RC_WRITE_FAILED;
+    }
 
-  //add head and tail for FIFO queue
-	int read_count;
-	int write_count;
+    pin->frame=position;
+    pin->state=ASYNC_READING;
 
-  int *LRU_Order; //hold the accumulative number of LRU, use pointer to point to an array.
+    ret=submitReadBlock(pin->pageNum, mgmtData->fileHandle, mgmtData->pages[position].data, (void *)(size_t)token);
 
-} BM_mgmtData;
+    if(ret!=RC_OK){
+      finishLoad(bm, mgmtData, position, ret);
+      return ret;
+    }
 
-// convenience macros
+    return RC_OK;
+  }
 
-/*
-char * const a;
-means that the pointer is constant and immutable but the pointed data is not.
+}
 
-const char * a;
-means that the pointed data cannot be written to using the pointer a.
+//returns the number of pins that completed
+static int reapPins (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int wait){
 
-const char * const
-which is a pointer that you cannot change, to a char (or multiple chars) that you cannot change. 
-*/
+  SM_IOCompletion done[16];
+  BM_AsyncPin *pin;
+  int i, n, completed;
+  RC ret;
 
+  n=reapBlockIO(mgmtData->fileHandle, done, 16, wait);
+  completed=n;
 
+  for(i=0;i<n;i++){
 
-// Buffer Manager Interface Pool Handling
+    //a page read ahead, the frame is pinned only while it is being read
+    if((intptr_t)done[i].tag<0){
+      int frame=-1-(intptr_t)done[i].tag;
 
-// a little confused about the stratData, what does it do?
-RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
-		  const int numPages, ReplacementStrategy strategy, 
-		  void *stratData){
+      mgmtData->raInFlight--;
+      if(done[i].rc==RC_OK){
+        countStat(mgmtData, STAT_READS, 1);
+      }
 
-    //g_tick = 0;
-    //initialize the BM_mgmtData
-    //1, create an BM_mgmtData object
-    BM_mgmtData *mgmtDataPool=(BM_mgmtData *)malloc(sizeof(BM_mgmtData));
+      finishLoad(bm, mgmtData, frame, done[i].rc);
+      if(done[i].rc==RC_OK){
+        unpinFrame(mgmtData, frame);
+      }
+      continue;
+    }
 
-    //create BM_PageHandle array
-    BM_PageHandle *BM_pages=(BM_PageHandle *)malloc(sizeof(BM_PageHandle) * numPages);
+    pin=&mgmtData->asyncPins[(size_t)done[i].tag];
 
-    int i, k;
+    if(done[i].rc==RC_OK){
+      countStat(mgmtData, STAT_READS, 1);
+      countStat(mgmtData, STAT_MISSES, 1);
+    }
 
-    for (i=0;i<numPages;i++){
+    finishLoad(bm, mgmtData, pin->frame, done[i].rc);
+    completePin(mgmtData, pin, done[i].rc);
+  }
 
-        //repeatedly create new memory space, and assign the space to BM_PageHandle's.
-        SM_PageHandle page=(SM_PageHandle)malloc(PAGE_SIZE);
+  for(i=0;i<mgmtData->numAsyncPins;i++){
 
-        //when using [], the pointer turns to object, so we use '.'
-        BM_pages[i].pageNum=-1;   //at beginning, set all page number to be -1.
-        BM_pages[i].data=page;
-        BM_pages[i].pin_fix_count=0;
-        BM_pages[i].dirty=0;
+    pin=&mgmtData->asyncPins[i];
 
+    if(pin->state!=ASYNC_WAITING){
+      continue;
     }
 
-    //assign the BM_PageHandle array to BM_mgmtData
-    mgmtDataPool->pages = BM_pages;
+    BM_Stripe *stripe=stripeOf(mgmtData, pin->pageNum);
 
+    latch(mgmtData, &stripe->latch);
 
+    if(mgmtData->loading[pin->frame]){
+      unlatch(mgmtData, &stripe->latch);
+      continue;
+    }
 
-    //2, initialize a SM_FileHandle, and save it into BM_mgmtData
-    SM_FileHandle *fileHandle=(SM_FileHandle *)malloc(sizeof(SM_FileHandle));
+    if(mgmtData->pages[pin->frame].pageNum==pin->pageNum){
+      unlatch(mgmtData, &stripe->latch);
+      countStat(mgmtData, STAT_HITS, 1);
+      strategyHit(bm, mgmtData, pin->frame);
+      completePin(mgmtData, pin, RC_OK);
+      completed++;
+      continue;
+    }
 
-    openPageFile(pageFileName, fileHandle);
+    unpinFrame(mgmtData, pin->frame);
+    unlatch(mgmtData, &stripe->latch);
 
-    mgmtDataPool->fileHandle=fileHandle;
+    ret=startPin(bm, mgmtData, i);
+    if(ret!=RC_OK){
+      completePin(mgmtData, pin, ret);
+      completed++;
+    }
+  }
 
-    //3, initialize the int array that contains the dirty information, make them all 0.
-    int *LRU_Order=(int *)malloc(sizeof(int)*numPages);
+  return completed;
+
+}
 
-    memset(LRU_Order, 0, sizeof(int) * numPages);
+/*
+	Readahead.
+	1, a pin of page raLast+1 continues a sequential run, any other pin starts a new one with the smallest
+	window.
+	2, during a run the pages up to pageNum+raWindow are read asynchronously into free frames or clean victims,
+	a dirty victim stops the readahead until the next pin. The frames stay pinned only while they are read.
+	3, finished reads ahead are reaped here too, so their frames do not stay pinned when nobody pins the pages.
+*/
+static bool prefetch (BM_BufferPool *const bm, BM_mgmtData *mgmtData, PageNumber pageNum){
 
-    mgmtDataPool->LRU_Order=LRU_Order;
+  BM_Stripe *stripe=stripeOf(mgmtData, pageNum);
+  int position;
+  RC ret;
 
-    //4, page count
-    mgmtDataPool->page_count=0;
+  latch(mgmtData, &stripe->latch);
+  position=findFrame(mgmtData, pageNum);
+  unlatch(mgmtData, &stripe->latch);
 
-    //5, head and tail for FIFO queue structure
+  if(position!=-1){
+    return true;
+  }
 
-    //6, update the read_count and write_count
-    mgmtDataPool->read_count = 0;
-    mgmtDataPool->write_count = 0;
+  position=claimFrame(bm, mgmtData, pageNum, true, NULL);
 
-    //by now, the BM_mgmtData object has the memory space as well as all info about the file on disk.
+  if(position==-1){
+    return false;
+  }
 
-    //at last, save all info into BM_BufferPool, including the BM_mgmtData just created.
-    bm->pageFile=pageFileName;
-    bm->numPages=numPages;
-    bm->strategy=strategy;
-    bm->mgmtData=mgmtDataPool;
+  if(position==-2){
+    return true;
+  }
 
+  RELAXED_STORE(mgmtData->prefetched[position], 1);
+  mgmtData->raInFlight++;
 
-    return RC_OK;
+  ret=submitReadBlock(pageNum, mgmtData->fileHandle, mgmtData->pages[position].data, (void *)(intptr_t)(-1-position));
+
+  if(ret!=RC_OK){
+    mgmtData->raInFlight--;
+    RELAXED_STORE(mgmtData->prefetched[position], 0);
+    finishLoad(bm, mgmtData, position, ret);
+    return false;
+  }
 
+  return true;
 
 }
 
+static void readahead (BM_BufferPool *const bm, BM_mgmtData *mgmtData, PageNumber pageNum, int position){
 
-//how to completely shut down a buffer pool? modify it later
-RC shutdownBufferPool(BM_BufferPool *const bm){
+  int wasted;
+  PageNumber totalPages;
 
-    int i, num_page;
+  latch(mgmtData, &mgmtData->asyncLatch);
 
-    BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  //tune the window, a used page read ahead lets it grow and an unused one makes it shrink
+  if(RELAXED_LOAD(mgmtData->prefetched[position])){
+    RELAXED_STORE(mgmtData->prefetched[position], 0);
+    mgmtData->raWindow=(2*mgmtData->raWindow<mgmtData->raMaxWindow) ? 2*mgmtData->raWindow : mgmtData->raMaxWindow;
+  }
+
+  wasted=__atomic_exchange_n(&mgmtData->raWasted, 0, __ATOMIC_RELAXED);
+  while(wasted-->0 && mgmtData->raWindow>BM_RA_MIN_WINDOW){
+    mgmtData->raWindow/=2;
+  }
 
-    forceFlushPool(bm);
+  if(mgmtData->raLast==NO_PAGE || pageNum!=mgmtData->raLast+1){
+    mgmtData->raLast=pageNum;
+    mgmtData->raNext=pageNum+1;
+    mgmtData->raWindow=BM_RA_MIN_WINDOW;
+    unlatch(mgmtData, &mgmtData->asyncLatch);
+    return;
+  }
 
-    //free all of the pages
-    num_page=mgmtData->page_count;
+  mgmtData->raLast=pageNum;
+  if(mgmtData->raNext<=pageNum){
+    mgmtData->raNext=pageNum+1;
+  }
 
-    for(i=0;i<num_page;i++)
-    {
-      free(mgmtData->pages[i].data);
-    }
+  startAsync(mgmtData);
 
+  if(mgmtData->raInFlight>0){
+    reapPins(bm, mgmtData, 0);
+  }
 
-    //free mgmtData
-    free(mgmtData->pages);
-    free(mgmtData->fileHandle);
-    free(mgmtData);
+  totalPages=__atomic_load_n(&mgmtData->fileHandle->totalNumPages, __ATOMIC_ACQUIRE);
 
+  while(mgmtData->raNext<=pageNum+mgmtData->raWindow && mgmtData->raNext<totalPages){
 
-    closePageFile(mgmtData->fileHandle);
+    if(!prefetch(bm, mgmtData, mgmtData->raNext)){
+      break;
+    }
+    mgmtData->raNext++;
+  }
 
-    return RC_OK;
+  unlatch(mgmtData, &mgmtData->asyncLatch);
 
 }
 
-//
-RC forceFlushPool(BM_BufferPool *const bm){
-
-  //write back after checking the dirty attribute and pin_fix_count attribute
-  int i, page_count;
+/*
+	Start pinning a page without waiting for it to be read. token identifies the pin for pinPageDone and
+	waitPinPage, page is filled in once the pin completes.
+	1, a hit completes at once, a miss claims a frame (writing back a dirty victim first) and submits the read.
+	2, if no frame can be claimed the pin fails right away, no token is handed out.
+	3, every token has to be given back with waitPinPage.
+*/
+RC pinPageAsync (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum,
+		 BM_PinToken *token){
 
-  //because mgmtData is void type in struct, so have to coerce it into BM_mgmtData it is not working if using 'page_count=bm->mgmtData->page_count;'
   BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  int i;
+  RC ret;
 
-  page_count=mgmtData->page_count;
+  //there is no file to read from asynchronously
+  if(mgmtData->simulated){
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
 
-  for(i=0;i<page_count;i++){
+  if (pageNum  >= __atomic_load_n(&mgmtData->fileHandle->totalNumPages, __ATOMIC_ACQUIRE)) {
+    latch(mgmtData, &mgmtData->extendLatch);
+    ensureCapacity(pageNum + 1, mgmtData->fileHandle);
+    unlatch(mgmtData, &mgmtData->extendLatch);
+  }
 
-    if(mgmtData->pages[i].pin_fix_count==0 && mgmtData->pages[i].dirty==1){
+  latch(mgmtData, &mgmtData->asyncLatch);
 
-      writeBlock(mgmtData->pages[i].pageNum, mgmtData->fileHandle, mgmtData->pages[i].data);
-      mgmtData->write_count++;
+  startAsync(mgmtData);
 
-      //change the dirty into 0
-      mgmtData->pages[i].dirty=0;
+  //find a free token, there are more tokens than reads in flight when the caller holds on to finished ones
+  for(i=0;i<mgmtData->numAsyncPins && mgmtData->asyncPins[i].state!=ASYNC_FREE;i++);
 
-    }
+  if(i==mgmtData->numAsyncPins){
+    RELAXED_STORE(mgmtData->asyncPins, (BM_AsyncPin *)realloc(mgmtData->asyncPins, sizeof(BM_AsyncPin)*2*i));
+    memset(mgmtData->asyncPins+i, 0, sizeof(BM_AsyncPin)*i);
+    mgmtData->numAsyncPins=2*i;
   }
 
-  return RC_OK;
+  mgmtData->asyncPins[i].page=page;
+  mgmtData->asyncPins[i].pageNum=pageNum;
 
-}
+  ret=startPin(bm, mgmtData, i);
 
-// Buffer Manager Interface Access Pages
-RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
+  if(ret!=RC_OK){
+    mgmtData->asyncPins[i].state=ASYNC_FREE;
+  }
+  else{
+    traceOp(mgmtData, BM_TRACE_PIN, pageNum);
+  }
 
-  //find the page in the buffer pool
-  int position, k, numPages, page_count;
+  unlatch(mgmtData, &mgmtData->asyncLatch);
+
+  *token=i;
+  return ret;
+
+}
 
-  position=0;
+//true once the pin has completed, the page handle is filled in then. It still has to be given back with waitPinPage.
+bool pinPageDone (BM_BufferPool *const bm, BM_PinToken token){
 
   BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  bool done;
 
-  numPages=bm->numPages;
-  
-  page_count=mgmtData->page_count;
+  latch(mgmtData, &mgmtData->asyncLatch);
 
-  int exist=0;
+  if(mgmtData->asyncPins[token].state!=ASYNC_DONE){
+    reapPins(bm, mgmtData, 0);
+  }
+  done=(mgmtData->asyncPins[token].state==ASYNC_DONE);
 
-  while(exist==0&&position<page_count){
+  unlatch(mgmtData, &mgmtData->asyncLatch);
 
-    k=mgmtData->pages[position].pageNum;
+  return done;
 
-    if(page->pageNum==k){
-      
-      exist=1;
+}
 
-    }
+/*
+	Wait until the pin has completed, give the token back and return the result of the pin.
+	1, completions of other pins that arrive meanwhile are processed as well.
+	2, a pin waiting for a page that a plain pinPage of another thread is reading sleeps until that read is
+	done, there is nothing to reap for it.
+*/
+RC waitPinPage (BM_BufferPool *const bm, BM_PinToken token){
 
-    position++; //the position will be one more than real position when the loop ends
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_AsyncPin *pin;
+  RC ret;
 
-  }
+  latch(mgmtData, &mgmtData->asyncLatch);
 
-  if(exist==1){
-    position--;
+  while(mgmtData->asyncPins[token].state!=ASYNC_DONE){
 
-    mgmtData->pages[position].dirty=1;
+    if(reapPins(bm, mgmtData, 1)>0){
+      continue;
+    }
 
-  }
+    pin=&mgmtData->asyncPins[token];
 
-  return RC_OK;
+    if(pin->state==ASYNC_WAITING && mgmtData->concurrent){
+      BM_Stripe *stripe=stripeOf(mgmtData, pin->pageNum);
 
-}
+      latch(mgmtData, &stripe->latch);
+      while(mgmtData->loading[pin->frame] && mgmtData->pages[pin->frame].pageNum==pin->pageNum){
+        pthread_cond_wait(&stripe->loaded, &stripe->latch);
+      }
+      unlatch(mgmtData, &stripe->latch);
+    }
+  }
 
+  ret=mgmtData->asyncPins[token].rc;
+  mgmtData->asyncPins[token].state=ASYNC_FREE;
 
-RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page){
+  unlatch(mgmtData, &mgmtData->asyncLatch);
 
-  //find the page in the buffer pool
-  int position, k, numPages, page_count;
+  return ret;
 
-  position=0;
+}
 
-  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+/*
+	Resizing a pool in use. Every per frame array was allocated for capacity frames at init, so nothing moves.
+	1, growing only hands the new frames to the free frames.
+	2, shrinking to n frames first evicts as many pages as the frames used beyond n, the ones the strategy would
+	evict next. The dirty ones are written like forceFlushPool() does before the replacement latch is held for good.
+	3, the pages left in frames n and above move to free frames below n. Both the evictions and the moves take the
+	stripe latch of the page, so hits on other pages go on, misses wait for the replacement latch.
+	4, a pinned page in the way makes the resize fail, the pool keeps its size.
+*/
 
-  numPages=bm->numPages;
-  
-  page_count=mgmtData->page_count;
+//the frames to evict for a pool of n frames, in the order the strategy would evict them. Returns how many of the
+//entries to evict, or -1 if the frames beyond n or too many others are pinned.
+static int resizeVictims (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int n, int *ranks, BM_FrameEntry *entries){
 
-  int exist=0;
+  int i, numUsed=0, numCandidates=0;
 
-  while(exist==0&&position<page_count){
+  strategyRanks(bm, mgmtData, ranks);
+
+  for(i=0;i<bm->numPages;i++){
 
-    k=mgmtData->pages[position].pageNum;
+    if(RELAXED_LOAD(mgmtData->pages[i].pageNum)==NO_PAGE){
+      continue;
+    }
 
-    if(page->pageNum==k){
-      
-      exist=1;
+    numUsed++;
 
+    if(RELAXED_LOAD(mgmtData->pages[i].pin_fix_count)>0){
+      if(i>=n){
+        return -1;
+      }
+      continue;
     }
 
-    position++; //the position will be one more than real position when the loop ends
+    entries[numCandidates].key=ranks[i];
+    entries[numCandidates].frame=i;
+    numCandidates++;
+  }
 
+  if(numUsed<=n){
+    return 0;
   }
 
-  if(exist==1){
+  if(numCandidates<numUsed-n){
+    return -1;
+  }
 
-    position--;
+  qsort(entries, numCandidates, sizeof(BM_FrameEntry), compareFrameEntries);
 
-    mgmtData->pages[position].pin_fix_count--;
+  return numUsed-n;
 
-  }
+}
 
-  
-  return RC_OK;
+//evict the page in frame like claimFrame() does, a page dirtied again since it was flushed is written here.
+//Returns false if the page is pinned or cannot be written.
+static bool dropFrame (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int frame){
 
-}
+  PageNumber pageNum=mgmtData->pages[frame].pageNum;
+  BM_Stripe *stripe=stripeOf(mgmtData, pageNum);
+  WAL_Lsn lsn, recLsn;
+  RC ret;
 
+  latch(mgmtData, &stripe->latch);
 
-//assume that input BM_PageHandle has the page number and the data.
-RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page){
-  
+  while(UNPINNED(mgmtData->pages[frame]) && mgmtData->pages[frame].dirty==1){
 
-  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+    lsn=(mgmtData->log!=NULL) ? mgmtData->pageLsns[frame] : 0;
+    recLsn=(mgmtData->log!=NULL) ? mgmtData->recLsns[frame] : BM_NO_LSN;
 
-  writeBlock(page->pageNum, mgmtData->fileHandle, page->data);
-  mgmtData->write_count++;
+    pinFrame(mgmtData, frame);
+    RELAXED_STORE(mgmtData->pages[frame].dirty, 0);
+    unlatch(mgmtData, &stripe->latch);
 
-  //locate the position of the desired page in the buffer pool
+    if((ret=writeFrame(mgmtData, pageNum, mgmtData->pages[frame].data, lsn))==RC_OK){
+      frameWritten(mgmtData, frame, recLsn);
+    }
+    else{
+      frameNotWritten(mgmtData, frame);
+    }
+    unpinFrame(mgmtData, frame);
 
-  //find the page in the buffer pool
-  int position, k, numPages, page_count;
+    if(ret!=RC_OK){
+      return false;
+    }
 
-  position=0;
+    latch(mgmtData, &stripe->latch);
+  }
 
-  numPages=bm->numPages;
+  if(!UNPINNED(mgmtData->pages[frame])){
+    unlatch(mgmtData, &stripe->latch);
+    return false;
+  }
 
-  page_count=mgmtData->page_count;
+  if(RELAXED_LOAD(mgmtData->prefetched[frame])){
+    RELAXED_STORE(mgmtData->prefetched[frame], 0);
+    fetchAndAdd(mgmtData, &mgmtData->raWasted, 1);
+  }
 
-  int exist=0;
+  countStat(mgmtData, STAT_EVICTIONS, 1);
+  strategyEvict(bm, mgmtData, frame);
+  pageTableRemove(mgmtData, frame);
+  RELAXED_STORE(mgmtData->pages[frame].pageNum, NO_PAGE);
 
-  while(exist==0&&position<page_count){
+  if(mgmtData->log!=NULL){
+    lowerLsn(&mgmtData->unsyncedLsn, mgmtData->recLsns[frame]);
+    mgmtData->pageLsns[frame]=0;
+    __atomic_store_n(&mgmtData->recLsns[frame], BM_NO_LSN, __ATOMIC_RELEASE);
+  }
 
-    k=mgmtData->pages[position].pageNum;
+  unlatch(mgmtData, &stripe->latch);
 
-    if(page->pageNum==k){
-      
-      exist=1;
+  return true;
 
-    }
+}
 
-    position++; //the position will be one more than real position when the loop ends
+//move the page in frame from to the free frame to, with its data, dirty flag, LSNs and place in the strategy.
+//Returns false if the page is pinned.
+static bool moveFrame (BM_BufferPool *const bm, BM_mgmtData *mgmtData, int from, int to){
 
+  PageNumber pageNum=mgmtData->pages[from].pageNum;
+  BM_Stripe *stripe=stripeOf(mgmtData, pageNum);
+  WAL_Lsn recLsn;
+
+  latch(mgmtData, &stripe->latch);
+
+  if(!UNPINNED(mgmtData->pages[from])){
+    unlatch(mgmtData, &stripe->latch);
+    return false;
   }
 
-  position--;
+  memcpy(mgmtData->pages[to].data, mgmtData->pages[from].data, PAGE_SIZE);
+  RELAXED_STORE(mgmtData->pages[to].dirty, mgmtData->pages[from].dirty);
+  RELAXED_STORE(mgmtData->pages[from].dirty, 0);
+
+  //a checkpoint that reads the two frames while the LSN moves sees it in unsyncedLsn
+  if(mgmtData->log!=NULL){
+    recLsn=mgmtData->recLsns[from];
+    mgmtData->pageLsns[to]=mgmtData->pageLsns[from];
+    __atomic_store_n(&mgmtData->recLsns[to], recLsn, __ATOMIC_RELEASE);
+    lowerLsn(&mgmtData->unsyncedLsn, recLsn);
+    mgmtData->pageLsns[from]=0;
+    __atomic_store_n(&mgmtData->recLsns[from], BM_NO_LSN, __ATOMIC_RELEASE);
+  }
 
-  //change the dirty to 0
-  mgmtData->pages[position].dirty=0;
+  RELAXED_STORE(mgmtData->prefetched[to], RELAXED_LOAD(mgmtData->prefetched[from]));
+  RELAXED_STORE(mgmtData->prefetched[from], 0);
 
-  return RC_OK;
+  strategyMove(bm, mgmtData, from, to);
 
-}
+  pageTableRemove(mgmtData, from);
+  RELAXED_STORE(mgmtData->pages[to].pageNum, pageNum);
+  pageTableInsert(mgmtData, to);
+  RELAXED_STORE(mgmtData->pages[from].pageNum, NO_PAGE);
 
-//different strategies is implemented here.
-RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
-	    const PageNumber pageNum){
+  unlatch(mgmtData, &stripe->latch);
 
-  
-  //check if the page is already in the buffer
+  return true;
 
-  //get the position of this page
-  int position, k, numPages, page_count;
+}
 
-  position=0;
+RC resizeBufferPool(BM_BufferPool *const bm, int numPages){
 
   BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
-
-  if (pageNum  >= mgmtData->fileHandle->totalNumPages) {
-    ensureCapacity(pageNum + 1, mgmtData->fileHandle);
+  int i, to, count, numDirty, oldSize;
+  bool flushed=false;
+  int *ranks;
+  BM_FrameEntry *entries;
+  RC ret=RC_OK;
+
+  if(numPages<1 || numPages>mgmtData->capacity){
+    return RC_RESIZE_FAILED;
   }
 
-  numPages=bm->numPages;
+  latch(mgmtData, &mgmtData->replacementLatch);
 
-  page_count=mgmtData->page_count;
+  oldSize=bm->numPages;
 
-  int exist=0;
+  //1, growing, the new frames are used first
+  if(numPages>=oldSize){
+    for(i=numPages-1;i>=oldSize;i--){
+      mgmtData->freeFrames[mgmtData->freeCount++]=i;
+    }
+    RELAXED_STORE(bm->numPages, numPages);
+    unlatch(mgmtData, &mgmtData->replacementLatch);
+    return RC_OK;
+  }
 
-  while(exist==0&&position<numPages){
+  ranks=(int *)malloc(sizeof(int)*oldSize);
+  entries=(BM_FrameEntry *)malloc(sizeof(BM_FrameEntry)*oldSize);
 
-    k=mgmtData->pages[position].pageNum;
+  while(1){
 
-    if(pageNum==k){ 
-      
-      exist=1;
+    count=resizeVictims(bm, mgmtData, numPages, ranks, entries);
 
+    if(count<0){
+      ret=RC_RESIZE_FAILED;
+      break;
     }
 
-    position++; //the position will be one more than real position when the loop ends
+    //2, write the dirty victims once without the replacement latch, then choose them again
+    if(!flushed){
 
-  }
+      flushed=true;
 
+      for(i=0, numDirty=0;i<count;i++){
+        if(RELAXED_LOAD(mgmtData->pages[entries[i].frame].dirty)){
+          entries[numDirty].key=RELAXED_LOAD(mgmtData->pages[entries[i].frame].pageNum);
+          entries[numDirty].frame=entries[i].frame;
+          numDirty++;
+        }
+      }
 
-  if(exist){
+      if(numDirty>0){
+        unlatch(mgmtData, &mgmtData->replacementLatch);
+        flushFrames(bm, mgmtData, entries, numDirty);
+        latch(mgmtData, &mgmtData->replacementLatch);
+        continue;
+      }
+    }
 
-    position--;
+    for(i=0;i<count;i++){
+      if(!dropFrame(bm, mgmtData, entries[i].frame)){
+        ret=RC_RESIZE_FAILED;
+        break;
+      }
+    }
 
-    //if it exists in buffer pool, then increase the fix count, and set the passed PageHandle
-    mgmtData->pages[position].pin_fix_count++;
+    //3, the pages beyond numPages move down, there are enough free frames below it now
+    for(i=numPages, to=0;ret==RC_OK && i<oldSize;i++){
 
-    //set the page number, content, and other info
-    page->pageNum=pageNum;
-    page->data=mgmtData->pages[position].data;
-    page->pin_fix_count=mgmtData->pages[position].pin_fix_count;
-    page->dirty=mgmtData->pages[position].dirty;
+      if(mgmtData->pages[i].pageNum==NO_PAGE){
+        continue;
+      }
 
-    if (bm->strategy == RS_LRU) {
-      mgmtData->LRU_Order[position] = g_tick++;
-    }
+      while(to<numPages && mgmtData->pages[to].pageNum!=NO_PAGE){
+        to++;
+      }
 
-    return RC_OK;
+      if(to==numPages || !moveFrame(bm, mgmtData, i, to)){
+        ret=RC_RESIZE_FAILED;
+      }
+    }
 
+    break;
   }
 
-  //here, will be implementing different strategies
-  else{
+  if(ret==RC_OK){
 
-    //if the queue is not full, add the element into the last position
-      if(bm->numPages > page_count)
-      {
+    RELAXED_STORE(bm->numPages, numPages);
 
-        SM_PageHandle memPage;
+    if(mgmtData->clockHand>=numPages){
+      mgmtData->clockHand=0;
+    }
 
-        //read the page and store it at the position of tail
-        memPage=mgmtData->pages[page_count].data; 
+    if(bm->strategy==RS_ARC){
+      mgmtData->arcTarget=(mgmtData->arcTarget<numPages) ? mgmtData->arcTarget : numPages;
+      arcTrimGhosts(bm, mgmtData);
+    }
 
-        RC ret = readBlock(pageNum, mgmtData->fileHandle, memPage); //read a page from disk to this position 
-                                                              //in buffer pool
-        if (ret != RC_OK) {
-          return ret;
-        }
-        mgmtData->read_count++;
+    //give the memory of the frames no longer used back to the kernel
+    if(mgmtData->arenaSize>0){
+      madvise(mgmtData->arena+(size_t)numPages*PAGE_SIZE, (size_t)(oldSize-numPages)*PAGE_SIZE, MADV_DONTNEED);
+    }
+  }
 
+  //the free frames are the frames without a page, frame 0 on top like at init
+  mgmtData->freeCount=0;
+  for(i=bm->numPages-1;i>=0;i--){
+    if(mgmtData->pages[i].pageNum==NO_PAGE){
+      mgmtData->freeFrames[mgmtData->freeCount++]=i;
+    }
+  }
 
-        //update other info, including the page number of this page, pin_fix_count, and dirty or not.
-        mgmtData->pages[page_count].pageNum=pageNum;
-        mgmtData->pages[page_count].pin_fix_count++;
-        mgmtData->pages[page_count].dirty=0;
+  unlatch(mgmtData, &mgmtData->replacementLatch);
 
+  free(ranks);
+  free(entries);
 
-        //set the features of PageHandle that has been passed in the method
-        page->pageNum=pageNum;
-        page->data=mgmtData->pages[page_count].data;
-        page->pin_fix_count=mgmtData->pages[page_count].pin_fix_count;
-        page->dirty=mgmtData->pages[page_count].dirty;
+  return ret;
 
-        mgmtData->LRU_Order[page_count] = g_tick++;
+}
 
-        //increase the page_count in the mgmtData
-        page_count++;
+/*
+	Background writer.
+	1, every BM_WRITER_INTERVAL_MS, or when a miss had to write its victim, the unpinned frames are sorted in the
+	order the replacement strategy would evict them.
+	2, the dirty frames among the first 1/BM_WRITER_HORIZON of them are written, so the next victims are clean
+	and a miss does not have to write. Further along the order the writer only goes on while more than
+	dirtyTarget percent of the frames are dirty.
+	3, the chosen frames are written with flushFrames() like forceFlushPool() does, the replacement latch is only
+	held while the order is computed.
+*/
+static void backgroundWrite (BM_BufferPool *const bm, BM_mgmtData *mgmtData){
 
-        mgmtData->page_count=page_count;
+  int i, numDirty=0, numCandidates=0, numChosen=0, horizon;
+  PageNumber pageNum;
+  BM_FrameEntry *order=mgmtData->writerOrder;
 
+  //1, the unpinned frames and their eviction order
+  latch(mgmtData, &mgmtData->replacementLatch);
 
-        return RC_OK;
-      }
-      //if the queue is full, use FIFO or LRU strategy
-      else
-      {
-        //find the element with largest LRU_order number, and replace it with new element
+  strategyRanks(bm, mgmtData, mgmtData->writerRanks);
 
-        //find the position of this element
-        int g, position, min_value, max_value;
+  for(i=0;i<bm->numPages;i++){
 
-        position = -1;
-        for (g=0;g<page_count;g++){
-          if (mgmtData->pages[g].pin_fix_count == 0) {
-            position = g;
-            break;
-          }
-        }
+    if(RELAXED_LOAD(mgmtData->pages[i].pageNum)==NO_PAGE){
+      continue;
+    }
 
-        if (position == -1) {
-          return -1;
-        }
+    if(RELAXED_LOAD(mgmtData->pages[i].dirty)){
+      numDirty++;
+    }
 
-        //find position to replace
-        min_value=mgmtData->LRU_Order[0];
+    if(RELAXED_LOAD(mgmtData->pages[i].pin_fix_count)==0){
+      order[numCandidates].key=mgmtData->writerRanks[i];
+      order[numCandidates].frame=i;
+      numCandidates++;
+    }
+  }
 
-        for (g=0;g<page_count;g++){
+  unlatch(mgmtData, &mgmtData->replacementLatch);
 
-          if(mgmtData->pages[g].pin_fix_count == 0 && mgmtData->LRU_Order[g]<=min_value)
-          {
-            min_value=mgmtData->LRU_Order[g];
-            position=g;
-          }
-        }
+  if(numDirty==0){
+    return;
+  }
 
-        //increment the LRU_Order number for each element
-        mgmtData->LRU_Order[position] = g_tick++;
-        
+  qsort(order, numCandidates, sizeof(BM_FrameEntry), compareFrameEntries);
 
-        //rewrite later
-        if(mgmtData->pages[position].dirty==1){
-          writeBlock(mgmtData->pages[position].pageNum, mgmtData->fileHandle, mgmtData->pages[position].data);
-          mgmtData->write_count++;
-        }
+  //2, the next victims always, then as long as the pool is dirtier than the target. The chosen frames move to
+  //the front of order, keyed by their page number.
+  horizon=numCandidates/BM_WRITER_HORIZON+1;
 
+  for(i=0;i<numCandidates;i++){
+
+    if(i>=horizon && numDirty*100<=mgmtData->dirtyTarget*RELAXED_LOAD(bm->numPages)){
+      break;
+    }
 
-        //pin_fix_count = 0
+    pageNum=RELAXED_LOAD(mgmtData->pages[order[i].frame].pageNum);
 
-        //replace the element at the position we got
-        SM_PageHandle memPage;
+    if(pageNum!=NO_PAGE && RELAXED_LOAD(mgmtData->pages[order[i].frame].dirty)){
+      order[numChosen].key=pageNum;
+      order[numChosen].frame=order[i].frame;
+      numChosen++;
+      numDirty--;
+    }
+  }
 
-        //read the page and store it at the position of tail
-        memPage=mgmtData->pages[position].data; 
+  flushFrames(bm, mgmtData, order, numChosen);
 
-        readBlock(pageNum, mgmtData->fileHandle, memPage); //read a page from disk to this position 
-                                                              //in buffer pool
+}
 
-        mgmtData->read_count++;
+static void *writerMain (void *arg){
 
+  BM_BufferPool *bm=(BM_BufferPool *)arg;
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  struct timespec until;
 
-        //update other info, including the page number of this page, pin_fix_count, and dirty or not.
-        mgmtData->pages[position].pageNum=pageNum;
-        mgmtData->pages[position].pin_fix_count = 1;  
-        mgmtData->pages[position].dirty=0;
+  pthread_mutex_lock(&mgmtData->writerLatch);
 
+  while(!mgmtData->writerStop){
 
-        //set the features of PageHandle that has been passed in the method
-        page->pageNum=pageNum;
-        page->data=mgmtData->pages[position].data;
-        page->pin_fix_count=mgmtData->pages[position].pin_fix_count;
-        page->dirty=mgmtData->pages[position].dirty;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec+=BM_WRITER_INTERVAL_MS*1000000L;
+    if(until.tv_nsec>=1000000000L){
+      until.tv_sec++;
+      until.tv_nsec-=1000000000L;
+    }
 
-        
-        //since the queue is full, no need to update the page_count
+    pthread_cond_timedwait(&mgmtData->writerWake, &mgmtData->writerLatch, &until);
 
-        return RC_OK;
-      }
+    if(mgmtData->writerStop){
+      break;
+    }
 
+    pthread_mutex_unlock(&mgmtData->writerLatch);
+    backgroundWrite(bm, mgmtData);
+    pthread_mutex_lock(&mgmtData->writerLatch);
   }
 
+  pthread_mutex_unlock(&mgmtData->writerLatch);
+
+  return NULL;
+
 }
 
 // Statistics Interface
-PageNumber *getFrameContents (BM_BufferPool *const bm){
 
-  int i;
-  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+//the background writer may change the frames while these are read, each value is only a snapshot
+//fill the arrays of the snapshot in one pass over the frames, arrays that are NULL are skipped. Every field is read
+//on its own, so in a concurrent pool the snapshot is not an atomic picture of the pool.
+RC getPoolSnapshot (BM_BufferPool *const bm, BM_PoolSnapshot *snapshot){
 
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_PageHandle *frame;
+  int i;
 
-  PageNumber *fcontents = malloc(sizeof(PageNumber) * bm->numPages);
+  for(i=0;i<bm->numPages;i++){
 
+    frame=&mgmtData->pages[i];
 
-  for(i=0;i<bm->numPages;i++){
-      fcontents[i] = mgmtData->pages[i].pageNum;
+    if(snapshot->frameContents!=NULL){
+      snapshot->frameContents[i]=RELAXED_LOAD(frame->pageNum);
+    }
+    if(snapshot->dirtyFlags!=NULL){
+      snapshot->dirtyFlags[i]=(RELAXED_LOAD(frame->dirty)==1);
+    }
+    if(snapshot->fixCounts!=NULL){
+      snapshot->fixCounts[i]=RELAXED_LOAD(frame->pin_fix_count);
+    }
   }
 
-  return fcontents;
+  return RC_OK;
 
 }
 
-bool *getDirtyFlags (BM_BufferPool *const bm){
+//the single array getters allocate their result, the caller frees it
+PageNumber *getFrameContents (BM_BufferPool *const bm){
 
-  int i;
+  BM_PoolSnapshot snapshot={ NULL, NULL, NULL };
 
-  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  snapshot.frameContents=(PageNumber *)malloc(sizeof(PageNumber)*bm->numPages);
+  getPoolSnapshot(bm, &snapshot);
 
-  bool *flags = malloc(sizeof(bool) * bm->numPages);
+  return snapshot.frameContents;
 
-  for(i=0; i<bm->numPages; i++){
-    if(mgmtData->pages[i].dirty == 1){
-      flags[i] = true;
-    }
-    else{
-      flags[i] = false;
-    }
+}
 
-  }
+bool *getDirtyFlags (BM_BufferPool *const bm){
+
+  BM_PoolSnapshot snapshot={ NULL, NULL, NULL };
+
+  snapshot.dirtyFlags=(bool *)malloc(sizeof(bool)*bm->numPages);
+  getPoolSnapshot(bm, &snapshot);
+
+  return snapshot.dirtyFlags;
 
-  return flags;
 }
 
 int *getFixCounts (BM_BufferPool *const bm){
 
-  int i;
-  
-  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_PoolSnapshot snapshot={ NULL, NULL, NULL };
+
+  snapshot.fixCounts=(int *)malloc(sizeof(int)*bm->numPages);
+  getPoolSnapshot(bm, &snapshot);
+
+  return snapshot.fixCounts;
+
+}
+
+//a counter summed over the slots of all threads
+static long long sumStat (BM_mgmtData *mgmtData, int counter){
 
-  int *fcounts = malloc(sizeof(int) * bm->numPages);
+  long long sum=0;
+  int i;
 
-  for(i=0; i<bm->numPages; i++)
-  {
-    fcounts[i]= mgmtData->pages[i].pin_fix_count;
+  for(i=0;i<=BM_STAT_SLOTS;i++){
+    sum+=__atomic_load_n(&mgmtData->stats[i].counters[counter], __ATOMIC_RELAXED);
   }
 
-  return fcounts;
+  return sum;
 
 }
 
@@ -561,13 +3787,57 @@ int getNumReadIO (BM_BufferPool *const bm){
 
   BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
 
-  return mgmtData->read_count;
+  return (int)sumStat(mgmtData, STAT_READS);
 }
 
 int getNumWriteIO (BM_BufferPool *const bm){
     BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
 
-  return mgmtData->write_count;
+  return (int)sumStat(mgmtData, STAT_WRITES);
+}
+
+//merge the slots of all threads. Counts of operations still running may be missing, each counter is read on its own.
+void getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats){
+
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+  BM_Histogram *histograms[BM_NUM_TIMERS];
+  long long count;
+  int i, t, b;
+
+  memset(stats, 0, sizeof(BM_PoolStats));
+
+  stats->hits=sumStat(mgmtData, STAT_HITS);
+  stats->misses=sumStat(mgmtData, STAT_MISSES);
+  stats->evictions=sumStat(mgmtData, STAT_EVICTIONS);
+  stats->dirtyEvictions=sumStat(mgmtData, STAT_DIRTY_EVICTIONS);
+  stats->reads=sumStat(mgmtData, STAT_READS);
+  stats->writes=sumStat(mgmtData, STAT_WRITES);
+  stats->traceDropped=__atomic_load_n(&mgmtData->traceDropped, __ATOMIC_RELAXED);
+
+  histograms[TIMER_PIN]=&stats->pinLatency;
+  histograms[TIMER_READ]=&stats->readLatency;
+  histograms[TIMER_WRITE]=&stats->writeLatency;
+
+  for(i=0;i<=BM_STAT_SLOTS;i++){
+    for(t=0;t<BM_NUM_TIMERS;t++){
+      for(b=0;b<BM_HISTOGRAM_BUCKETS;b++){
+        count=__atomic_load_n(&mgmtData->stats[i].histograms[t][b], __ATOMIC_RELAXED);
+        histograms[t]->buckets[b]+=count;
+        histograms[t]->count+=count;
+      }
+    }
+  }
+
 }
 
+//ARC only, the current target size of T1 in frames, -1 for the other strategies
+int getARCTarget (BM_BufferPool *const bm){
+
+  BM_mgmtData *mgmtData=(BM_mgmtData *)(bm->mgmtData);
+
+  if(bm->strategy!=RS_ARC){
+    return -1;
+  }
 
+  return mgmtData->arcTarget;
+}
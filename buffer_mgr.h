@@ -5,6 +5,7 @@
 #include "dberror.h"
 
 #include "storage_mgr.h"
+#include "wal_mgr.h"
 // Include bool DT
 #include "dt.h"
 
@@ -14,7 +15,8 @@ typedef enum ReplacementStrategy {
   RS_LRU = 1,
   RS_CLOCK = 2,
   RS_LFU = 3,
-  RS_LRU_K = 4
+  RS_LRU_K = 4,
+  RS_ARC = 5
 } ReplacementStrategy;
 
 // Data Types and Structures
@@ -29,6 +31,18 @@ typedef struct BM_BufferPool {
                   // manager needs for a buffer pool
 } BM_BufferPool;
 
+// parameters for RS_LRU_K, passed as stratData to initBufferPool (NULL uses the defaults)
+typedef struct BM_LRUKParams {
+  int k;                // number of references remembered per page, default 2
+  int correlatedPeriod; // references closer than this many pins to the last one count as one, default 0
+  int retainedPeriod;   // how long an evicted page's history is kept, in pins (0 is forever)
+} BM_LRUKParams;
+
+// parameters for RS_LFU, passed as stratData to initBufferPool (NULL disables aging)
+typedef struct BM_LFUParams {
+  int agingPeriod;      // halve every reference count after this many pins, 0 never
+} BM_LFUParams;
+
 typedef struct BM_PageHandle {
   PageNumber pageNum;
   SM_PageHandle data;
@@ -46,25 +60,121 @@ typedef struct BM_PageHandle {
 #define MAKE_PAGE_HANDLE()				\
   ((BM_PageHandle *) malloc (sizeof(BM_PageHandle)))
 
+// options for initBufferPoolWithOptions, all zero gives the same pool as initBufferPool
+typedef struct BM_PoolOptions {
+  bool concurrent;      // the pool may be used by several threads at once
+  bool hugePages;       // back the frames with transparent huge pages where the kernel allows it
+  bool directIO;        // read and write the page file with O_DIRECT, bypassing the OS page cache
+  bool mappedFile;      // map the page file into memory instead of reading and writing it (wins over directIO)
+  int asyncDepth;       // reads pinPageAsync keeps in flight, 0 uses the default of 64
+  bool asyncThreads;    // pinPageAsync reads with a thread pool even where io_uring is available
+  int readahead;        // most pages read ahead of a sequential run of pins, 0 disables readahead
+  int dirtyTarget;      // percent of dirty frames a background writer keeps the pool under, 0 disables it
+  bool preallocate;     // reserve disk space for the page file in growing extents ahead of its end
+  WAL_Log *log;         // an open write-ahead log, redone into the page file at init, NULL for none
+  char *traceFile;      // record every pin, unpin, markDirty and forcePage into this file, NULL for none
+  bool simulated;       // open no page file, reads and writes are only counted (for replaying traces)
+  bool latencyStats;    // time pinPage, readBlock and writeBlock for the histograms of getPoolStats
+  int maxFrames;        // resizeBufferPool can grow the pool up to this many frames, 0 for numPages
+} BM_PoolOptions;
+
+// access traces, a BM_TraceHeader followed by one BM_TraceRecord per operation in the order they happened
+#define BM_TRACE_MAGIC "ADOTRACE"
+#define BM_TRACE_VERSION 1
+
+#define BM_TRACE_PIN 0
+#define BM_TRACE_UNPIN 1
+#define BM_TRACE_DIRTY 2
+#define BM_TRACE_FORCE 3
+
+typedef struct BM_TraceHeader {
+  char magic[8];
+  int version;
+  int numFrames;        // size and strategy of the traced pool
+  int strategy;
+  int reserved;
+} BM_TraceHeader;
+
+typedef struct BM_TraceRecord {
+  long long time;       // nanoseconds since the pool was initialized
+  PageNumber pageNum;
+  short thread;         // threads are numbered from 0 in the order they first record an operation
+  char op;              // BM_TRACE_PIN, BM_TRACE_UNPIN, BM_TRACE_DIRTY or BM_TRACE_FORCE
+  char reserved;
+} BM_TraceRecord;
+
+// access hints for pinPageHinted, a scan or a bulk write only recycles the few frames of its own ring instead of
+// evicting the pages everybody else uses
+typedef enum BM_AccessHint {
+  BM_HINT_NORMAL = 0,     // like pinPage
+  BM_HINT_SCAN = 1,       // pages read once in order, a dirty frame of the ring is left to the replacement strategy
+  BM_HINT_BULK_WRITE = 2  // pages written once, a larger ring whose dirty frames are written back when recycled
+} BM_AccessHint;
+
+// the frames a scan or bulk write used last, to be recycled by its next misses. A ring belongs to one thread.
+typedef struct BM_AccessRing {
+  BM_AccessHint hint;
+  int numFrames;        // the frames the ring uses, an eighth of the pool at most as of its last miss
+  void *mgmtData;
+} BM_AccessRing;
+
 // Buffer Manager Interface Pool Handling
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		  const int numPages, ReplacementStrategy strategy, 
 		  void *stratData);
+RC initBufferPoolWithOptions(BM_BufferPool *const bm, const char *const pageFileName, 
+		  const int numPages, ReplacementStrategy strategy, 
+		  void *stratData, const BM_PoolOptions *options);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+RC checkpointBufferPool(BM_BufferPool *const bm);
+
+// change the number of frames of a pool in use, up to BM_PoolOptions.maxFrames. Shrinking evicts the pages the
+// strategy would evict next and fails with RC_RESIZE_FAILED if too many frames are pinned, pages already evicted
+// by then stay evicted. Snapshots must not be taken while the pool is resized.
+RC resizeBufferPool(BM_BufferPool *const bm, int numPages);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
+RC markDirtyLogged (BM_BufferPool *const bm, BM_PageHandle *const page, 
+		    int offset, int length, WAL_Lsn *lsn);
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 	    const PageNumber pageNum);
 
+// Buffer Manager Interface Access Hints
+// numFrames 0 takes the default size of the hint, a ring never uses more than an eighth of the frames the pool
+// has at the time of a pin
+RC initAccessRing (BM_BufferPool *const bm, BM_AccessRing *ring, BM_AccessHint hint, int numFrames);
+RC freeAccessRing (BM_AccessRing *ring);
+// a NULL ring pins like pinPage. Hinted pins do not count as references for the replacement strategy and
+// start no readahead.
+RC pinPageHinted (BM_BufferPool *const bm, BM_PageHandle *const page, 
+		  const PageNumber pageNum, BM_AccessRing *ring);
+
+// Buffer Manager Interface Asynchronous Pins
+typedef int BM_PinToken;
+
+RC pinPageAsync (BM_BufferPool *const bm, BM_PageHandle *const page, 
+		 const PageNumber pageNum, BM_PinToken *token);
+bool pinPageDone (BM_BufferPool *const bm, BM_PinToken token);
+RC waitPinPage (BM_BufferPool *const bm, BM_PinToken token);
+
 // Statistics Interface
+// a snapshot of every frame, the caller provides arrays of bm->numPages entries, a NULL array is skipped
+typedef struct BM_PoolSnapshot {
+  PageNumber *frameContents;
+  bool *dirtyFlags;
+  int *fixCounts;
+} BM_PoolSnapshot;
+
+RC getPoolSnapshot (BM_BufferPool *const bm, BM_PoolSnapshot *snapshot);
 PageNumber *getFrameContents (BM_BufferPool *const bm);
 bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+int getARCTarget (BM_BufferPool *const bm);
 
 #endif
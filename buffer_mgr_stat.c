@@ -6,47 +6,45 @@
 
 // local functions
 static void printStrat (BM_BufferPool *const bm);
+static void takeSnapshot (BM_BufferPool *const bm, BM_PoolSnapshot *snapshot);
 
 // external functions
 void 
 printPoolContent (BM_BufferPool *const bm)
 {
-  PageNumber *frameContent;
-  bool *dirty;
-  int *fixCount;
+  BM_PoolSnapshot snapshot;
   int i;
 
-  frameContent = getFrameContents(bm);
-  dirty = getDirtyFlags(bm);
-  fixCount = getFixCounts(bm);
+  takeSnapshot(bm, &snapshot);
 
   printf("{");
   printStrat(bm);
   printf(" %i}: ", bm->numPages); 
   
   for (i = 0; i < bm->numPages; i++)
-      printf("%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+      printf("%s[%i%s%i]", ((i == 0) ? "" : ",") , snapshot.frameContents[i], (snapshot.dirtyFlags[i] ? "x": " "),
+	     snapshot.fixCounts[i]);
   printf("\n");
+
+  free(snapshot.frameContents);
 }
 
 char *
 sprintPoolContent (BM_BufferPool *const bm)
 {
-  PageNumber *frameContent;
-  bool *dirty;
-  int *fixCount;
+  BM_PoolSnapshot snapshot;
   int i;
   char *message;
   int pos = 0;
 
   message = (char *) malloc(256 + (22 * bm->numPages));
-  frameContent = getFrameContents(bm);
-  dirty = getDirtyFlags(bm);
-  fixCount = getFixCounts(bm);
+  takeSnapshot(bm, &snapshot);
 
   for (i = 0; i < bm->numPages; i++)
-    pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
-  
+    pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ",") , snapshot.frameContents[i],
+		   (snapshot.dirtyFlags[i] ? "x": " "), snapshot.fixCounts[i]);
+
+  free(snapshot.frameContents);
   return message;
 }
 
@@ -78,6 +76,68 @@ sprintPageContent (BM_PageHandle *const page)
   return message;
 }
 
+// upper end in nanoseconds of the bucket that holds the given percentile (0 to 100), 0 for an empty histogram
+long long
+histogramPercentile (BM_Histogram *histogram, double percentile)
+{
+  long long rank = (long long) (histogram->count * percentile / 100);
+  long long seen = 0;
+  int i;
+
+  if (histogram->count == 0)
+    return 0;
+
+  for (i = 0; i < BM_HISTOGRAM_BUCKETS - 1; i++)
+    {
+      seen += histogram->buckets[i];
+      if (seen > rank)
+	break;
+    }
+
+  return (2LL << i) - 1;
+}
+
+void
+printPoolStats (BM_BufferPool *const bm)
+{
+  BM_PoolStats stats;
+  BM_Histogram *histograms[3];
+  char *names[3] = { "pin", "read", "write" };
+  long long pins;
+  int i;
+
+  getPoolStats(bm, &stats);
+  pins = stats.hits + stats.misses;
+
+  printf("{");
+  printStrat(bm);
+  printf(" %i}: %lld pins, %.2f%% hits, %lld evictions (%lld dirty), %lld reads, %lld writes\n", bm->numPages, pins,
+	 (pins > 0) ? 100.0 * stats.hits / pins : 0.0, stats.evictions, stats.dirtyEvictions, stats.reads, stats.writes);
+
+  histograms[0] = &stats.pinLatency;
+  histograms[1] = &stats.readLatency;
+  histograms[2] = &stats.writeLatency;
+
+  for (i = 0; i < 3; i++)
+    if (histograms[i]->count > 0)
+      printf("%s latency: %lld times, p50 < %lld ns, p99 < %lld ns, p999 < %lld ns\n", names[i], histograms[i]->count,
+	     histogramPercentile(histograms[i], 50), histogramPercentile(histograms[i], 99),
+	     histogramPercentile(histograms[i], 99.9));
+
+  if (stats.traceDropped > 0)
+    printf("%lld trace records could not be written\n", stats.traceDropped);
+}
+
+// a snapshot of all frames with the three arrays in one allocation, free(snapshot->frameContents) frees them
+void
+takeSnapshot (BM_BufferPool *const bm, BM_PoolSnapshot *snapshot)
+{
+  snapshot->frameContents = malloc((sizeof(PageNumber) + sizeof(int) + sizeof(bool)) * bm->numPages);
+  snapshot->fixCounts = (int *) (snapshot->frameContents + bm->numPages);
+  snapshot->dirtyFlags = (bool *) (snapshot->fixCounts + bm->numPages);
+  getPoolSnapshot(bm, snapshot);
+}
+
 void
 printStrat (BM_BufferPool *const bm)
 {
@@ -98,6 +158,9 @@ printStrat (BM_BufferPool *const bm)
     case RS_LRU_K:
       printf("LRU-K");
       break;
+    case RS_ARC:
+      printf("ARC");
+      break;
     default:
       printf("%i", bm->strategy);
       break;
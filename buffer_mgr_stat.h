@@ -9,4 +9,30 @@ void printPageContent (BM_PageHandle *const page);
 char *sprintPoolContent (BM_BufferPool *const bm);
 char *sprintPageContent (BM_PageHandle *const page);
 
+// statistics of a pool, summed over all threads that used it. Bucket i of a latency histogram counts the
+// operations that took 2^i to 2^(i+1)-1 nanoseconds (bucket 0 also 0 and 1), the last bucket all longer ones.
+#define BM_HISTOGRAM_BUCKETS 32
+
+typedef struct BM_Histogram {
+  long long count;
+  long long buckets[BM_HISTOGRAM_BUCKETS];
+} BM_Histogram;
+
+typedef struct BM_PoolStats {
+  long long hits;             // pins that found their page in the pool
+  long long misses;           // pins that read their page
+  long long evictions;        // pages replaced by another page
+  long long dirtyEvictions;   // misses that had to write a dirty victim first
+  long long reads;            // pages read, reads ahead included
+  long long writes;           // pages written
+  long long traceDropped;     // access trace records lost because the trace file could not be written
+  BM_Histogram pinLatency;    // pinPage calls that succeeded
+  BM_Histogram readLatency;   // readBlock of a pinPage miss
+  BM_Histogram writeLatency;  // writeBlock and writeBlocks calls
+} BM_PoolStats;
+
+void getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats);
+long long histogramPercentile (BM_Histogram *histogram, double percentile);
+void printPoolStats (BM_BufferPool *const bm);
+
 #endif
@@ -0,0 +1,225 @@
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// pool sizes tried when none are given, as multiples of the traced pool size
+static double defaultScales[] = { 0.25, 0.5, 1, 2, 4 };
+
+static char *strategyNames[] = { "fifo", "lru", "clock", "lfu", "lru-k", "arc" };
+
+#define NUM_SCALES (sizeof(defaultScales) / sizeof(defaultScales[0]))
+#define NUM_STRATEGIES ((int) (sizeof(strategyNames) / sizeof(strategyNames[0])))
+
+typedef struct Trace {
+  BM_TraceHeader header;
+  BM_TraceRecord *records;
+  long numRecords;
+  PageNumber maxPage;
+} Trace;
+
+// replay
+static void replayTrace (Trace *trace, ReplacementStrategy strategy, int numFrames);
+
+// helper methods
+static bool loadTrace (char *fileName, Trace *trace);
+static void describeTrace (Trace *trace);
+
+// main method, the arguments are a trace written by a pool with BM_PoolOptions.traceFile, the replacement
+// strategy (fifo, lru, clock, lfu, lru-k, arc or all) and any number of pool sizes. Without pool sizes the
+// trace is replayed with a quarter, half, one, two and four times the frames of the traced pool.
+int
+main (int argc, char *argv[])
+{
+  Trace trace;
+  int strategy = -1;
+  int *sizes, numSizes, s, i;
+
+  if (argc < 2)
+    {
+      fprintf(stderr, "usage: %s trace [strategy|all] [frames ...]\n", argv[0]);
+      return 1;
+    }
+
+  if (argc > 2 && strcmp(argv[2], "all") != 0)
+    {
+      for (strategy = 0; strategy < NUM_STRATEGIES && strcmp(argv[2], strategyNames[strategy]) != 0; strategy++);
+      if (strategy == NUM_STRATEGIES)
+	{
+	  fprintf(stderr, "unknown strategy %s\n", argv[2]);
+	  return 1;
+	}
+    }
+
+  if (!loadTrace(argv[1], &trace))
+    return 1;
+
+  if (argc > 3)
+    {
+      numSizes = argc - 3;
+      sizes = malloc(sizeof(int) * numSizes);
+      for (i = 0; i < numSizes; i++)
+	sizes[i] = atoi(argv[3 + i]);
+    }
+  else
+    {
+      numSizes = NUM_SCALES;
+      sizes = malloc(sizeof(int) * numSizes);
+      for (i = 0; i < numSizes; i++)
+	sizes[i] = (int) (trace.header.numFrames * defaultScales[i]);
+    }
+
+  initStorageManager();
+  describeTrace(&trace);
+
+  printf("\n%8s %10s %8s %10s %10s %10s\n", "strategy", "frames", "hit %", "reads", "writes", "failed");
+  for (s = 0; s < NUM_STRATEGIES; s++)
+    for (i = 0; i < numSizes; i++)
+      if ((strategy < 0 || strategy == s) && sizes[i] > 0)
+	replayTrace(&trace, s, sizes[i]);
+
+  free(sizes);
+  free(trace.records);
+  return 0;
+}
+
+// feed the trace through a simulated pool, in the order the operations happened. A pin that fails because every
+// frame is pinned is skipped together with its unpin, failed counts them.
+void
+replayTrace (Trace *trace, ReplacementStrategy strategy, int numFrames)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  int *skipped = calloc(trace->maxPage + 1, sizeof(int));
+  long pins = 0, failed = 0, i;
+  int reads, writes;
+
+  options.simulated = true;
+  CHECK(initBufferPoolWithOptions(bm, "replay", numFrames, strategy, NULL, &options));
+
+  h->data = NULL;
+  for (i = 0; i < trace->numRecords; i++)
+    {
+      h->pageNum = trace->records[i].pageNum;
+
+      switch (trace->records[i].op)
+	{
+	case BM_TRACE_PIN:
+	  if (pinPage(bm, h, h->pageNum) == RC_OK)
+	    pins++;
+	  else
+	    {
+	      skipped[h->pageNum]++;
+	      failed++;
+	    }
+	  break;
+	case BM_TRACE_UNPIN:
+	  if (skipped[h->pageNum] > 0)
+	    skipped[h->pageNum]--;
+	  else
+	    CHECK(unpinPage(bm, h));
+	  break;
+	case BM_TRACE_DIRTY:
+	  CHECK(markDirty(bm, h));
+	  break;
+	case BM_TRACE_FORCE:
+	  CHECK(forcePage(bm, h));
+	  break;
+	}
+    }
+
+  // the writes of the final flush are not counted, every strategy would do the same number of them
+  reads = getNumReadIO(bm);
+  writes = getNumWriteIO(bm);
+
+  printf("%8s %10i %8.2f %10i %10i %10li\n", strategyNames[strategy], numFrames,
+	 (pins > 0) ? 100.0 * (pins - reads) / pins : 0.0, reads, writes, failed);
+
+  CHECK(shutdownBufferPool(bm));
+
+  free(skipped);
+  free(bm);
+  free(h);
+}
+
+// read the whole trace into memory, records with a negative page number are dropped
+bool
+loadTrace (char *fileName, Trace *trace)
+{
+  FILE *file = fopen(fileName, "rb");
+  BM_TraceRecord record;
+  long capacity = 1024;
+
+  if (file == NULL)
+    {
+      perror(fileName);
+      return false;
+    }
+
+  if (fread(&trace->header, sizeof(BM_TraceHeader), 1, file) != 1
+      || memcmp(trace->header.magic, BM_TRACE_MAGIC, sizeof(trace->header.magic)) != 0
+      || trace->header.version != BM_TRACE_VERSION)
+    {
+      fprintf(stderr, "%s is not a trace\n", fileName);
+      fclose(file);
+      return false;
+    }
+
+  trace->records = malloc(sizeof(BM_TraceRecord) * capacity);
+  trace->numRecords = 0;
+  trace->maxPage = 0;
+
+  while (fread(&record, sizeof(BM_TraceRecord), 1, file) == 1)
+    {
+      if (record.pageNum < 0)
+	continue;
+      if (trace->numRecords == capacity)
+	{
+	  capacity *= 2;
+	  trace->records = realloc(trace->records, sizeof(BM_TraceRecord) * capacity);
+	}
+      trace->records[trace->numRecords++] = record;
+      if (record.pageNum > trace->maxPage)
+	trace->maxPage = record.pageNum;
+    }
+
+  fclose(file);
+  return true;
+}
+
+// print what the trace holds: the traced pool, the operations, threads and distinct pages and how long it ran
+void
+describeTrace (Trace *trace)
+{
+  char *seen = calloc(trace->maxPage + 1, 1);
+  long ops[4] = { 0, 0, 0, 0 };
+  int threads = 0, pages = 0;
+  long i;
+
+  for (i = 0; i < trace->numRecords; i++)
+    {
+      BM_TraceRecord *record = &trace->records[i];
+
+      if (record->op >= 0 && record->op < 4)
+	ops[(int) record->op]++;
+      if (record->thread >= threads)
+	threads = record->thread + 1;
+      if (record->op == BM_TRACE_PIN && !seen[record->pageNum])
+	{
+	  seen[record->pageNum] = 1;
+	  pages++;
+	}
+    }
+
+  printf("traced pool: %i frames, %s\n", trace->header.numFrames,
+	 (trace->header.strategy >= 0 && trace->header.strategy < NUM_STRATEGIES) ? strategyNames[trace->header.strategy] : "?");
+  printf("%li pins, %li unpins, %li dirty, %li forced, %i threads, %i distinct pages, %.3f s\n", ops[BM_TRACE_PIN],
+	 ops[BM_TRACE_UNPIN], ops[BM_TRACE_DIRTY], ops[BM_TRACE_FORCE], threads, pages,
+	 (trace->numRecords > 0) ? trace->records[trace->numRecords - 1].time / 1e9 : 0.0);
+
+  free(seen);
+}
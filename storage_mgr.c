@@ -1,32 +1,1421 @@
 #ifndef STORAGE_MGR_H
 #define STORAGE_MGR_H
 
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
 #include <stdio.h>
 #include <stdlib.h>
 #include "dberror.h"
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* module wide constants */
+#define META_SIZE 4096
+
+/* the superblock at the start of the META_SIZE header. A file whose format version is newer than SM_FORMAT_VERSION, or
+that uses incompatible features this code does not know, is not opened. */
+#define SM_MAGIC "ADOPGFL"
+#define SM_FORMAT_VERSION 1
+#define SM_KNOWN_FEATURES (SM_FEATURE_CHECKSUMS|SM_FEATURE_COMPRESSED)
+
+/* incompatible format features. SM_FEATURE_CHECKSUMS stores the CRC32C of every page, the checksums of SM_SUM_GROUP
+pages fill one block that sits in the file in front of these pages. */
+#define SM_FEATURE_CHECKSUMS 1
+#define SM_SUM_GROUP (PAGE_SIZE/4)
+
+/* SM_FEATURE_COMPRESSED stores every page compressed, in a slot of 1 to SM_SLOT_CLASSES units of SM_SLOT_UNIT bytes
+anywhere behind the header (the class of a slot is its number of units). The map of the file holds the slot of every
+page, the map entries of SM_MAP_GROUP pages fill one map block, which has a slot of its own. The units of the map blocks
+follow the superblock in the header, from SM_MAP_DIR_OFFSET on, so a file has at most SM_MAP_DIR_MAX map blocks. */
+#define SM_FEATURE_COMPRESSED 2
+#define SM_SLOT_UNIT 512
+#define SM_SLOT_CLASSES (PAGE_SIZE/SM_SLOT_UNIT)
+#define SM_MAP_GROUP (PAGE_SIZE/4)
+#define SM_MAP_DIR_OFFSET 64
+#define SM_MAP_DIR_MAX ((META_SIZE-SM_MAP_DIR_OFFSET)/4)
+
+/* a map entry, the class of the slot in the top 4 bits and its first unit in the others. Class 0 is a page of zeroes
+without a slot, class SM_SLOT_CLASSES a page stored as it is. */
+#define SM_SLOT(cls,unit) (((uint32_t)(cls)<<28)|(uint32_t)(unit))
+#define SM_SLOT_CLASS(entry) ((int)((entry)>>28))
+#define SM_SLOT_FIRST(entry) ((entry) & 0x0fffffff)
+
+/* the compressor: matches are at least SM_MIN_MATCH bytes long, its hash table has 2^SM_HASH_BITS entries */
+#define SM_MIN_MATCH 4
+#define SM_HASH_BITS 12
+
+/* flags of createPageFileWithFlags */
+#define SM_CREATE_CHECKSUMS 1
+#define SM_CREATE_COMPRESSED 2
+
+/* flags of openPageFileWithFlags. SM_OPEN_DIRECT bypasses the OS page cache with O_DIRECT, SM_OPEN_MMAP maps the whole
+file and lets the kernel manage which pages are resident. */
+#define SM_OPEN_DIRECT 1
+#define SM_OPEN_MMAP 2
+
+/* SM_OPEN_PREALLOC reserves disk space ahead of the end of the file with fallocate, each reservation as large as the
+file (at least SM_PREALLOC_MIN_PAGES, at most SM_PREALLOC_MAX_PAGES), so a growing file gets a few large extents */
+#define SM_OPEN_PREALLOC 4
+#define SM_PREALLOC_MIN_PAGES 16
+#define SM_PREALLOC_MAX_PAGES 65536
+
+/* most pages writeBlocks passes to one pwritev call */
+#define SM_WRITEV_MAX 256
+
+/* a mapped file starts writing back its dirty pages (msync with MS_ASYNC) after this many writeBlock calls */
+#define SM_MSYNC_BATCH 64
+
+/* modes of initAsyncIO. SM_ASYNC_RING uses io_uring and falls back to SM_ASYNC_THREADS, a pool of threads doing pread,
+when the kernel does not support it. */
+#define SM_ASYNC_RING 1
+#define SM_ASYNC_THREADS 2
+
+/* most threads of the SM_ASYNC_THREADS pool */
+#define SM_ASYNC_MAX_THREADS 16
+
+/* O_DIRECT transfers need buffers, offsets and sizes aligned to the logical block size of the device. META_SIZE and
+PAGE_SIZE are multiples of this, so only the buffers have to be checked. */
+#define SM_DIRECT_ALIGN 4096
+
+/************************************************************
+ *                    handle data structures                *
+ ************************************************************/
+typedef struct SM_FileHandle {
+  char *fileName;
+  int totalNumPages;
+  int curPagePos;
+  void *mgmtInfo;
+} SM_FileHandle;
+
+/* create a new structure to hold the file descriptor of the page file. All block I/O uses pread/pwrite at an
+explicit offset, so several threads can read or write different pages of one file handle at the same time. */
+/* one submitted read, user_data of its io_uring entry or an element of the thread pool queue */
+typedef struct SM_IORequest {
+
+	int pageNum;
+	char *memPage;
+	void *tag;
+	struct SM_IORequest *next;
+
+} SM_IORequest;
+
+/* a finished read, returned by reapBlockIO */
+typedef struct SM_IOCompletion {
+
+	void *tag;
+	int rc;
+
+} SM_IOCompletion;
+
+/* the free slots of one class, a stack of their first units */
+typedef struct SM_FreeSlots {
+
+	uint32_t *units;
+	int count;
+	int capacity;
+
+} SM_FreeSlots;
+
+/* the asynchronous I/O engine of a file handle.
+	1, lock protects everything but the completion ring, which the kernel fills. pending counts the reads that are
+	submitted but not yet in ready.
+	2, io_uring: the rings are shared with the kernel, their head and tail indexes are read and written atomically.
+	3, thread pool: queue holds the reads no thread has taken yet, workers wait on work, reapers on done.
+*/
+typedef struct SM_AsyncIO {
+
+	int mode;
+	pthread_mutex_t lock;
+	int pending;
+
+	SM_IOCompletion *ready;
+	int readyCount;
+	int readyCap;
+
+	int ringFd;
+	unsigned depth;
+	unsigned inFlight;
+	unsigned *sqTail;
+	unsigned *sqMask;
+	unsigned *sqArray;
+	unsigned *cqHead;
+	unsigned *cqTail;
+	unsigned *cqMask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sqRing;
+	void *cqRing;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	size_t sqesSize;
+
+	pthread_t *threads;
+	int numThreads;
+	SM_IORequest *queueHead;
+	SM_IORequest *queueTail;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	int stopping;
+
+} SM_AsyncIO;
+
+typedef struct SM_mgmtInfo {
+
+	int fd;
+	int flags;	//the SM_OPEN_ flags in effect, SM_OPEN_DIRECT is cleared when the file system rejects it
+
+	//SM_OPEN_MMAP only. Growing the file may move the mapping, so block I/O holds mapLatch shared and growing holds it
+	//exclusively. unsynced counts the writes since the last msync.
+	char *map;
+	size_t mapSize;
+	pthread_rwlock_t mapLatch;
+	int unsynced;
+
+	//SM_OPEN_PREALLOC only, the number of pages disk space has been reserved for
+	int reservedPages;
+
+	//files with SM_FEATURE_CHECKSUMS only. sums holds the checksum blocks of the file, sumCapacity checksums, a multiple
+	//of SM_SUM_GROUP. sumDirty[g] is set while checksum block g has changes that are not written yet. sumLatch is held
+	//shared to look up a checksum and exclusively to change one, to write the checksum blocks or to grow sums.
+	int checksums;
+	uint32_t *sums;
+	char *sumDirty;
+	int sumCapacity;
+	pthread_rwlock_t sumLatch;
+
+	//files with SM_FEATURE_COMPRESSED only. slots holds the map, slotCapacity entries, a multiple of SM_MAP_GROUP.
+	//mapUnits holds the first unit of each of the numMapBlocks map blocks, freeSlots[c] the free slots of class c, and
+	//endUnit is the first unit past the end of the file. slotLatch is held shared to look up a map entry and
+	//exclusively for everything else.
+	int compressed;
+	uint32_t *slots;
+	int slotCapacity;
+	uint32_t mapUnits[SM_MAP_DIR_MAX];
+	int numMapBlocks;
+	SM_FreeSlots freeSlots[SM_SLOT_CLASSES+1];
+	uint32_t endUnit;
+	pthread_rwlock_t slotLatch;
+
+	//the asynchronous I/O engine, NULL until initAsyncIO
+	SM_AsyncIO *async;
+
+} SM_mgmtInfo;
+
+typedef char* SM_PageHandle;
+
+/* the binary superblock, little endian as the machine writes it. The rest of the header block is zero.
+	1, numPages is the number of pages in the file, freeListHead and numFreePages are left for a free space map (-1
+	and 0 until something manages free pages).
+	2, features are incompatible format features, a reader refuses a file with a feature it does not know.
+	3, checksum is the CRC32C of the superblock with checksum 0, so a torn or damaged header is detected.
+*/
+typedef struct SM_Superblock {
+
+	char magic[8];
+	uint32_t version;
+	uint32_t pageSize;
+	uint64_t numPages;
+	int64_t freeListHead;
+	uint64_t numFreePages;
+	uint32_t features;
+	uint32_t checksum;
+
+} SM_Superblock;
+
+/************************************************************
+ *                    helpers                               *
+ ************************************************************/
+
+/* byte offset of a page in the page file, 64 bits so files larger than 2GB work. With checksums every SM_SUM_GROUP pages
+are preceded by their checksum block. */
+static off_t pageOffset (SM_mgmtInfo *info, int pageNum) {
+
+	if(!info->checksums)
+	{
+		return (off_t)META_SIZE+(off_t)pageNum*PAGE_SIZE;
+	}
+
+	return (off_t)META_SIZE+((off_t)(pageNum/SM_SUM_GROUP)*(SM_SUM_GROUP+1)+pageNum%SM_SUM_GROUP+1)*PAGE_SIZE;
+
+}
+
+/* byte offset of the checksum block of group */
+static off_t sumOffset (int group) {
+
+	return (off_t)META_SIZE+(off_t)group*(SM_SUM_GROUP+1)*PAGE_SIZE;
+
+}
+
+/* size of a page file with numPages pages */
+static off_t fileSize (SM_mgmtInfo *info, int numPages) {
+
+	return (numPages==0) ? META_SIZE : pageOffset(info, numPages-1)+PAGE_SIZE;
+
+}
+
+/* CRC32C (Castagnoli).
+	1, where the CPU has SSE4.2 the crc32 instruction does 8 bytes at a time. It takes 3 cycles but a new one can start
+	every cycle, so 3 lanes of SM_CRC_LANE bytes each are done at once, starting from 0. The CRC of the first lane is
+	then shifted over the second, as if SM_CRC_LANE zero bytes followed it, and xored with the CRC of the second, the
+	same again with the third.
+	2, elsewhere a table does a byte at a time.
+	3, which one is used, and the tables, are set up on the first call. crcShift[j] shifts byte j of a CRC over
+	SM_CRC_LANE bytes, the CRC shifted is the xor of the 4 entries.
+*/
+#define SM_CRC_LANE (PAGE_SIZE/3/8*8)
+
+static pthread_once_t crcOnce=PTHREAD_ONCE_INIT;
+static int crcHardware;
+static uint32_t crcTable[256];
+static uint32_t crcShift[4][256];
+
+static void crcInit (void) {
+
+	uint32_t crc, bits[32];
+	int i, k;
+
+	for(i=0; i<256; i++)
+	{
+		crc=i;
+		for(k=0; k<8; k++)
+		{
+			crc=(crc>>1)^(0x82F63B78u & -(crc&1));
+		}
+		crcTable[i]=crc;
+	}
+
+#if defined(__x86_64__)
+	crcHardware=__builtin_cpu_supports("sse4.2");
+#else
+	crcHardware=0;
+#endif
+
+	//a CRC shifted over zero bytes is linear in the CRC, so shifting each of its bits gives the tables
+	for(k=0; k<32; k++)
+	{
+		crc=1u<<k;
+		for(i=0; i<SM_CRC_LANE; i++)
+		{
+			crc=(crc>>8)^crcTable[crc & 0xff];
+		}
+		bits[k]=crc;
+	}
+
+	for(k=0; k<32; k++)
+	{
+		for(i=0; i<256; i++)
+		{
+			crcShift[k/8][i]^=(i>>(k%8) & 1) ? bits[k] : 0;
+		}
+	}
+
+}
+
+static uint32_t shiftLane (uint32_t crc) {
+
+	return crcShift[0][crc & 0xff]^crcShift[1][(crc>>8) & 0xff]^crcShift[2][(crc>>16) & 0xff]^crcShift[3][crc>>24];
+
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware (uint32_t crc, const unsigned char *p, size_t size) {
+
+	uint64_t c=crc, c1, c2;
+	uint64_t word, word1, word2;
+	size_t i;
+
+	while(size>=3*SM_CRC_LANE)
+	{
+		c1=0;
+		c2=0;
+
+		for(i=0; i<SM_CRC_LANE; i+=8)
+		{
+			memcpy(&word, p+i, 8);
+			memcpy(&word1, p+SM_CRC_LANE+i, 8);
+			memcpy(&word2, p+2*SM_CRC_LANE+i, 8);
+			c=__builtin_ia32_crc32di(c, word);
+			c1=__builtin_ia32_crc32di(c1, word1);
+			c2=__builtin_ia32_crc32di(c2, word2);
+		}
+
+		c=shiftLane(shiftLane((uint32_t)c)^(uint32_t)c1)^(uint32_t)c2;
+		p+=3*SM_CRC_LANE;
+		size-=3*SM_CRC_LANE;
+	}
+
+	while(size>=8)
+	{
+		memcpy(&word, p, 8);
+		c=__builtin_ia32_crc32di(c, word);
+		p+=8;
+		size-=8;
+	}
+
+	while(size--)
+	{
+		c=__builtin_ia32_crc32qi((uint32_t)c, *p++);
+	}
+
+	return (uint32_t)c;
+
+}
+#endif
+
+static uint32_t crc32c (uint32_t crc, const void *data, size_t size) {
+
+	const unsigned char *p=data;
+
+	pthread_once(&crcOnce, crcInit);
+
+	crc=~crc;
+
+#if defined(__x86_64__)
+	if(crcHardware)
+	{
+		return ~crc32cHardware(crc, p, size);
+	}
+#endif
+
+	while(size--)
+	{
+		crc=(crc>>8)^crcTable[(crc^*p++) & 0xff];
+	}
+
+	return ~crc;
+
+}
+
+/* fill a META_SIZE header block with the superblock of a file of numPages pages */
+static void fillHeader (char *meta, int numPages, uint32_t features) {
+
+	SM_Superblock sb;
+
+	memset(&sb, 0, sizeof(sb));
+	memcpy(sb.magic, SM_MAGIC, sizeof(SM_MAGIC));
+	sb.version=SM_FORMAT_VERSION;
+	sb.pageSize=PAGE_SIZE;
+	sb.numPages=numPages;
+	sb.freeListHead=-1;
+	sb.numFreePages=0;
+	sb.features=features;
+	sb.checksum=crc32c(0, &sb, sizeof(sb));
+
+	memset(meta, '\0', META_SIZE);
+	memcpy(meta, &sb, sizeof(sb));
+
+}
+
+/* the number of pages in a header block, -1 if it is damaged or of a format this code cannot read, and its features. A
+file written before the superblock has the number of pages as a decimal string in the first 50 bytes, it is still read
+and gets a superblock with the next header update. */
+static int parseHeader (const char *meta, uint32_t *features) {
+
+	SM_Superblock sb;
+	uint32_t checksum;
+	char str[50];
+	int i;
+
+	memcpy(&sb, meta, sizeof(sb));
+
+	if(memcmp(sb.magic, SM_MAGIC, sizeof(SM_MAGIC))!=0)
+	{
+		memcpy(str, meta, sizeof(str));
+
+		for(i=0; i<(int)sizeof(str) && str[i]>='0' && str[i]<='9'; i++);
+
+		if(i==0 || i==(int)sizeof(str) || str[i]!='\0')
+		{
+			return -1;
+		}
+		*features=0;
+		return atoi(str);
+	}
+
+	checksum=sb.checksum;
+	sb.checksum=0;
+
+	if(crc32c(0, &sb, sizeof(sb))!=checksum || sb.version>SM_FORMAT_VERSION || sb.pageSize!=PAGE_SIZE
+		|| (sb.features & ~SM_KNOWN_FEATURES)!=0 || sb.numPages>INT_MAX)
+	{
+		return -1;
+	}
+
+	*features=sb.features;
+	return (int)sb.numPages;
+
+}
+
+/*
+	Page compression, LZ77 in the style of LZ4. A compressed page is a list of sequences: a token byte with the number
+	of literals in its high 4 bits and the match length minus SM_MIN_MATCH in its low 4 bits (15 means more length bytes
+	follow, up to the first one that is not 255), the literals, and the 2 byte offset of the match back into the page.
+	The last sequence has literals only.
+	1, the compressor finds matches with a hash table of the last position of every 4 byte prefix. The longer it finds
+	none the larger steps it takes, so it gives up on data that does not compress quickly.
+	2, the decompressor checks every length against both buffers, a damaged page fails instead of overrunning them.
+*/
+static uint32_t read32 (const unsigned char *p) {
+
+	uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+
+}
+
+/* the extra bytes of a length of 15 or more, returns the new output position or -1 if they do not fit */
+static int putLength (unsigned char *dst, int op, int capacity, int length) {
+
+	for(length-=15; length>=255; length-=255)
+	{
+		if(op>=capacity)
+		{
+			return -1;
+		}
+		dst[op++]=255;
+	}
+
+	if(op>=capacity)
+	{
+		return -1;
+	}
+	dst[op++]=(unsigned char)length;
+
+	return op;
+
+}
+
+/* append a sequence of numLiterals literals and a match of length bytes at offset (length 0 for none), returns the new
+output position or -1 if it does not fit */
+static int putSequence (unsigned char *dst, int op, int capacity, const unsigned char *literals, int numLiterals,
+	int offset, int length) {
+
+	int token=op++;
+
+	if(token>=capacity)
+	{
+		return -1;
+	}
+
+	dst[token]=(unsigned char)((numLiterals<15 ? numLiterals : 15)<<4);
+	if(numLiterals>=15 && (op=putLength(dst, op, capacity, numLiterals))<0)
+	{
+		return -1;
+	}
+
+	if(op+numLiterals>capacity)
+	{
+		return -1;
+	}
+	memcpy(dst+op, literals, numLiterals);
+	op+=numLiterals;
+
+	if(length==0)
+	{
+		return op;
+	}
+
+	if(op+2>capacity)
+	{
+		return -1;
+	}
+	dst[op++]=(unsigned char)(offset & 0xff);
+	dst[op++]=(unsigned char)(offset>>8);
+
+	length-=SM_MIN_MATCH;
+	dst[token]|=(unsigned char)(length<15 ? length : 15);
+
+	return (length>=15) ? putLength(dst, op, capacity, length) : op;
+
+}
+
+/* compress a page into at most capacity bytes, returns the compressed size or -1 if it does not fit */
+static int compressPage (const unsigned char *src, unsigned char *dst, int capacity) {
+
+	int table[1<<SM_HASH_BITS];
+	int ip=0, anchor=0, op=0, misses=0;
+	int candidate, length;
+	uint32_t hash;
+
+	memset(table, 0xff, sizeof(table));
+
+	while(ip+SM_MIN_MATCH<=PAGE_SIZE)
+	{
+		hash=(read32(src+ip)*2654435761u)>>(32-SM_HASH_BITS);
+		candidate=table[hash];
+		table[hash]=ip;
+
+		if(candidate<0 || read32(src+candidate)!=read32(src+ip))
+		{
+			ip+=1+(misses++>>6);
+			continue;
+		}
+
+		for(length=SM_MIN_MATCH; ip+length<PAGE_SIZE && src[candidate+length]==src[ip+length]; length++);
+
+		if((op=putSequence(dst, op, capacity, src+anchor, ip-anchor, ip-candidate, length))<0)
+		{
+			return -1;
+		}
+
+		ip+=length;
+		anchor=ip;
+		misses=0;
+	}
+
+	return putSequence(dst, op, capacity, src+anchor, PAGE_SIZE-anchor, 0, 0);
+
+}
+
+/* a length of a token, with its extra bytes from src[*ip] on, -1 if they run past size */
+static int getLength (const unsigned char *src, int *ip, int size, int length) {
+
+	int extra;
+
+	if(length<15)
+	{
+		return length;
+	}
+
+	do
+	{
+		if(*ip>=size)
+		{
+			return -1;
+		}
+		extra=src[(*ip)++];
+		length+=extra;
+	} while(extra==255);
+
+	return length;
+
+}
+
+/* decompress size bytes into a page, returns -1 if they are not a valid compressed page */
+static int decompressPage (const unsigned char *src, int size, unsigned char *dst) {
+
+	int ip=0, op=0, length, offset;
+	unsigned char token;
+
+	while(ip<size)
+	{
+		token=src[ip++];
+
+		if((length=getLength(src, &ip, size, token>>4))<0 || ip+length>size || op+length>PAGE_SIZE)
+		{
+			return -1;
+		}
+		memcpy(dst+op, src+ip, length);
+		ip+=length;
+		op+=length;
+
+		if(ip==size)
+		{
+			break;
+		}
+
+		if(ip+2>size)
+		{
+			return -1;
+		}
+		offset=src[ip] | (src[ip+1]<<8);
+		ip+=2;
+
+		if((length=getLength(src, &ip, size, token & 15))<0)
+		{
+			return -1;
+		}
+		length+=SM_MIN_MATCH;
+
+		if(offset==0 || offset>op || op+length>PAGE_SIZE)
+		{
+			return -1;
+		}
+
+		//a match may overlap the bytes it produces, a run of one byte has offset 1
+		if(offset>=length)
+		{
+			memcpy(dst+op, dst+op-offset, length);
+			op+=length;
+		}
+		else
+		{
+			for(; length>0; length--, op++)
+			{
+				dst[op]=dst[op-offset];
+			}
+		}
+	}
+
+	return (op==PAGE_SIZE) ? 0 : -1;
+
+}
+
+/* true if a page is all zeroes */
+static int isZeroPage (const unsigned char *page) {
+
+	uint64_t word, bits=0;
+	int i;
+
+	for(i=0; i<PAGE_SIZE; i+=sizeof(word))
+	{
+		memcpy(&word, page+i, sizeof(word));
+		bits|=word;
+	}
+
+	return bits==0;
+
+}
+
+/* pread and pwrite may transfer less than asked for, or be interrupted by a signal. These loop until all size
+bytes are transferred, and return -1 on an error or (for reads) at the end of the file. */
+static int preadFull (int fd, char *buf, size_t size, off_t offset) {
+
+	while(size>0)
+	{
+		ssize_t n=pread(fd, buf, size, offset);
+
+		if(n<0 && errno==EINTR)
+		{
+			continue;
+		}
+		if(n<=0)
+		{
+			return -1;
+		}
+
+		buf+=n;
+		size-=n;
+		offset+=n;
+	}
+
+	return 0;
+
+}
+
+static int pwriteFull (int fd, const char *buf, size_t size, off_t offset) {
+
+	while(size>0)
+	{
+		ssize_t n=pwrite(fd, buf, size, offset);
+
+		if(n<0 && errno==EINTR)
+		{
+			continue;
+		}
+		if(n<=0)
+		{
+			return -1;
+		}
+
+		buf+=n;
+		size-=n;
+		offset+=n;
+	}
+
+	return 0;
+
+}
+
+/* pwritev of a whole vector, like pwriteFull. A partial write moves the vector forward past the bytes written. */
+static int pwritevFull (int fd, struct iovec *iov, int count, off_t offset) {
+
+	while(count>0)
+	{
+		ssize_t n=pwritev(fd, iov, count, offset);
+
+		if(n<0 && errno==EINTR)
+		{
+			continue;
+		}
+		if(n<=0)
+		{
+			return -1;
+		}
+
+		offset+=n;
+
+		while(count>0 && (size_t)n>=iov->iov_len)
+		{
+			n-=iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		if(count>0)
+		{
+			iov->iov_base=(char *)iov->iov_base+n;
+			iov->iov_len-=n;
+		}
+	}
+
+	return 0;
+
+}
+
+/* the file system rejected an O_DIRECT transfer, the file uses buffered I/O from now on */
+static void dropDirect (SM_mgmtInfo *info) {
+
+	fcntl(info->fd, F_SETFL, fcntl(info->fd, F_GETFL) & ~O_DIRECT);
+	__atomic_and_fetch(&info->flags, ~SM_OPEN_DIRECT, __ATOMIC_RELAXED);
+
+}
+
+/* block I/O of a mapped file is a copy from or into the mapping. Writes only dirty the mapping, every SM_MSYNC_BATCH
+writes the kernel is asked to start writing them back. syncPageFile waits until they are on disk. */
+static int mapTransfer (SM_mgmtInfo *info, char *buf, size_t size, off_t offset, int isWrite) {
+
+	int ret=0;
+
+	pthread_rwlock_rdlock(&info->mapLatch);
+
+	if((size_t)offset+size>info->mapSize)
+	{
+		ret=-1;
+	}
+	else if(isWrite)
+	{
+		memcpy(info->map+offset, buf, size);
+
+		if(__atomic_add_fetch(&info->unsynced, 1, __ATOMIC_RELAXED)>=SM_MSYNC_BATCH)
+		{
+			__atomic_store_n(&info->unsynced, 0, __ATOMIC_RELAXED);
+			msync(info->map, info->mapSize, MS_ASYNC);
+		}
+	}
+	else
+	{
+		memcpy(buf, info->map+offset, size);
+	}
+
+	pthread_rwlock_unlock(&info->mapLatch);
+
+	return ret;
+
+}
+
+/* grow a mapped file to numPages pages: ftruncate extends the file with zeroes, mremap extends the mapping (moving it
+if it cannot grow in place), then the new number of pages goes into the meta data */
+static int growMapping (SM_mgmtInfo *info, int numPages) {
+
+	size_t size=(size_t)fileSize(info, numPages);
+	char *map;
+	int ret=0;
+
+	pthread_rwlock_wrlock(&info->mapLatch);
+
+	if(ftruncate(info->fd, size)!=0)
+	{
+		ret=-1;
+	}
+	else if((map=mremap(info->map, info->mapSize, size, MREMAP_MAYMOVE))==MAP_FAILED)
+	{
+		ret=-1;
+	}
+	else
+	{
+		info->map=map;
+		info->mapSize=size;
+
+		fillHeader(map, numPages, info->checksums ? SM_FEATURE_CHECKSUMS : 0);
+	}
+
+	pthread_rwlock_unlock(&info->mapLatch);
+
+	return ret;
+
+}
+
+/* pread or pwrite a whole buffer through the file handle.
+	1, in direct mode a buffer that is not aligned goes through an aligned bounce buffer.
+	2, some file systems accept O_DIRECT at open but reject the transfers with EINVAL. Then the file falls back to buffered
+	I/O for good and the transfer is repeated.
+*/
+static int transfer (SM_mgmtInfo *info, char *buf, size_t size, off_t offset, int isWrite) {
+
+	char *bounce=NULL;
+	char *data=buf;
+	int ret;
+
+	if(info->flags & SM_OPEN_MMAP)
+	{
+		return mapTransfer(info, buf, size, offset, isWrite);
+	}
+
+	if((info->flags & SM_OPEN_DIRECT) && ((size_t)buf % SM_DIRECT_ALIGN)!=0)
+	{
+		if(posix_memalign((void **)&bounce, SM_DIRECT_ALIGN, size)!=0)
+		{
+			return -1;
+		}
+		if(isWrite)
+		{
+			memcpy(bounce, buf, size);
+		}
+		data=bounce;
+	}
+
+	errno=0;
+	ret=isWrite ? pwriteFull(info->fd, data, size, offset) : preadFull(info->fd, data, size, offset);
+
+	if(ret!=0 && errno==EINVAL && (info->flags & SM_OPEN_DIRECT))
+	{
+		dropDirect(info);
+
+		ret=isWrite ? pwriteFull(info->fd, data, size, offset) : preadFull(info->fd, data, size, offset);
+	}
+
+	if(bounce!=NULL)
+	{
+		if(!isWrite && ret==0)
+		{
+			memcpy(buf, bounce, size);
+		}
+		free(bounce);
+	}
+
+	return ret;
+
+}
+
+/*
+	Page checksums.
+	1, the checksum of a page is stamped after the page has been written: it is computed before sumLatch is taken, set
+	in sums and its checksum block marked as changed, SM_SUM_BATCH pages at a time.
+	2, the checksum block is written right after the pages, so the file on disk matches its checksums without a sync
+	and a crash only leaves a stale checksum for a write it interrupted, like a torn page. A run of writeBlocks() stays
+	inside one checksum block, so it costs one more write per run. A block whose write fails stays marked as changed,
+	syncPageFile() and closePageFile() write it again, and the write of the pages reports the failure.
+	3, a checksum of 0 means the page has never been written (a new page reads as zeroes), it is not checked.
+	4, the checksums of all pages are kept in memory, so a read only costs computing the checksum of the page read.
+*/
+#define SM_SUM_BATCH 64
+
+static int writeSumGroups (SM_mgmtInfo *info, int firstGroup, int lastGroup);
+
+static int storeSums (SM_mgmtInfo *info, int firstPage, int numPages, SM_PageHandle *memPages) {
+
+	uint32_t sums[SM_SUM_BATCH];
+	int i, n, done;
+
+	if(!info->checksums || numPages==0)
+	{
+		return 0;
+	}
+
+	for(done=0; done<numPages; done+=n)
+	{
+		n=(numPages-done < SM_SUM_BATCH) ? numPages-done : SM_SUM_BATCH;
+
+		for(i=0; i<n; i++)
+		{
+			sums[i]=crc32c(0, memPages[done+i], PAGE_SIZE);
+		}
+
+		pthread_rwlock_wrlock(&info->sumLatch);
+
+		for(i=0; i<n; i++)
+		{
+			info->sums[firstPage+done+i]=sums[i];
+			info->sumDirty[(firstPage+done+i)/SM_SUM_GROUP]=1;
+		}
+
+		pthread_rwlock_unlock(&info->sumLatch);
+	}
+
+	return writeSumGroups(info, firstPage/SM_SUM_GROUP, (firstPage+numPages-1)/SM_SUM_GROUP);
+
+}
+
+/* write the checksum blocks from firstGroup to lastGroup that changed. A block another writer already wrote with
+our checksums in it is skipped, one that fails stays marked. */
+static int writeSumGroups (SM_mgmtInfo *info, int firstGroup, int lastGroup) {
+
+	int group, ret=0;
+
+	pthread_rwlock_wrlock(&info->sumLatch);
+
+	for(group=firstGroup; group<=lastGroup && ret==0; group++)
+	{
+		if(info->sumDirty[group])
+		{
+			ret=transfer(info, (char *)(info->sums+group*SM_SUM_GROUP), PAGE_SIZE, sumOffset(group), 1);
+			info->sumDirty[group]=(ret!=0);
+		}
+	}
+
+	pthread_rwlock_unlock(&info->sumLatch);
+
+	return ret;
+
+}
+
+/* write the checksum blocks a failed write left behind, before a sync or a close */
+static int writeSums (SM_mgmtInfo *info) {
+
+	if(!info->checksums)
+	{
+		return 0;
+	}
+
+	return writeSumGroups(info, 0, info->sumCapacity/SM_SUM_GROUP-1);
+
+}
+
+static RC checkSum (SM_mgmtInfo *info, int pageNum, SM_PageHandle memPage) {
+
+	uint32_t expected;
+
+	if(!info->checksums)
+	{
+		return RC_OK;
+	}
+
+	pthread_rwlock_rdlock(&info->sumLatch);
+	expected=info->sums[pageNum];
+	pthread_rwlock_unlock(&info->sumLatch);
+
+	if(expected!=0 && crc32c(0, memPage, PAGE_SIZE)!=expected)
+	{
+		return RC_CHECKSUM_MISMATCH;
+	}
+
+	return RC_OK;
+
+}
+
+/* make room for the checksums of numPages pages, doubling sums so a growing file copies it only a few times. If the
+memory is not there sums stays as it was and -1 is returned. */
+static int growSums (SM_mgmtInfo *info, int numPages) {
+
+	uint32_t *sums;
+	char *sumDirty;
+	int capacity=info->sumCapacity*2;
+
+	if(!info->checksums || numPages<=info->sumCapacity)
+	{
+		return 0;
+	}
+
+	if(capacity<numPages)
+	{
+		capacity=numPages;
+	}
+	capacity=(capacity+SM_SUM_GROUP-1)/SM_SUM_GROUP*SM_SUM_GROUP;
 
-/* module wide constants */
-#define META_SIZE 4096
+	if(posix_memalign((void **)&sums, SM_DIRECT_ALIGN, sizeof(uint32_t)*capacity)!=0)
+	{
+		return -1;
+	}
+	sumDirty=calloc(capacity/SM_SUM_GROUP, 1);
+	if(sumDirty==NULL)
+	{
+		free(sums);
+		return -1;
+	}
+	memset(sums, 0, sizeof(uint32_t)*capacity);
 
-/************************************************************
- *                    handle data structures                *
- ************************************************************/
-typedef struct SM_FileHandle {
-  char *fileName;
-  int totalNumPages;
-  int curPagePos;
-  void *mgmtInfo;
-} SM_FileHandle;
+	pthread_rwlock_wrlock(&info->sumLatch);
+	memcpy(sums, info->sums, sizeof(uint32_t)*info->sumCapacity);
+	memcpy(sumDirty, info->sumDirty, info->sumCapacity/SM_SUM_GROUP);
+	free(info->sums);
+	free(info->sumDirty);
+	info->sums=sums;
+	info->sumDirty=sumDirty;
+	info->sumCapacity=capacity;
+	pthread_rwlock_unlock(&info->sumLatch);
 
-/* create a new structure to hold the pointer to a FILE object*/
-typedef struct SM_mgmtInfo {
+	return 0;
 
-	FILE *fp;
+}
 
-} SM_mgmtInfo;
+/* byte offset of a slot unit of a compressed file */
+static off_t unitOffset (uint32_t unit) {
 
-typedef char* SM_PageHandle;
+	return (off_t)META_SIZE+(off_t)unit*SM_SLOT_UNIT;
+
+}
+
+/* a slot of class cls, a free one or a new one at the end of the file, slotLatch held exclusively */
+static uint32_t allocSlot (SM_mgmtInfo *info, int cls) {
+
+	SM_FreeSlots *list=&info->freeSlots[cls];
+	uint32_t unit;
+
+	if(list->count>0)
+	{
+		return list->units[--list->count];
+	}
+
+	unit=info->endUnit;
+	info->endUnit+=cls;
+
+	return unit;
+
+}
+
+/* give a slot back, slotLatch held exclusively */
+static void freeSlot (SM_mgmtInfo *info, int cls, uint32_t unit) {
+
+	SM_FreeSlots *list=&info->freeSlots[cls];
+
+	if(list->count==list->capacity)
+	{
+		list->capacity=(list->capacity==0) ? 64 : 2*list->capacity;
+		list->units=(uint32_t *)realloc(list->units, sizeof(uint32_t)*list->capacity);
+	}
+
+	list->units[list->count++]=unit;
+
+}
+
+/* the free units from first to end become free slots, of SM_SLOT_CLASSES units and one smaller for the rest */
+static void freeUnits (SM_mgmtInfo *info, uint32_t first, uint32_t end) {
+
+	for(; end-first>=SM_SLOT_CLASSES; first+=SM_SLOT_CLASSES)
+	{
+		freeSlot(info, SM_SLOT_CLASSES, first);
+	}
+
+	if(first<end)
+	{
+		freeSlot(info, end-first, first);
+	}
+
+}
+
+static int compareUnits (const void *a, const void *b) {
+
+	uint64_t x=*(const uint64_t *)a, y=*(const uint64_t *)b;
+
+	return (x>y)-(x<y);
+
+}
+
+/*
+	Load the map of a compressed file of numPages pages, the units of its map blocks are in the header meta.
+	1, the slots in use, of the map blocks and the pages, are sorted by their first unit. The units between them are
+	free, so are the units past the last one up to the end of the file (written just before a crash, the map never got
+	to point at them).
+	2, returns -1 if the map is damaged: an unknown class, or slots that overlap.
+*/
+static int loadSlots (SM_mgmtInfo *info, const char *meta, int numPages) {
+
+	int groups=(numPages+SM_MAP_GROUP-1)/SM_MAP_GROUP;
+	uint64_t *used;
+	uint32_t end=0;
+	int i, numUsed=0, failed=0;
+	struct stat st;
+
+	if(groups>SM_MAP_DIR_MAX)
+	{
+		return -1;
+	}
+
+	memcpy(info->mapUnits, meta+SM_MAP_DIR_OFFSET, sizeof(uint32_t)*groups);
+	info->numMapBlocks=groups;
+	info->slotCapacity=groups*SM_MAP_GROUP;
+	info->slots=(uint32_t *)malloc(sizeof(uint32_t)*info->slotCapacity);
+
+	for(i=0; i<groups && !failed; i++)
+	{
+		failed=transfer(info, (char *)(info->slots+i*SM_MAP_GROUP), PAGE_SIZE, unitOffset(info->mapUnits[i]), 0);
+	}
+
+	used=(uint64_t *)malloc(sizeof(uint64_t)*(groups+info->slotCapacity));
+
+	for(i=0; i<groups; i++)
+	{
+		used[numUsed++]=(uint64_t)info->mapUnits[i]<<4 | SM_SLOT_CLASSES;
+	}
+	for(i=0; i<info->slotCapacity && !failed; i++)
+	{
+		if(SM_SLOT_CLASS(info->slots[i])>SM_SLOT_CLASSES)
+		{
+			failed=1;
+		}
+		else if(SM_SLOT_CLASS(info->slots[i])>0)
+		{
+			used[numUsed++]=(uint64_t)SM_SLOT_FIRST(info->slots[i])<<4 | SM_SLOT_CLASS(info->slots[i]);
+		}
+	}
+
+	qsort(used, numUsed, sizeof(uint64_t), compareUnits);
+
+	for(i=0; i<numUsed && !failed; i++)
+	{
+		if((used[i]>>4)<end)
+		{
+			failed=1;
+		}
+		else
+		{
+			freeUnits(info, end, used[i]>>4);
+			end=(used[i]>>4)+(used[i] & 15);
+		}
+	}
+
+	free(used);
+
+	if(!failed && fstat(info->fd, &st)==0 && st.st_size>META_SIZE)
+	{
+		uint32_t fileEnd=(st.st_size-META_SIZE+SM_SLOT_UNIT-1)/SM_SLOT_UNIT;
+
+		if(fileEnd>end)
+		{
+			freeUnits(info, end, fileEnd);
+			end=fileEnd;
+		}
+	}
+	info->endUnit=end;
+
+	return failed ? -1 : 0;
+
+}
+
+/* free the map and the free slots of a compressed file */
+static void freeSlots (SM_mgmtInfo *info) {
+
+	int cls;
+
+	for(cls=1; cls<=SM_SLOT_CLASSES; cls++)
+	{
+		free(info->freeSlots[cls].units);
+	}
+	free(info->slots);
+	pthread_rwlock_destroy(&info->slotLatch);
+
+}
+
+/* make room in the map of a compressed file for numPages pages, every SM_MAP_GROUP of them get a new map block of zeroes
+(no page has a slot yet) */
+static int growSlots (SM_mgmtInfo *info, int numPages) {
+
+	int groups=(numPages+SM_MAP_GROUP-1)/SM_MAP_GROUP;
+	int capacity=info->slotCapacity*2;
+	uint32_t unit;
+	int ret=0;
+
+	if(groups>SM_MAP_DIR_MAX)
+	{
+		return -1;
+	}
+
+	pthread_rwlock_wrlock(&info->slotLatch);
+
+	if(groups*SM_MAP_GROUP>info->slotCapacity)
+	{
+		if(capacity<groups*SM_MAP_GROUP)
+		{
+			capacity=groups*SM_MAP_GROUP;
+		}
+		info->slots=(uint32_t *)realloc(info->slots, sizeof(uint32_t)*capacity);
+		memset(info->slots+info->slotCapacity, 0, sizeof(uint32_t)*(capacity-info->slotCapacity));
+		info->slotCapacity=capacity;
+	}
+
+	while(info->numMapBlocks<groups && ret==0)
+	{
+		unit=allocSlot(info, SM_SLOT_CLASSES);
+		ret=transfer(info, (char *)(info->slots+info->numMapBlocks*SM_MAP_GROUP), PAGE_SIZE, unitOffset(unit), 1);
+
+		if(ret==0)
+		{
+			info->mapUnits[info->numMapBlocks++]=unit;
+		}
+		else
+		{
+			freeSlot(info, SM_SLOT_CLASSES, unit);
+		}
+	}
+
+	pthread_rwlock_unlock(&info->slotLatch);
+
+	return ret;
+
+}
+
+/*
+	Write pages of a compressed file, memPages[i] holds page firstPage+i.
+	1, a page of zeroes gets no slot at all, a page that does not compress into less than SM_SLOT_CLASSES units is
+	stored as it is. A compressed page is its 2 byte size followed by its sequences.
+	2, a page that needs a slot of the same class as before is written in place, otherwise it gets a new slot. An
+	in-place rewrite is not crash safe: a crash during it can leave a torn page, like a torn write of an uncompressed
+	page. A torn slot that no longer decompresses reads as RC_CHECKSUM_MISMATCH, other damage goes unnoticed.
+	3, once all pages are written, the map blocks that changed are written and only then the old slots become free. A
+	crash in between leaves the map on disk pointing at the old slots, which were not overwritten, so pages that moved
+	to a new slot read as they were before.
+	A page must not be written by several threads at once, just like with the other formats.
+*/
+static int writeCompressed (SM_mgmtInfo *info, int firstPage, int numPages, SM_PageHandle *memPages) {
+
+	uint32_t *old=(uint32_t *)malloc(sizeof(uint32_t)*2*numPages);
+	uint32_t *new=old+numPages;
+	unsigned char slot[PAGE_SIZE];
+	const unsigned char *data;
+	int i, cls, size, group, lastGroup=-1, ret=0;
+
+	for(i=0; i<numPages && ret==0; i++)
+	{
+		data=(unsigned char *)memPages[i];
+
+		if(isZeroPage(data))
+		{
+			cls=0;
+		}
+		else if((size=compressPage(data, slot+2, (SM_SLOT_CLASSES-1)*SM_SLOT_UNIT-2))<0)
+		{
+			cls=SM_SLOT_CLASSES;
+		}
+		else
+		{
+			cls=(size+2+SM_SLOT_UNIT-1)/SM_SLOT_UNIT;
+			slot[0]=(unsigned char)(size & 0xff);
+			slot[1]=(unsigned char)(size>>8);
+			memset(slot+2+size, 0, cls*SM_SLOT_UNIT-2-size);
+			data=slot;
+		}
+
+		pthread_rwlock_wrlock(&info->slotLatch);
+		old[i]=info->slots[firstPage+i];
+		new[i]=(cls==SM_SLOT_CLASS(old[i]) || cls==0) ? SM_SLOT(cls, cls ? SM_SLOT_FIRST(old[i]) : 0)
+			: SM_SLOT(cls, allocSlot(info, cls));
+		pthread_rwlock_unlock(&info->slotLatch);
+
+		if(cls>0)
+		{
+			ret=transfer(info, (char *)data, cls*SM_SLOT_UNIT, unitOffset(SM_SLOT_FIRST(new[i])), 1);
+		}
+	}
+
+	pthread_rwlock_wrlock(&info->slotLatch);
+
+	if(ret!=0)
+	{
+		//the new slots of the pages done so far are given back, the map stays as it was
+		for(numPages=i, i=0; i<numPages; i++)
+		{
+			if(new[i]!=old[i] && SM_SLOT_CLASS(new[i])>0)
+			{
+				freeSlot(info, SM_SLOT_CLASS(new[i]), SM_SLOT_FIRST(new[i]));
+			}
+		}
+	}
+	else
+	{
+		for(i=0; i<numPages; i++)
+		{
+			info->slots[firstPage+i]=new[i];
+		}
+
+		for(i=0; i<numPages && ret==0; i++)
+		{
+			group=(firstPage+i)/SM_MAP_GROUP;
+
+			if(new[i]!=old[i] && group!=lastGroup)
+			{
+				ret=transfer(info, (char *)(info->slots+group*SM_MAP_GROUP), PAGE_SIZE, unitOffset(info->mapUnits[group]),
+					1);
+				lastGroup=group;
+			}
+		}
+
+		//if the map could not be written it may still point at the old slots, they are not reused then
+		for(i=0; i<numPages && ret==0; i++)
+		{
+			if(new[i]!=old[i] && SM_SLOT_CLASS(old[i])>0)
+			{
+				freeSlot(info, SM_SLOT_CLASS(old[i]), SM_SLOT_FIRST(old[i]));
+			}
+		}
+	}
+
+	pthread_rwlock_unlock(&info->slotLatch);
+
+	free(old);
+
+	return ret;
+
+}
+
+/* read a page of a compressed file. A slot that does not decompress into a page is damaged. */
+static RC readCompressed (SM_mgmtInfo *info, int pageNum, SM_PageHandle memPage) {
+
+	unsigned char slot[PAGE_SIZE];
+	uint32_t entry;
+	int cls, size;
+
+	pthread_rwlock_rdlock(&info->slotLatch);
+	entry=info->slots[pageNum];
+	pthread_rwlock_unlock(&info->slotLatch);
+
+	cls=SM_SLOT_CLASS(entry);
+
+	if(cls==0)
+	{
+		memset(memPage, 0, PAGE_SIZE);
+		return RC_OK;
+	}
+
+	if(cls==SM_SLOT_CLASSES)
+	{
+		return (transfer(info, memPage, PAGE_SIZE, unitOffset(SM_SLOT_FIRST(entry)), 0)!=0) ? RC_READ_NON_EXISTING_PAGE
+			: RC_OK;
+	}
+
+	if(transfer(info, (char *)slot, cls*SM_SLOT_UNIT, unitOffset(SM_SLOT_FIRST(entry)), 0)!=0)
+	{
+		return RC_READ_NON_EXISTING_PAGE;
+	}
+
+	size=slot[0] | (slot[1]<<8);
+
+	if(size+2>cls*SM_SLOT_UNIT || decompressPage(slot+2, size, (unsigned char *)memPage)!=0)
+	{
+		return RC_CHECKSUM_MISMATCH;
+	}
+
+	return RC_OK;
+
+}
+
+/* read a page and check it against its checksum, or decompress it */
+static RC readPage (SM_mgmtInfo *info, int pageNum, SM_PageHandle memPage, int verify) {
+
+	if(info->compressed)
+	{
+		return readCompressed(info, pageNum, memPage);
+	}
+
+	if(transfer(info, memPage, PAGE_SIZE, pageOffset(info, pageNum), 0)!=0)
+	{
+		return RC_READ_NON_EXISTING_PAGE;
+	}
+
+	return verify ? checkSum(info, pageNum, memPage) : RC_OK;
+
+}
+
+/* the number of pages may grow while other threads read, so it is read and written atomically */
+static int loadTotalPages (SM_FileHandle *fHandle) {
+
+	return __atomic_load_n(&fHandle->totalNumPages, __ATOMIC_ACQUIRE);
+
+}
 
 /************************************************************
  *                    interface                             *
@@ -36,140 +1425,356 @@ void initStorageManager (void) {
 	return;
 }
 
-	/* 1, create a block in memory, containing the size of meta data and 1 page. In this case
-	we only put the information of number of pages into meta data section.
+	/* 1, create a block in memory, containing the size of meta data and 1 page.
 
 	   2, set the content of this area in memory to be 0.
 
-	   3, set the first 50 bytes to be the area exclusively containing the information of number of pages. The
-	number of pages in this case is 1. So we store "1" as a string in this 50 bytes area.
+	   3, put the superblock of a file with 1 page at the start of the meta data. A file with checksums also gets the
+	(empty) checksum block of its first pages, in front of page 0. A compressed file gets the (empty) map block of its
+	first pages instead of page 0, at unit 0, page 0 is a page of zeroes without a slot.
 
-	   4, we write this memory block into harddirve with fwrite(), with target area fp, where fp points to the 
+	   4, we write this memory block into harddirve with write(), with target fd, where fd is the 
 	file that we've created just now.
 
-	   5, at last, we free the memory and the memory we've used and close the FILE pointer.
+	   5, at last, we free the memory and the memory we've used and close the file descriptor.
 	*/
 
+RC createPageFileWithFlags (char *fileName, int flags);
+
 RC createPageFile (char *fileName) {
+
+	return createPageFileWithFlags(fileName, 0);
+
+}
+
+/* flags is a combination of SM_CREATE_ flags, SM_CREATE_CHECKSUMS makes a file that keeps a checksum of every page,
+SM_CREATE_COMPRESSED one that stores its pages compressed. A compressed file cannot have checksums. */
+RC createPageFileWithFlags (char *fileName, int flags) {
 	
-	//declare a File object pointer
-	FILE *fp;
+	//declare a file descriptor
+	int fd;
+	int size=(flags & SM_CREATE_CHECKSUMS) ? META_SIZE+2*PAGE_SIZE : META_SIZE+PAGE_SIZE;
+	uint32_t features=((flags & SM_CREATE_CHECKSUMS) ? SM_FEATURE_CHECKSUMS : 0)
+		| ((flags & SM_CREATE_COMPRESSED) ? SM_FEATURE_COMPRESSED : 0);
+
+	if((flags & SM_CREATE_CHECKSUMS) && (flags & SM_CREATE_COMPRESSED))
+	{
+		return RC_WRITE_FAILED;
+	}
 	
-	//create a binary File object
-	fp=fopen(fileName, "ab+"); //when manipulating passing string by pointer, use the name directly
+	//create the file, like fopen(fileName, "ab+") did
+	fd=open(fileName, O_WRONLY|O_CREAT|O_APPEND, 0644); //when manipulating passing string by pointer, use the name directly
+	if(fd<0)
+	{
+		return RC_WRITE_FAILED;
+	}
 
 	//malloc memory
-	char *multipages=(char *)malloc(META_SIZE+PAGE_SIZE); // malloc returns void *
-	memset(multipages, '\0', META_SIZE+PAGE_SIZE);
+	char *multipages=(char *)malloc(size); // malloc returns void *
+	memset(multipages, '\0', size);
 	
-	//create a string, give it a value, and copy this string into memory
-	char str[50] = {'\0'};
-	strcpy(str, "1");
-	memcpy(multipages, str, 50);
+	//the superblock, the file has one page. The map block of a compressed file is at unit 0, the directory of map
+	//blocks after the superblock is already zero.
+	fillHeader(multipages, 1, features);
 	
-	//fwrite() 
-	fwrite(multipages, 1, META_SIZE+PAGE_SIZE, fp);
+	//write() 
+	int failed=(write(fd, multipages, size)!=size);
 	
 	//free memory
 	free(multipages);
 	
-	//close FILE pointer
-	fclose(fp);
+	//close the file descriptor
+	close(fd);
 	
 	//return code
-	return RC_OK;
+	return failed ? RC_WRITE_FAILED : RC_OK;
 
 }
 
 
 	/* 1, When openning a file, we only need to know the meta data secton from the area that stores the file.
 
-	   2, we open the file first, by fopen().
+	   2, we open the file first, by open().
 
 	   3, then malloc a piece of memory for the meta data stored in harddrive.
 
-	   4, then we read the meta data from hard drive to this piece of memory, with fread().
+	   4, then we read the meta data from hard drive to this piece of memory, with pread().
 
-	   5, because we've stored the number information in string format in harddrive,  we need to create a temperory string 
-	to hold the information when reading it back. So, we use memcpy() to copy this information from memory to this string. 
-	That is because at this point the informatio has already been read from HardDrive to memory.
+	   5, the number of pages comes from the superblock in the meta data.
 
-	   6, Then, we have to convert this information from str to integer.
+	   6, a superblock that is damaged, or of a newer format, makes the open fail.
 
 	   7, With this information, coping with filename, current page(default 0), we fill up the passed filehandle.
 
 	   8, however, we also need to fill the 'void *mgmtInfo'. To do that, we first create an object with SM_mgmtInfo. Then let
-	the item *fp inside this SM_mgmtInfo object point to fp which is the pointer to the file stored in harddrive.
+	the item fd inside this SM_mgmtInfo object hold fd which is the descriptor of the file stored in harddrive.
 
 	   9, at last, we let SM_mgmtInfo point to 'void *mgmtInfo' in the filehandle (struct SM_FileHandle).
 	*/
 
 
 
+RC openPageFileWithFlags (char *fileName, SM_FileHandle *fHandle, int flags);
+RC shutdownAsyncIO (SM_FileHandle *fHandle);
+
 /*we assume the object for this method is the result from createPageFile*/
 RC openPageFile (char *fileName, SM_FileHandle *fHandle) {
+
+	return openPageFileWithFlags(fileName, fHandle, 0);
+
+}
+
+/*
+	flags is a combination of SM_OPEN_ flags. With SM_OPEN_DIRECT the file is opened with O_DIRECT, if the file system
+	rejects that it is opened normally instead, getOpenFlags tells which one happened. SM_OPEN_MMAP maps the whole file,
+	it takes precedence over SM_OPEN_DIRECT and falls back to normal I/O if the file cannot be mapped.
+*/
+RC openPageFileWithFlags (char *fileName, SM_FileHandle *fHandle, int flags) {
 	
-	//declare a File object
-	FILE *fp;
+	//declare a file descriptor
+	int fd=-1;
+
+	if(flags & SM_OPEN_MMAP)
+	{
+		flags&=~SM_OPEN_DIRECT;
+	}
 	
-	//open a File object
-	fp=fopen(fileName, "r+");
-	if(fp==NULL)
+	//open the file for reading and writing
+	if(flags & SM_OPEN_DIRECT)
+	{
+		fd=open(fileName, O_RDWR|O_DIRECT);
+		if(fd<0 && errno==EINVAL)
+		{
+			flags&=~SM_OPEN_DIRECT;
+		}
+	}
+	if(!(flags & SM_OPEN_DIRECT))
+	{
+		fd=open(fileName, O_RDWR);
+	}
+	if(fd<0)
 	{
 		return RC_FILE_NOT_FOUND;
 	}
 	
-	//malloc memory 
-	char *metapage=(char *)malloc(META_SIZE);
+	//fill up the void *mgmtInfo
+	SM_mgmtInfo *mgmtInfomation=(SM_mgmtInfo *)malloc(sizeof(SM_mgmtInfo));
+
+	mgmtInfomation->fd=fd;
+	mgmtInfomation->flags=flags & ~SM_OPEN_MMAP;
+	mgmtInfomation->async=NULL;
+	mgmtInfomation->checksums=0;
+	mgmtInfomation->compressed=0;
+
+	//memory for the meta data, aligned for O_DIRECT
+	char *metapage;
+	if(posix_memalign((void **)&metapage, SM_DIRECT_ALIGN, META_SIZE)!=0)
+	{
+		free(mgmtInfomation);
+		close(fd);
+		return RC_FILE_HANDLE_NOT_INIT;
+	}
 	
 	//read meta data to the malloced memory
-	fread(metapage, 1, META_SIZE, fp);
-	
-	//create a string, read the information from memory to this string
-	char str[50] = {'\0'};
+	if(transfer(mgmtInfomation, metapage, META_SIZE, 0, 0)!=0)
+	{
+		free(metapage);
+		free(mgmtInfomation);
+		close(fd);
+		return RC_FILE_HANDLE_NOT_INIT;
+	}
 	
-	memcpy(str, metapage, 50);
+	//the number of pages from the superblock
+	uint32_t features;
+	int total=parseHeader(metapage, &features);
+
+	if(total<0)
+	{
+		free(metapage);
+		free(mgmtInfomation);
+		close(fd);
+		return RC_FILE_HANDLE_NOT_INIT;
+	}
+
+	//load the map of a compressed file. Its slots are not aligned to pages, so it is neither mapped nor read with O_DIRECT,
+	//and its size depends on how well the pages compress, so no disk space is reserved ahead.
+	if(features & SM_FEATURE_COMPRESSED)
+	{
+		if(mgmtInfomation->flags & SM_OPEN_DIRECT)
+		{
+			dropDirect(mgmtInfomation);
+		}
+		mgmtInfomation->flags&=~SM_OPEN_PREALLOC;
+		flags&=~(SM_OPEN_MMAP|SM_OPEN_PREALLOC);
+
+		mgmtInfomation->compressed=1;
+		memset(mgmtInfomation->freeSlots, 0, sizeof(mgmtInfomation->freeSlots));
+		pthread_rwlock_init(&mgmtInfomation->slotLatch, NULL);
+
+		if(loadSlots(mgmtInfomation, metapage, total)!=0)
+		{
+			freeSlots(mgmtInfomation);
+			free(metapage);
+			free(mgmtInfomation);
+			close(fd);
+			return RC_FILE_HANDLE_NOT_INIT;
+		}
+	}
+
+	free(metapage);
 
-	//convert it into int
-	int total = atoi(str);
+	//load the checksum blocks
+	if(features & SM_FEATURE_CHECKSUMS)
+	{
+		int group, failed=0;
+
+		mgmtInfomation->checksums=1;
+		mgmtInfomation->sums=NULL;
+		mgmtInfomation->sumDirty=NULL;
+		mgmtInfomation->sumCapacity=0;
+		pthread_rwlock_init(&mgmtInfomation->sumLatch, NULL);
+		failed=growSums(mgmtInfomation, total);
+
+		for(group=0; group*SM_SUM_GROUP<total && !failed; group++)
+		{
+			failed=transfer(mgmtInfomation, (char *)(mgmtInfomation->sums+group*SM_SUM_GROUP), PAGE_SIZE,
+				sumOffset(group), 0);
+		}
+
+		if(failed)
+		{
+			pthread_rwlock_destroy(&mgmtInfomation->sumLatch);
+			free(mgmtInfomation->sums);
+			free(mgmtInfomation->sumDirty);
+			free(mgmtInfomation);
+			close(fd);
+			return RC_FILE_HANDLE_NOT_INIT;
+		}
+	}
+
+	//map the file, now that the meta data has been read normally
+	if(flags & SM_OPEN_MMAP)
+	{
+		struct stat st;
+
+		mgmtInfomation->map=MAP_FAILED;
+		if(fstat(fd, &st)==0)
+		{
+			mgmtInfomation->mapSize=st.st_size;
+			mgmtInfomation->map=mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+
+		if(mgmtInfomation->map!=MAP_FAILED)
+		{
+			pthread_rwlock_init(&mgmtInfomation->mapLatch, NULL);
+			mgmtInfomation->unsynced=0;
+			mgmtInfomation->flags|=SM_OPEN_MMAP;
+		}
+	}
 	
+	mgmtInfomation->reservedPages=total;
+
 	//fill up the filehandle
 	fHandle->fileName=fileName;
 	fHandle->totalNumPages=total;
 	fHandle->curPagePos=0;
-
-	//fill up the void *mgmtInfo
-    SM_mgmtInfo *mgmtInfomation=(SM_mgmtInfo *)malloc(sizeof(SM_mgmtInfo));
-    	
-    mgmtInfomation->fp=fp;
-
 	fHandle->mgmtInfo=mgmtInfomation;
 	
 	return RC_OK;
 
 }
 
+/*
+	the SM_OPEN_ flags the file handle actually uses
+*/
+int getOpenFlags (SM_FileHandle *fHandle) {
+
+	SM_mgmtInfo *recieveInfo=fHandle->mgmtInfo;
+
+	return __atomic_load_n(&recieveInfo->flags, __ATOMIC_RELAXED);
+
+}
+
 /* 
 	Simply close the file:
 	1, Get the information from fHandle. Be careful, the fHandle object contains an SM_mgmInfo object, and the 
-	SM_mgmInfo object contains fp, which points to the FILE object that we need.
-	2, use fclose() function to close the File object.
+	SM_mgmInfo object contains fd, the file descriptor that we need.
+	2, the asynchronous I/O engine is stopped, the changed checksum blocks are written, and a mapped file is written
+	back and unmapped first.
+	3, use close() function to close the file, and free the SM_mgmtInfo object. If a checksum block could not be
+	written the file is closed all the same and RC_WRITE_FAILED returned.
 
 */
 RC closePageFile (SM_FileHandle *fHandle) {
 
 	//get the information from fHandle.
-	FILE *fp;
-
 	SM_mgmtInfo *recieveInfo;
 	recieveInfo=fHandle->mgmtInfo;
+	int failed;
 
-	fp=recieveInfo->fp;
+	if(recieveInfo->async!=NULL)
+	{
+		shutdownAsyncIO(fHandle);
+	}
 
-	//close the FILE object.
-	fclose(fp);
+	failed=writeSums(recieveInfo);
 
-	return RC_OK;
+	if(recieveInfo->flags & SM_OPEN_MMAP)
+	{
+		msync(recieveInfo->map, recieveInfo->mapSize, MS_SYNC);
+		munmap(recieveInfo->map, recieveInfo->mapSize);
+		pthread_rwlock_destroy(&recieveInfo->mapLatch);
+	}
+
+	//close the file.
+	close(recieveInfo->fd);
+
+	if(recieveInfo->checksums)
+	{
+		pthread_rwlock_destroy(&recieveInfo->sumLatch);
+		free(recieveInfo->sums);
+		free(recieveInfo->sumDirty);
+	}
+
+	if(recieveInfo->compressed)
+	{
+		freeSlots(recieveInfo);
+	}
+
+	free(recieveInfo);
+	fHandle->mgmtInfo=NULL;
+
+	return failed ? RC_WRITE_FAILED : RC_OK;
+
+}
+
+/*
+	Wait until every block written so far is on disk, with the checksum blocks a failed write left. A mapped file is synced
+	with msync, otherwise with fdatasync.
+*/
+RC syncPageFile (SM_FileHandle *fHandle) {
+
+	SM_mgmtInfo *recieveInfo=fHandle->mgmtInfo;
+	int ret;
+
+	if(writeSums(recieveInfo)!=0)
+	{
+		return RC_WRITE_FAILED;
+	}
+
+	if(recieveInfo->flags & SM_OPEN_MMAP)
+	{
+		pthread_rwlock_rdlock(&recieveInfo->mapLatch);
+		__atomic_store_n(&recieveInfo->unsynced, 0, __ATOMIC_RELAXED);
+		ret=msync(recieveInfo->map, recieveInfo->mapSize, MS_SYNC);
+		pthread_rwlock_unlock(&recieveInfo->mapLatch);
+	}
+	else
+	{
+		ret=fdatasync(recieveInfo->fd);
+	}
+
+	return ret==0 ? RC_OK : RC_WRITE_FAILED;
 
 }
 
@@ -182,53 +1787,70 @@ RC closePageFile (SM_FileHandle *fHandle) {
 
 RC destroyPageFile (char *fileName) {
 
-	if (remove(fileName)==-1) {
-		return RC_FILE_NOT_FOUND;
-	}
+	if (remove(fileName)==-1) {
+		return RC_FILE_NOT_FOUND;
+	}
+
+	return RC_OK;
+}
+
+/*
+	the CRC32C of size bytes, the checksum pages and the superblock use. Other modules use it for their own records.
+*/
+unsigned int computeChecksum (const void *data, int size) {
+
+	return crc32c(0, data, size);
 
-	return RC_OK;
 }
 
 /* reading blocks from disc 
 
-	1, To read a file, we have to get the pointer that points to the FILE object first, which is fp. We get it from fHandle.
+	1, To read a file, we have to get the file descriptor first, which is fd. We get it from fHandle.
 	2, We get the total number of pages from fHandle for this file.
 	3, Compare pageNum with total number of pages. If the pageNum input is not in the correct range, we will return an eror info.
-	4, If the pageNum is correct, we then set the start position for reading by fseek().
-	5, Based on the start position set by step 4, we read the specific page from file into the memory address that has been passed
-	by memPage.
+	4, If the pageNum is correct, we read the specific page from file into the memory address that has been passed by memPage,
+	with pread() at the offset of the page. There is no shared file position, so reads of several threads do not interfere.
+	5, verify checks the page against its checksum, only recovery reads a page it is going to rewrite anyway without.
 */
-RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-
-	FILE *fp;
+static RC readBlockAt (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, int verify) {
 
 	SM_mgmtInfo *recieveInfo;
 	recieveInfo=fHandle->mgmtInfo;
 
-	fp=recieveInfo->fp;
-
 	//compare pagesNum and totalpages
-	int filePages=fHandle->totalNumPages;
+	int filePages=loadTotalPages(fHandle);
 
 	if(pageNum >= filePages || pageNum < 0) {
 
 		return RC_READ_NON_EXISTING_PAGE;
 	}
 
-	//set the offset before reading
-	fseek(fp, META_SIZE+pageNum*PAGE_SIZE, SEEK_SET);
+	//read the content into memory, and check it against its checksum
+	RC ret=readPage(recieveInfo, pageNum, memPage, verify);
 
-	fHandle->curPagePos=pageNum;
+	if(ret!=RC_OK) {
 
-	//read the content into memory
-	fread(memPage, 1, PAGE_SIZE, fp);
+		return ret;
+	}
 
-	close(fp);
+	__atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
 
 	return RC_OK;	
 
 }
 
+RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+
+	return readBlockAt(pageNum, fHandle, memPage, 1);
+
+}
+
+RC readBlockUnverified (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+
+	return readBlockAt(pageNum, fHandle, memPage, 0);
+
+}
+
 /*
 	read the current page info from fHandle
 	
@@ -316,41 +1938,122 @@ RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage){
 }
 
 /* writing blocks to a page file 
-	1, Get the pointer that points to FILE object from fHandle.
+	1, Get the file descriptor from fHandle.
 	2, Get the total number of page from fHandle.
 	3, Varify if pageNum is in the correct range corresponding to the file object.
-	4, Set the start position for writing the file.
-	5, write the file.
+	4, write the page with pwrite() at its offset.
 
 */
 RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage){
 
-	//Get the pointer that points to FILE object from fHandle.
-	FILE *fp;
-
+	//Get the file descriptor from fHandle.
 	SM_mgmtInfo *recieveInfo;
 
 	recieveInfo=fHandle->mgmtInfo;
 
-	fp=recieveInfo->fp;
-
 	//compare pagesNum and totalpages
-	int filePages=fHandle->totalNumPages;
+	int filePages=loadTotalPages(fHandle);
 
 	if(pageNum >= filePages || pageNum < 0) {
 
 		return RC_READ_NON_EXISTING_PAGE;
 	}
 
-	//Set the start position for reading the file.
-	int offset=META_SIZE+pageNum*PAGE_SIZE;
+	//a compressed file writes the page into its slot, and the map if the slot moved
+	if(recieveInfo->compressed) {
+
+		return (writeCompressed(recieveInfo, pageNum, 1, &memPage)!=0) ? RC_WRITE_FAILED : RC_OK;
+	}
 
-	fseek(fp, offset, SEEK_SET);
+	//write the file, then its checksum block
+	if(transfer(recieveInfo, memPage, PAGE_SIZE, pageOffset(recieveInfo, pageNum), 1)!=0) {
 
-	//write the file.
-	fwrite(memPage, 1, PAGE_SIZE, fp);
+		return RC_WRITE_FAILED;
+	}
+
+	return (storeSums(recieveInfo, pageNum, 1, &memPage)!=0) ? RC_WRITE_FAILED : RC_OK;
+}
+
+/* write the numPages pages from firstPage on, memPages[i] holds page firstPage+i.
+	1, the pages are contiguous in the file, so they are written with one pwritev per SM_WRITEV_MAX pages instead of one
+	pwrite per page. With checksums a pwritev ends at a checksum block, so its pages are contiguous.
+	2, a mapped file copies them into the mapping one by one, so does a direct file if a buffer is not aligned.
+	3, if the file system rejects O_DIRECT the file falls back to buffered I/O like transfer() does.
+	4, a compressed file writes each page into its own slot, and the map blocks that changed once at the end.
+*/
+RC writeBlocks (int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages){
+
+	SM_mgmtInfo *info=fHandle->mgmtInfo;
+	struct iovec iov[SM_WRITEV_MAX];
+	int i, n, done, ret;
+	int vectored=!(info->flags & SM_OPEN_MMAP);
+
+	if(firstPage < 0 || numPages < 0 || firstPage+numPages > loadTotalPages(fHandle)) {
+
+		return RC_READ_NON_EXISTING_PAGE;
+	}
+
+	if(info->compressed)
+	{
+		return (writeCompressed(info, firstPage, numPages, memPages)!=0) ? RC_WRITE_FAILED : RC_OK;
+	}
+
+	for(i=0; i<numPages && vectored && (info->flags & SM_OPEN_DIRECT); i++)
+	{
+		vectored=((size_t)memPages[i] % SM_DIRECT_ALIGN)==0;
+	}
+
+	if(!vectored)
+	{
+		for(i=0; i<numPages; i++)
+		{
+			if(transfer(info, memPages[i], PAGE_SIZE, pageOffset(info, firstPage+i), 1)!=0)
+			{
+				return RC_WRITE_FAILED;
+			}
+		}
+		return (storeSums(info, firstPage, numPages, memPages)!=0) ? RC_WRITE_FAILED : RC_OK;
+	}
+
+	for(done=0; done<numPages; done+=n)
+	{
+		n=(numPages-done < SM_WRITEV_MAX) ? numPages-done : SM_WRITEV_MAX;
+
+		if(info->checksums && n>SM_SUM_GROUP-(firstPage+done)%SM_SUM_GROUP)
+		{
+			n=SM_SUM_GROUP-(firstPage+done)%SM_SUM_GROUP;
+		}
+
+		for(i=0; i<n; i++)
+		{
+			iov[i].iov_base=memPages[done+i];
+			iov[i].iov_len=PAGE_SIZE;
+		}
+
+		errno=0;
+		ret=pwritevFull(info->fd, iov, n, pageOffset(info, firstPage+done));
+
+		if(ret!=0 && errno==EINVAL && (info->flags & SM_OPEN_DIRECT))
+		{
+			dropDirect(info);
+
+			//the failed call may have moved the vector
+			for(i=0; i<n; i++)
+			{
+				iov[i].iov_base=memPages[done+i];
+				iov[i].iov_len=PAGE_SIZE;
+			}
+			ret=pwritevFull(info->fd, iov, n, pageOffset(info, firstPage+done));
+		}
+
+		if(ret!=0 || storeSums(info, firstPage+done, n, memPages+done)!=0)
+		{
+			return RC_WRITE_FAILED;
+		}
+	}
+
+	return RC_OK;
 
-	return RC_OK;	
 }
 
 /*
@@ -363,71 +2066,139 @@ RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage){
 
 }
 
-/*
-	Append an empty block to the file object.
-	1, Create an empty block in memory with the size of a page.
-	2, Get the pointer that points to the file object.
-	3, Set the offset, which is the size of the meta data plus all the pages.
-	4, Write the empty block at the end of the file object.
-*/
+/* write the superblock with the new number of pages, and the units of the map blocks of a compressed file. The whole
+header is one aligned META_SIZE block, written with a single pwrite, which also suits O_DIRECT. */
+static int writeHeader (SM_mgmtInfo *info, int numPages) {
 
-RC appendEmptyBlock (SM_FileHandle *fHandle){
+	char *metapage;
+	int ret;
 
-	//malloc memory
-	char *newpage=(char *)malloc(PAGE_SIZE);
+	if(posix_memalign((void **)&metapage, SM_DIRECT_ALIGN, META_SIZE)!=0)
+	{
+		return -1;
+	}
+
+	if(info->compressed)
+	{
+		fillHeader(metapage, numPages, SM_FEATURE_COMPRESSED);
+
+		pthread_rwlock_rdlock(&info->slotLatch);
+		memcpy(metapage+SM_MAP_DIR_OFFSET, info->mapUnits, sizeof(uint32_t)*info->numMapBlocks);
+		pthread_rwlock_unlock(&info->slotLatch);
+	}
+	else
+	{
+		fillHeader(metapage, numPages, info->checksums ? SM_FEATURE_CHECKSUMS : 0);
+	}
 
-	memset(newpage, '\0', PAGE_SIZE);
+	ret=transfer(info, metapage, META_SIZE, 0, 1);
 
-	//get the pointer to the file
-	FILE *fp;
+	free(metapage);
 
-	SM_mgmtInfo *recieveInfo;
+	return ret;
 
-	recieveInfo=fHandle->mgmtInfo;
+}
+
+/* reserve disk space for the pages past numPages, without changing the size of the file. If the file system cannot do
+that the file simply grows without reservations from now on. */
+static void reserveExtent (SM_mgmtInfo *info, int numPages) {
+
+	int extent=numPages;
+
+	if(extent<SM_PREALLOC_MIN_PAGES)
+	{
+		extent=SM_PREALLOC_MIN_PAGES;
+	}
+	if(extent>SM_PREALLOC_MAX_PAGES)
+	{
+		extent=SM_PREALLOC_MAX_PAGES;
+	}
+
+	if(fallocate(info->fd, FALLOC_FL_KEEP_SIZE, fileSize(info, info->reservedPages),
+		fileSize(info, numPages+extent)-fileSize(info, info->reservedPages))!=0)
+	{
+		__atomic_and_fetch(&info->flags, ~SM_OPEN_PREALLOC, __ATOMIC_RELAXED);
+		return;
+	}
+
+	info->reservedPages=numPages+extent;
 
-	fp=recieveInfo->fp;
+}
+
+/*
+	Grow the file to numPages pages at once.
+	1, with SM_OPEN_PREALLOC and the reservation used up, the next extent is reserved first.
+	2, ftruncate extends the file, the new pages read as zeroes and take no disk space until they are written where the
+	file system supports sparse files. A mapped file also grows its mapping.
+	3, the new number of pages is written into the meta data once, however many pages were added.
+	4, only then the new page count is published, so a concurrent reader never sees a page that is not there yet.
+	5, a compressed file only needs map blocks for the new pages, they are pages of zeroes without slots.
+	Growing must not run in several threads at once.
+*/
+static RC extendFile (SM_FileHandle *fHandle, int numPages) {
 
-	//set offset
-	int offset=META_SIZE+fHandle->totalNumPages*PAGE_SIZE;
+	SM_mgmtInfo *info=fHandle->mgmtInfo;
 
-	fseek(fp, offset, SEEK_SET);
+	if(info->compressed)
+	{
+		if(growSlots(info, numPages)!=0 || writeHeader(info, numPages)!=0)
+		{
+			return RC_WRITE_FAILED;
+		}
+
+		__atomic_store_n(&fHandle->totalNumPages, numPages, __ATOMIC_RELEASE);
 
-	//write the empty block into the file.
-	fwrite(newpage, 1, PAGE_SIZE, fp);
+		return RC_OK;
+	}
 
-	fHandle->totalNumPages++;
+	if((info->flags & SM_OPEN_PREALLOC) && numPages>info->reservedPages)
+	{
+		reserveExtent(info, numPages);
+	}
 
-	//update menta data page
-	char str[50] = {'\0'};
-	sprintf(str, "%d", fHandle->totalNumPages);
+	//room for the checksums of the new pages, their checksum blocks read as zeroes like the pages
+	if(growSums(info, numPages)!=0)
+	{
+		return RC_WRITE_FAILED;
+	}
 
-	fseek(fp, 0, SEEK_SET);
-	int c = fwrite(str, 1, 50, fp);
+	//a mapped file grows the file and the mapping, growMapping writes the meta data itself
+	if(info->flags & SM_OPEN_MMAP)
+	{
+		if(growMapping(info, numPages)!=0)
+		{
+			return RC_WRITE_FAILED;
+		}
+	}
+	else if(ftruncate(info->fd, fileSize(info, numPages))!=0 || writeHeader(info, numPages)!=0)
+	{
+		return RC_WRITE_FAILED;
+	}
 
-	free(newpage);
+	__atomic_store_n(&fHandle->totalNumPages, numPages, __ATOMIC_RELEASE);
 
 	return RC_OK;
+
 }
 
 /*
-	This method is to ensure if there is enough room for a file object.
-	1, Get the pointer that points to the file object.
-	2, Get the total number of pages.
-	3, Compare the input number with the current number of pages in the file. If the difference is less than or equal to 0, it is ok.
-	4, If the difference is larger than 0. Then repeatedly add an empty block to the end of the file object, by reusing the a
-	ppendEmptyBlock() method.
+	Append an empty block to the file object, the file grows by one page of zeroes.
 */
 
-RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle){
+RC appendEmptyBlock (SM_FileHandle *fHandle){
 
-	//Get the pointer that points to the file object.
-	FILE *fp;
+	return extendFile(fHandle, fHandle->totalNumPages+1);
 
-	SM_mgmtInfo *recieveInfo;
+}
 
-	recieveInfo=fHandle->mgmtInfo;
+/*
+	This method is to ensure if there is enough room for a file object.
+	1, Get the total number of pages.
+	2, Compare the input number with the current number of pages in the file. If the difference is less than or equal to 0, it is ok.
+	3, If the difference is larger than 0, the file grows to numberOfPages in one step, with a single meta data update.
+*/
 
-	fp=recieveInfo->fp;
+RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle){
 
 	//Get the total number of pages.
 	int totalPage=fHandle->totalNumPages;
@@ -440,15 +2211,478 @@ RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle){
 		return RC_OK;
 	}
 
-	//Repeatedly adding an empty block.
+	return extendFile(fHandle, numberOfPages);
+
+}
+
+/************************************************************
+ *                    asynchronous block I/O                *
+ ************************************************************/
+
+static int ringSetup (unsigned entries, struct io_uring_params *p) {
+
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+
+}
+
+static int ringEnter (int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+
+	return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, NULL, 0);
+
+}
+
+/* append a completion to ready, lock held */
+static void pushReady (SM_AsyncIO *async, void *tag, int rc) {
+
+	if(async->readyCount==async->readyCap)
+	{
+		async->readyCap=async->readyCap*2+16;
+		async->ready=(SM_IOCompletion *)realloc(async->ready, sizeof(SM_IOCompletion)*async->readyCap);
+	}
+
+	async->ready[async->readyCount].tag=tag;
+	async->ready[async->readyCount].rc=rc;
+	async->readyCount++;
+
+}
+
+/* read a page synchronously, like readBlock but without touching the current page position */
+static int readNow (SM_mgmtInfo *info, SM_IORequest *req) {
+
+	return readPage(info, req->pageNum, req->memPage, 1);
+
+}
+
+/*
+	Map the rings of a new io_uring instance.
+	1, with IORING_FEAT_SINGLE_MMAP both rings share one mapping, otherwise they are mapped one by one.
+	2, the submission ring array is filled once, entry i always uses sqes[i].
+	3, returns -1 and leaves nothing behind if the kernel has no io_uring or does not allow it.
+*/
+static int ringInit (SM_AsyncIO *async, unsigned depth) {
+
+	struct io_uring_params p;
+	unsigned i;
+
+	memset(&p, 0, sizeof(p));
+	p.flags=IORING_SETUP_CQSIZE;
+	p.cq_entries=depth*2;
+
+	async->ringFd=ringSetup(depth, &p);
+	if(async->ringFd<0)
+	{
+		return -1;
+	}
+
+	async->sqRingSize=p.sq_off.array+p.sq_entries*sizeof(unsigned);
+	async->cqRingSize=p.cq_off.cqes+p.cq_entries*sizeof(struct io_uring_cqe);
+
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(async->cqRingSize>async->sqRingSize)
+		{
+			async->sqRingSize=async->cqRingSize;
+		}
+		async->cqRingSize=0;
+	}
+
+	async->sqRing=mmap(NULL, async->sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, async->ringFd,
+		IORING_OFF_SQ_RING);
+	async->cqRing=async->sqRing;
+
+	if(async->sqRing!=MAP_FAILED && async->cqRingSize>0)
+	{
+		async->cqRing=mmap(NULL, async->cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, async->ringFd,
+			IORING_OFF_CQ_RING);
+	}
+
+	async->sqesSize=p.sq_entries*sizeof(struct io_uring_sqe);
+	async->sqes=MAP_FAILED;
+
+	if(async->sqRing!=MAP_FAILED && async->cqRing!=MAP_FAILED)
+	{
+		async->sqes=mmap(NULL, async->sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, async->ringFd,
+			IORING_OFF_SQES);
+	}
+
+	if(async->sqes==MAP_FAILED)
+	{
+		if(async->cqRingSize>0 && async->cqRing!=MAP_FAILED)
+		{
+			munmap(async->cqRing, async->cqRingSize);
+		}
+		if(async->sqRing!=MAP_FAILED)
+		{
+			munmap(async->sqRing, async->sqRingSize);
+		}
+		close(async->ringFd);
+		async->ringFd=-1;
+		return -1;
+	}
+
+	async->sqTail=(unsigned *)((char *)async->sqRing+p.sq_off.tail);
+	async->sqMask=(unsigned *)((char *)async->sqRing+p.sq_off.ring_mask);
+	async->sqArray=(unsigned *)((char *)async->sqRing+p.sq_off.array);
+	async->cqHead=(unsigned *)((char *)async->cqRing+p.cq_off.head);
+	async->cqTail=(unsigned *)((char *)async->cqRing+p.cq_off.tail);
+	async->cqMask=(unsigned *)((char *)async->cqRing+p.cq_off.ring_mask);
+	async->cqes=(struct io_uring_cqe *)((char *)async->cqRing+p.cq_off.cqes);
+
+	for(i=0;i<p.sq_entries;i++)
+	{
+		async->sqArray[i]=i;
+	}
+
+	async->depth=depth<p.sq_entries ? depth : p.sq_entries;
+	async->inFlight=0;
+
+	return 0;
+
+}
+
+/* move every completion the kernel has posted to ready, lock held. A short or failed read (O_DIRECT rejected, an old
+kernel without IORING_OP_READ) is done again synchronously. */
+static void ringDrain (SM_mgmtInfo *info, SM_AsyncIO *async) {
+
+	unsigned head=*async->cqHead;
+	unsigned tail=__atomic_load_n(async->cqTail, __ATOMIC_ACQUIRE);
+
+	while(head!=tail)
+	{
+		struct io_uring_cqe *cqe=&async->cqes[head & *async->cqMask];
+		SM_IORequest *req=(SM_IORequest *)(size_t)cqe->user_data;
+		int rc=(cqe->res==PAGE_SIZE) ? checkSum(info, req->pageNum, req->memPage) : readNow(info, req);
+
+		pushReady(async, req->tag, rc);
+		free(req);
+
+		async->pending--;
+		async->inFlight--;
+		head++;
+	}
+
+	__atomic_store_n(async->cqHead, head, __ATOMIC_RELEASE);
+
+}
+
+/* a thread of the SM_ASYNC_THREADS pool, reads until the engine stops and the queue is empty */
+static void *asyncWorker (void *arg) {
+
+	SM_mgmtInfo *info=(SM_mgmtInfo *)arg;
+	SM_AsyncIO *async=info->async;
+	SM_IORequest *req;
+	int rc;
+
+	pthread_mutex_lock(&async->lock);
+
+	while(1)
+	{
+		while(async->queueHead==NULL && !async->stopping)
+		{
+			pthread_cond_wait(&async->work, &async->lock);
+		}
+
+		if(async->queueHead==NULL)
+		{
+			break;
+		}
+
+		req=async->queueHead;
+		async->queueHead=req->next;
+		if(async->queueHead==NULL)
+		{
+			async->queueTail=NULL;
+		}
+
+		pthread_mutex_unlock(&async->lock);
+		rc=readNow(info, req);
+		pthread_mutex_lock(&async->lock);
+
+		pushReady(async, req->tag, rc);
+		free(req);
+		async->pending--;
+		pthread_cond_broadcast(&async->done);
+	}
+
+	pthread_mutex_unlock(&async->lock);
+
+	return NULL;
+
+}
+
+/*
+	Start the asynchronous I/O engine of an open file.
+	1, queueDepth is the number of reads that may be in flight at once, more submissions wait for a free slot.
+	2, SM_ASYNC_RING uses io_uring if the kernel supports it and the file is not compressed, otherwise (and for
+	SM_ASYNC_THREADS) up to SM_ASYNC_MAX_THREADS threads run the reads. getAsyncIOMode tells which one is used.
+*/
+RC initAsyncIO (SM_FileHandle *fHandle, int queueDepth, int mode) {
+
+	SM_mgmtInfo *info=fHandle->mgmtInfo;
+	SM_AsyncIO *async;
+	int i;
+
+	if(info->async!=NULL)
+	{
+		return RC_OK;
+	}
+
+	if(queueDepth<1)
+	{
+		queueDepth=1;
+	}
+
+	async=(SM_AsyncIO *)calloc(1, sizeof(SM_AsyncIO));
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_cond_init(&async->work, NULL);
+	pthread_cond_init(&async->done, NULL);
+	async->ringFd=-1;
+
+	//io_uring reads whole pages at their offset, the slots of a compressed file are read and decompressed by the threads
+	if(mode==SM_ASYNC_RING && !info->compressed && ringInit(async, queueDepth)==0)
+	{
+		async->mode=SM_ASYNC_RING;
+		info->async=async;
+		return RC_OK;
+	}
+
+	async->mode=SM_ASYNC_THREADS;
+	async->numThreads=queueDepth<SM_ASYNC_MAX_THREADS ? queueDepth : SM_ASYNC_MAX_THREADS;
+	async->threads=(pthread_t *)malloc(sizeof(pthread_t)*async->numThreads);
+	info->async=async;
+
+	for(i=0;i<async->numThreads;i++)
+	{
+		pthread_create(&async->threads[i], NULL, asyncWorker, info);
+	}
+
+	return RC_OK;
+
+}
+
+/*
+	Stop the engine. Reads still in flight are finished first, their completions are dropped.
+*/
+RC shutdownAsyncIO (SM_FileHandle *fHandle) {
+
+	SM_mgmtInfo *info=fHandle->mgmtInfo;
+	SM_AsyncIO *async=info->async;
 	int i;
 
-	for (i=0;i<diff;i++) {
-		appendEmptyBlock(fHandle);
+	if(async==NULL)
+	{
+		return RC_OK;
+	}
+
+	if(async->mode==SM_ASYNC_RING)
+	{
+		pthread_mutex_lock(&async->lock);
+		while(async->inFlight>0)
+		{
+			ringEnter(async->ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+			ringDrain(info, async);
+		}
+		pthread_mutex_unlock(&async->lock);
+
+		munmap(async->sqes, async->sqesSize);
+		if(async->cqRingSize>0)
+		{
+			munmap(async->cqRing, async->cqRingSize);
+		}
+		munmap(async->sqRing, async->sqRingSize);
+		close(async->ringFd);
+	}
+	else
+	{
+		pthread_mutex_lock(&async->lock);
+		async->stopping=1;
+		pthread_cond_broadcast(&async->work);
+		pthread_mutex_unlock(&async->lock);
+
+		for(i=0;i<async->numThreads;i++)
+		{
+			pthread_join(async->threads[i], NULL);
+		}
+		free(async->threads);
+	}
+
+	pthread_mutex_destroy(&async->lock);
+	pthread_cond_destroy(&async->work);
+	pthread_cond_destroy(&async->done);
+	free(async->ready);
+	free(async);
+	info->async=NULL;
+
+	return RC_OK;
+
+}
+
+/* the SM_ASYNC_ mode the engine uses, 0 if it is not started */
+int getAsyncIOMode (SM_FileHandle *fHandle) {
+
+	SM_mgmtInfo *info=fHandle->mgmtInfo;
+
+	return info->async!=NULL ? info->async->mode : 0;
+
+}
+
+/*
+	Start reading a page into memPage, tag comes back with the completion from reapBlockIO.
+	1, the page has to exist, like for readBlock.
+	2, a mapped file, or an unaligned memPage of a direct I/O file, is read at once and completes immediately.
+	3, with io_uring a full ring first waits for a completion to make room, then the read is submitted right away so it
+	runs while the caller goes on.
+*/
+RC submitReadBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag) {
+
+	SM_mgmtInfo *info=fHandle->mgmtInfo;
+	SM_AsyncIO *async=info->async;
+	SM_IORequest *req;
+
+	if(pageNum>=loadTotalPages(fHandle) || pageNum<0)
+	{
+		return RC_READ_NON_EXISTING_PAGE;
+	}
+
+	req=(SM_IORequest *)malloc(sizeof(SM_IORequest));
+	req->pageNum=pageNum;
+	req->memPage=memPage;
+	req->tag=tag;
+	req->next=NULL;
+
+	if((info->flags & SM_OPEN_MMAP) || ((info->flags & SM_OPEN_DIRECT) && ((size_t)memPage % SM_DIRECT_ALIGN)!=0))
+	{
+		int rc=readNow(info, req);
+
+		pthread_mutex_lock(&async->lock);
+		pushReady(async, tag, rc);
+		pthread_mutex_unlock(&async->lock);
+
+		free(req);
+		return RC_OK;
+	}
+
+	pthread_mutex_lock(&async->lock);
+
+	if(async->mode==SM_ASYNC_RING)
+	{
+		int entered;
+
+		while(async->inFlight==async->depth)
+		{
+			ringEnter(async->ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+			ringDrain(info, async);
+		}
+
+		unsigned tail=*async->sqTail;
+		struct io_uring_sqe *sqe=&async->sqes[tail & *async->sqMask];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode=IORING_OP_READ;
+		sqe->fd=info->fd;
+		sqe->addr=(size_t)memPage;
+		sqe->len=PAGE_SIZE;
+		sqe->off=pageOffset(info, pageNum);
+		sqe->user_data=(size_t)req;
+
+		__atomic_store_n(async->sqTail, tail+1, __ATOMIC_RELEASE);
+		async->inFlight++;
+
+		while((entered=ringEnter(async->ringFd, 1, 0, 0))<0 && (errno==EINTR || errno==EAGAIN || errno==EBUSY))
+		{
+			ringDrain(info, async);
+		}
+
+		//the kernel did not take the read, it is taken back out of the ring and done synchronously. It never counted
+		//as pending, so nobody waits in io_uring_enter for it.
+		if(entered<0)
+		{
+			__atomic_store_n(async->sqTail, tail, __ATOMIC_RELEASE);
+			async->inFlight--;
+			pthread_mutex_unlock(&async->lock);
+
+			int rc=readNow(info, req);
+
+			pthread_mutex_lock(&async->lock);
+			pushReady(async, tag, rc);
+			pthread_mutex_unlock(&async->lock);
+
+			free(req);
+			return RC_OK;
+		}
+
+		async->pending++;
+	}
+	else
+	{
+		async->pending++;
+
+		if(async->queueTail==NULL)
+		{
+			async->queueHead=req;
+		}
+		else
+		{
+			async->queueTail->next=req;
+		}
+		async->queueTail=req;
+
+		pthread_cond_signal(&async->work);
 	}
 
+	pthread_mutex_unlock(&async->lock);
+
 	return RC_OK;
 
 }
 
+/*
+	Collect up to max finished reads into completions, and return how many there are.
+	1, with wait set it blocks until at least one read has finished, unless none is pending at all.
+	2, the lock is not held while waiting in io_uring_enter, so other threads can submit meanwhile.
+*/
+int reapBlockIO (SM_FileHandle *fHandle, SM_IOCompletion *completions, int max, int wait) {
+
+	SM_mgmtInfo *info=fHandle->mgmtInfo;
+	SM_AsyncIO *async=info->async;
+	int n;
+
+	pthread_mutex_lock(&async->lock);
+
+	while(1)
+	{
+		if(async->mode==SM_ASYNC_RING)
+		{
+			ringDrain(info, async);
+		}
+
+		if(async->readyCount>0 || !wait || async->pending==0)
+		{
+			break;
+		}
+
+		if(async->mode==SM_ASYNC_RING)
+		{
+			pthread_mutex_unlock(&async->lock);
+			ringEnter(async->ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+			pthread_mutex_lock(&async->lock);
+		}
+		else
+		{
+			pthread_cond_wait(&async->done, &async->lock);
+		}
+	}
+
+	n=async->readyCount<max ? async->readyCount : max;
+
+	memcpy(completions, async->ready, sizeof(SM_IOCompletion)*n);
+	memmove(async->ready, async->ready+n, sizeof(SM_IOCompletion)*(async->readyCount-n));
+	async->readyCount-=n;
+
+	pthread_mutex_unlock(&async->lock);
+
+	return n;
+
+}
+
 #endif
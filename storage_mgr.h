@@ -3,6 +3,19 @@
 
 #include "dberror.h"
 
+/* flags of openPageFileWithFlags */
+#define SM_OPEN_DIRECT 1   /* bypass the OS page cache with O_DIRECT, memory pages should be 4096 byte aligned */
+#define SM_OPEN_MMAP 2     /* map the whole file, block I/O copies from and into the mapping */
+#define SM_OPEN_PREALLOC 4 /* reserve disk space in geometrically growing extents as the file grows */
+
+/* flags of createPageFileWithFlags */
+#define SM_CREATE_CHECKSUMS 1  /* keep a CRC32C of every page, readBlock fails with RC_CHECKSUM_MISMATCH on a damaged page */
+#define SM_CREATE_COMPRESSED 2 /* store every page compressed in a slot of its size, not together with SM_CREATE_CHECKSUMS */
+
+/* modes of initAsyncIO */
+#define SM_ASYNC_RING 1      /* io_uring, falls back to SM_ASYNC_THREADS where the kernel has none */
+#define SM_ASYNC_THREADS 2   /* a pool of threads doing the reads */
+
 /************************************************************
  *                    handle data structures                *
  ************************************************************/
@@ -15,18 +28,30 @@ typedef struct SM_FileHandle {
 
 typedef char* SM_PageHandle;
 
+/* a finished asynchronous read */
+typedef struct SM_IOCompletion {
+  void *tag;   /* as passed to submitReadBlock */
+  int rc;      /* RC_OK or the error of the read */
+} SM_IOCompletion;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithFlags (char *fileName, int flags);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
+extern RC openPageFileWithFlags (char *fileName, SM_FileHandle *fHandle, int flags);
+extern int getOpenFlags (SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
+extern unsigned int computeChecksum (const void *data, int size);
 
 /* reading blocks from disc */
 extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+/* readBlock without the checksum check, for recovery, which rewrites the page and so stamps a new checksum */
+extern RC readBlockUnverified (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern int getBlockPos (SM_FileHandle *fHandle);
 extern RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
@@ -37,7 +62,16 @@ extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 /* writing blocks to a page file */
 extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlocks (int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC syncPageFile (SM_FileHandle *fHandle);
+
+/* asynchronous block I/O */
+extern RC initAsyncIO (SM_FileHandle *fHandle, int queueDepth, int mode);
+extern RC shutdownAsyncIO (SM_FileHandle *fHandle);
+extern int getAsyncIOMode (SM_FileHandle *fHandle);
+extern RC submitReadBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag);
+extern int reapBlockIO (SM_FileHandle *fHandle, SM_IOCompletion *completions, int max, int wait);
 
 #endif
@@ -7,6 +7,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <pthread.h>
 
 // var to store the current test's name
 char *testName;
@@ -37,6 +43,56 @@ static void testReadPage (void);
 
 static void testFIFO (void);
 static void testLRU (void);
+static void testCLOCK (void);
+static void testLRU_K (void);
+static void testLFU (void);
+static void testARC (void);
+
+static void testDirectIO (void);
+static void testMappedFile (void);
+static void writeAndReadBack (BM_BufferPool *bm, BM_PoolOptions *options, int num);
+
+static void testConcurrentPins (void);
+static void *pinWorker (void *arg);
+
+static void testAsyncPin (void);
+static void checkAsyncPins (BM_PoolOptions *options);
+
+static void testReadahead (void);
+static bool isResident (BM_BufferPool *bm, PageNumber pageNum);
+
+static void testBackgroundWriter (void);
+
+static void testFlushPool (void);
+static void testWriteFailure (void);
+static void limitFileSize (long size);
+
+static void testFileGrowth (void);
+
+static void testSuperblock (void);
+static void overwriteHeader (char *fileName, long offset, char *bytes, int size);
+
+static void testChecksums (void);
+static bool waitForWrites (BM_BufferPool *bm, int num);
+
+static void testCompression (void);
+static long fileBytes (char *fileName);
+
+static void testWriteAheadLog (void);
+static void logUpdates (BM_BufferPool *bm, WAL_Log *log, int num, char *text);
+static void *commitWorker (void *arg);
+
+static void testAccessTrace (void);
+
+static void testPoolStats (void);
+static void *statsWorker (void *arg);
+
+static void testPoolSnapshot (void);
+
+static void testResize (void);
+static void resizeAndCheck (ReplacementStrategy strategy);
+
+static void testAccessHints (void);
 
 // main method
 int 
@@ -49,6 +105,28 @@ main (void)
   testReadPage();
   testFIFO();
   testLRU();
+  testCLOCK();
+  testLRU_K();
+  testLFU();
+  testARC();
+  testDirectIO();
+  testMappedFile();
+  testConcurrentPins();
+  testAsyncPin();
+  testReadahead();
+  testBackgroundWriter();
+  testFlushPool();
+  testWriteFailure();
+  testFileGrowth();
+  testSuperblock();
+  testChecksums();
+  testCompression();
+  testWriteAheadLog();
+  testAccessTrace();
+  testPoolStats();
+  testPoolSnapshot();
+  testResize();
+  testAccessHints();
 }
 
 // create n pages with content "Page X" and read them back to check whether the content is right
@@ -297,3 +375,1580 @@ testLRU (void)
   free(h);
   TEST_DONE();
 }
+
+// test the CLOCK page replacement strategy
+void
+testCLOCK (void)
+{
+  // expected results
+  const char *poolContents[] = { 
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    // first miss clears every reference bit and takes frame 0
+    "[3 0],[1 0],[2 0]",
+    // hit on page 1 gives it a second chance
+    "[3 0],[1 0],[2 0]",
+    "[3 0],[1 0],[4 0]",
+    "[3 0],[5 0],[4 0]",
+    "[6 0],[5 0],[4 0]"
+  };
+  const int requests[] = {0,1,2,3,1,4,5,6};
+  const int numRequests = 8;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing CLOCK page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+
+  for(i = 0; i < numRequests; i++)
+  {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+  }
+
+  // check number of write IOs
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the LRU-K page replacement strategy with K=2
+void
+testLRU_K (void)
+{
+  // expected results
+  const char *poolContents[] = { 
+    // pages 0 and 1 are referenced twice
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    // pages seen only once have an infinite backward distance and are evicted first
+    "[0 0],[1 0],[3 0]",
+    "[0 0],[1 0],[4 0]",
+    // page 2 keeps its retained history, the next miss evicts the oldest second reference
+    "[0 0],[1 0],[2 0]",
+    "[5 0],[1 0],[2 0]"
+  };
+  const int requests[] = {0,1,0,1,2,3,4,2,5};
+  const int numRequests = 9;
+
+  int i;
+  BM_LRUKParams params = { 2, 0, 0 };
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing LRU-K page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, &params));
+
+  for(i = 0; i < numRequests; i++)
+  {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+  }
+
+  // check number of write IOs
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the LFU page replacement strategy
+void
+testLFU (void)
+{
+  // expected results
+  const char *poolContents[] = { 
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    // page 0 is used three times, page 1 twice
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    // pages used once go first
+    "[0 0],[1 0],[3 0]",
+    "[0 0],[1 0],[4 0]",
+    // pages 1 and 4 are both used twice, the least recently used of them is evicted
+    "[0 0],[1 0],[4 0]",
+    "[0 0],[5 0],[4 0]"
+  };
+  const int requests[] = {0,1,2,0,0,1,3,4,4,5};
+  const int numRequests = 10;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing LFU page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LFU, NULL));
+
+  for(i = 0; i < numRequests; i++)
+  {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+  }
+
+  // check number of write IOs
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(6, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the ARC page replacement strategy
+void
+testARC (void)
+{
+  // expected results
+  const char *poolContents[] = { 
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    // page 0 moves to the frequency list
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[3 0],[2 0]",
+    // page 1 comes back from the recency ghost list, the recency target grows
+    "[0 0],[3 0],[1 0]",
+    "[4 0],[3 0],[1 0]",
+    // page 0 comes back from the frequency ghost list, the recency target shrinks
+    "[4 0],[0 0],[1 0]"
+  };
+  const int requests[] = {0,1,2,0,3,1,4,0};
+  const int targets[] = {0,0,0,0,0,1,1,0};
+  const int numRequests = 8;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  testName = "Testing ARC page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_ARC, NULL));
+
+  for(i = 0; i < numRequests; i++)
+  {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+      ASSERT_EQUALS_INT(targets[i], getARCTarget(bm), "check ARC target size");
+  }
+
+  // check number of write IOs
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+
+  // a ghost hit adapts the target once, also when the page gets a free frame and nothing is evicted
+  options.maxFrames = 5;
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_ARC, NULL, &options));
+  for(i = 0; i < 5; i++)
+  {
+      CHECK(pinPage(bm, h, requests[i]));
+      CHECK(unpinPage(bm, h));
+  }
+  CHECK(resizeBufferPool(bm, 5));
+  CHECK(pinPage(bm, h, 1));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(1, getARCTarget(bm), "page 1 came back from the recency ghost list");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// write pages through a pool that bypasses the OS page cache and read them back, once more with O_DIRECT
+// and once through the page cache, both must see the same content
+void
+testDirectIO (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PoolOptions options = { 0 };
+  testName = "Testing direct I/O";
+
+  options.directIO = true;
+
+  CHECK(createPageFile("testbuffer.bin"));
+  writeAndReadBack(bm, &options, 100);
+  checkDummyPages(bm, 100);
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  TEST_DONE();
+}
+
+// the same with a memory mapped page file, which also grows the mapping while the pages are created
+void
+testMappedFile (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PoolOptions options = { 0 };
+  testName = "Testing memory mapped page file";
+
+  options.mappedFile = true;
+
+  CHECK(createPageFile("testbuffer.bin"));
+  writeAndReadBack(bm, &options, 100);
+  checkDummyPages(bm, 100);
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  TEST_DONE();
+}
+
+// create num pages with content "Page X" through a pool with the given options, then read them back
+// through a new pool with the same options
+void
+writeAndReadBack (BM_BufferPool *bm, BM_PoolOptions *options, int num)
+{
+  int i;
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[512];
+
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, options));
+
+  for (i = 0; i < num; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Page", h->pageNum);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, options));
+
+  for (i = 0; i < num; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", h->pageNum);
+      ASSERT_EQUALS_STRING(expected, h->data, "reading back page content");
+      CHECK(unpinPage(bm, h));
+    }
+
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(num, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+
+  free(h);
+}
+
+// a worker of testConcurrentPins, it owns the pages that are its number modulo 4
+typedef struct PinWorker {
+  BM_BufferPool *bm;
+  int number;
+  int versions[64];
+  int errors;
+} PinWorker;
+
+// 4 threads pin pages of a pool of 12 frames, every miss evicts. Each thread changes its own pages and reads
+// the shared ones while it holds one of its own, so a lost or mixed up page shows up in the contents.
+void
+testConcurrentPins (void)
+{
+  ReplacementStrategy strategies[] = { RS_FIFO, RS_LRU, RS_CLOCK, RS_LRU_K, RS_LFU, RS_ARC };
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  PinWorker workers[4];
+  pthread_t threads[4];
+  char expected[64];
+  int *fixCounts;
+  int s, i, j;
+  testName = "Testing concurrent pins";
+
+  options.concurrent = true;
+
+  for (s = 0; s < (int) (sizeof(strategies) / sizeof(strategies[0])); s++)
+    {
+      CHECK(createPageFile("testbuffer.bin"));
+      CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 12, strategies[s], NULL, &options));
+
+      // pages 0 to 63 belong to the threads, 64 to 71 are only read
+      for (i = 0; i < 72; i++)
+	{
+	  CHECK(pinPage(bm, h, i));
+	  sprintf(h->data, "%i-%i", i, 0);
+	  CHECK(markDirty(bm, h));
+	  CHECK(unpinPage(bm, h));
+	}
+
+      for (i = 0; i < 4; i++)
+	{
+	  memset(&workers[i], 0, sizeof(PinWorker));
+	  workers[i].bm = bm;
+	  workers[i].number = i;
+	  pthread_create(&threads[i], NULL, pinWorker, &workers[i]);
+	}
+      for (i = 0; i < 4; i++)
+	pthread_join(threads[i], NULL);
+
+      for (i = 0; i < 4; i++)
+	ASSERT_EQUALS_INT(0, workers[i].errors, "every pin saw the last version of its page");
+
+      fixCounts = getFixCounts(bm);
+      for (i = 0, j = 0; i < 12; i++)
+	j += fixCounts[i];
+      free(fixCounts);
+      ASSERT_EQUALS_INT(0, j, "every pin was released");
+
+      // the last versions survive a shutdown
+      CHECK(shutdownBufferPool(bm));
+      CHECK(initBufferPool(bm, "testbuffer.bin", 12, RS_FIFO, NULL));
+      for (i = 0; i < 64; i++)
+	{
+	  CHECK(pinPage(bm, h, i));
+	  sprintf(expected, "%i-%i", i, workers[i % 4].versions[i]);
+	  if (strcmp(expected, h->data) != 0)
+	    ASSERT_EQUALS_STRING(expected, h->data, "the last version is on disk");
+	  CHECK(unpinPage(bm, h));
+	}
+      CHECK(shutdownBufferPool(bm));
+      CHECK(destroyPageFile("testbuffer.bin"));
+    }
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// 2000 rounds of: pin an own page, check and change it, pin a shared page and check it, unpin both
+void *
+pinWorker (void *arg)
+{
+  PinWorker *worker = (PinWorker *) arg;
+  BM_PageHandle own, shared;
+  char expected[64];
+  unsigned int seed = worker->number;
+  int i, page, other;
+
+  for (i = 0; i < 2000; i++)
+    {
+      page = (rand_r(&seed) % 16) * 4 + worker->number;
+      other = 64 + rand_r(&seed) % 8;
+
+      CHECK(pinPage(worker->bm, &own, page));
+      sprintf(expected, "%i-%i", page, worker->versions[page]);
+      worker->errors += (strcmp(expected, own.data) != 0);
+      sprintf(own.data, "%i-%i", page, ++worker->versions[page]);
+      CHECK(markDirty(worker->bm, &own));
+
+      CHECK(pinPage(worker->bm, &shared, other));
+      sprintf(expected, "%i-%i", other, 0);
+      worker->errors += (strcmp(expected, shared.data) != 0);
+      CHECK(unpinPage(worker->bm, &shared));
+
+      CHECK(unpinPage(worker->bm, &own));
+    }
+
+  return NULL;
+}
+
+// asynchronous pins, with io_uring (where the kernel has it) and with the thread pool
+void
+testAsyncPin (void)
+{
+  BM_PoolOptions options = { 0 };
+  testName = "Testing asynchronous pins";
+
+  checkAsyncPins(&options);
+
+  options.asyncThreads = true;
+  checkAsyncPins(&options);
+
+  TEST_DONE();
+}
+
+// pin 8 pages at once, page 3 twice so the second pin has to wait for the read of the first, and page 0
+// after all pins completed so it is a hit
+void
+checkAsyncPins (BM_PoolOptions *options)
+{
+  const int requests[] = {0,1,2,3,3,4,5,6};
+  const int numRequests = 8;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = malloc(sizeof(BM_PageHandle) * (numRequests + 1));
+  BM_PinToken tokens[9];
+  char expected[512];
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 8, RS_LRU, NULL, options));
+
+  for (i = 0; i < numRequests; i++)
+    CHECK(pinPageAsync(bm, &h[i], requests[i], &tokens[i]));
+
+  for (i = 0; i < numRequests; i++)
+    {
+      CHECK(waitPinPage(bm, tokens[i]));
+      sprintf(expected, "%s-%i", "Page", requests[i]);
+      ASSERT_EQUALS_STRING(expected, h[i].data, "reading page pinned asynchronously");
+    }
+
+  ASSERT_EQUALS_POOL("[0 1],[1 1],[2 1],[3 2],[4 1],[5 1],[6 1],[-1 0]", bm, "check pool content");
+
+  CHECK(pinPageAsync(bm, &h[numRequests], 0, &tokens[numRequests]));
+  ASSERT_TRUE(pinPageDone(bm, tokens[numRequests]), "a hit completes at once");
+  CHECK(waitPinPage(bm, tokens[numRequests]));
+  CHECK(unpinPage(bm, &h[numRequests]));
+
+  for (i = 0; i < numRequests; i++)
+    CHECK(unpinPage(bm, &h[i]));
+
+  ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+}
+
+// a sequential scan reads the pages ahead of it, a random pin does not
+void
+testReadahead (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  char expected[512];
+  testName = "Testing readahead";
+
+  options.readahead = 4;
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 8, RS_LRU, NULL, &options));
+
+  CHECK(pinPage(bm, h, 0));
+  CHECK(unpinPage(bm, h));
+  ASSERT_TRUE(!isResident(bm, 1), "a single pin is no sequential run");
+
+  for (i = 1; i < 50; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "reading page of a sequential scan");
+      CHECK(unpinPage(bm, h));
+      ASSERT_TRUE(isResident(bm, i + 1), "the next page is read ahead");
+    }
+
+  ASSERT_TRUE(getNumReadIO(bm) <= 54, "every page is read once");
+
+  CHECK(pinPage(bm, h, 80));
+  CHECK(unpinPage(bm, h));
+  ASSERT_TRUE(!isResident(bm, 81), "a random pin ends the run");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+bool
+isResident (BM_BufferPool *bm, PageNumber pageNum)
+{
+  PageNumber *frames = getFrameContents(bm);
+  bool found = false;
+  int i;
+
+  for (i = 0; i < bm->numPages; i++)
+    found |= (frames[i] == pageNum);
+
+  free(frames);
+  return found;
+}
+
+// dirty pages are written by the background writer, so the misses that evict them do not write
+void
+testBackgroundWriter (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  bool *dirty;
+  testName = "Testing background writer";
+
+  options.dirtyTarget = 1;
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 8, RS_LRU, NULL, &options));
+
+  for (i = 0; i < 8; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Page", h->pageNum);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  ASSERT_TRUE(waitForWrites(bm, 8), "the writer writes every dirty page");
+
+  dirty = getDirtyFlags(bm);
+  for (i = 0; i < 8; i++)
+    ASSERT_TRUE(!dirty[i], "written pages are clean");
+  free(dirty);
+
+  for (i = 8; i < 16; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(8, getNumWriteIO(bm), "misses find clean victims");
+
+  CHECK(shutdownBufferPool(bm));
+  checkDummyPages(bm, 8);
+
+  writeAndReadBack(bm, &options, 100);
+  checkDummyPages(bm, 100);
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// wait up to 5 seconds until num pages have been written
+bool
+waitForWrites (BM_BufferPool *bm, int num)
+{
+  int i;
+
+  for (i = 0; i < 5000 && getNumWriteIO(bm) < num; i++)
+    usleep(1000);
+
+  return getNumWriteIO(bm) == num;
+}
+
+// pages loaded in descending order are flushed in runs of consecutive pages, every page still counts as one write
+void
+testFlushPool (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  bool *dirty;
+  testName = "Testing flushing the pool";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 16, RS_FIFO, NULL));
+
+  for (i = 15; i >= 0; i--)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Page", h->pageNum);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  // a pinned page is not written
+  CHECK(pinPage(bm, h, 3));
+  CHECK(forceFlushPool(bm));
+  ASSERT_EQUALS_INT(15, getNumWriteIO(bm), "one write per flushed page");
+
+  dirty = getDirtyFlags(bm);
+  for (i = 0; i < 16; i++)
+    ASSERT_TRUE(dirty[i] == (bm->numPages - 1 - i == 3), "only the pinned page is still dirty");
+  free(dirty);
+
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  checkDummyPages(bm, 16);
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// a page whose write fails stays dirty, so it is written by a later flush instead of being dropped
+void
+testWriteFailure (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  bool *dirty;
+  int *fixCounts;
+  testName = "Testing failed writes";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_FIFO, NULL));
+
+  for (i = 0; i < 4; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(pinPage(bm, h, 3));
+  sprintf(h->data, "%s", "not lost");
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+
+  // writes past the first two pages of the file fail
+  limitFileSize(2 * PAGE_SIZE);
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, forceFlushPool(bm), "the flush reports the failed write");
+  dirty = getDirtyFlags(bm);
+  ASSERT_TRUE(dirty[3], "the page is still dirty");
+  free(dirty);
+  CHECK(pinPage(bm, h, 3));
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, forcePage(bm, h), "forcing the page reports the failed write");
+  CHECK(unpinPage(bm, h));
+  dirty = getDirtyFlags(bm);
+  ASSERT_TRUE(dirty[3], "the page is still dirty after the force");
+  free(dirty);
+  limitFileSize(-1);
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "failed writes are not counted");
+
+  CHECK(forceFlushPool(bm));
+  dirty = getDirtyFlags(bm);
+  ASSERT_TRUE(!dirty[3], "the page was written by the next flush");
+  free(dirty);
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "the page was counted once it was written");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 3));
+  ASSERT_EQUALS_STRING("not lost", h->data, "the page is on disk");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  // a dirty victim that cannot be written keeps its frame and the pin that needed the frame fails
+  CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 0));
+  sprintf(h->data, "%s", "victim");
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 1));
+  CHECK(unpinPage(bm, h));
+  limitFileSize(0);
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, pinPage(bm, h, 2), "the pin reports the failed write");
+  limitFileSize(-1);
+  dirty = getDirtyFlags(bm);
+  ASSERT_TRUE(isResident(bm, 0) && dirty[0], "the victim is still dirty in its frame");
+  free(dirty);
+  fixCounts = getFixCounts(bm);
+  ASSERT_EQUALS_INT(0, fixCounts[0] + fixCounts[1], "no frame was left pinned");
+  free(fixCounts);
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "the failed victim write is not counted");
+
+  CHECK(pinPage(bm, h, 2));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "the victim was counted once it was written");
+  CHECK(shutdownBufferPool(bm));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 0));
+  ASSERT_EQUALS_STRING("victim", h->data, "the victim was written by the next eviction");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// make writes past size bytes of any file fail with EFBIG instead of raising SIGXFSZ, a negative size lifts the limit
+void
+limitFileSize (long size)
+{
+  struct rlimit limit;
+
+  signal(SIGXFSZ, SIG_IGN);
+  getrlimit(RLIMIT_FSIZE, &limit);
+  limit.rlim_cur = (size < 0) ? limit.rlim_max : (rlim_t) size;
+  setrlimit(RLIMIT_FSIZE, &limit);
+}
+
+// pinning a page far past the end grows the file in one step, the pages in between read as zeroes
+void
+testFileGrowth (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  SM_FileHandle fh;
+  SM_PageHandle ph = malloc(PAGE_SIZE);
+  bool zero = true;
+  testName = "Testing file growth";
+
+  options.preallocate = true;
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+
+  CHECK(pinPage(bm, h, 5000));
+  sprintf(h->data, "%s-%i", "Page", h->pageNum);
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(5001, fh.totalNumPages, "the file holds every page up to the one pinned");
+
+  CHECK(readBlock(4000, &fh, ph));
+  for (i = 0; i < PAGE_SIZE; i++)
+    zero &= (ph[i] == 0);
+  ASSERT_TRUE(zero, "a page never written reads as zeroes");
+
+  CHECK(readBlock(5000, &fh, ph));
+  ASSERT_EQUALS_STRING("Page-5000", ph, "reading back the page pinned");
+  CHECK(closePageFile(&fh));
+
+  // appending one page at a time
+  writeAndReadBack(bm, &options, 100);
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(ph);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// the header is a binary superblock with a checksum, the old decimal page count is still read
+void
+testSuperblock (void)
+{
+  SM_FileHandle fh;
+  char magic[8];
+  char legacy[50] = "7";
+  FILE *file;
+  testName = "Testing the superblock";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(1, fh.totalNumPages, "a new file has one page");
+  CHECK(ensureCapacity(10, &fh));
+  CHECK(closePageFile(&fh));
+
+  file = fopen("testbuffer.bin", "rb");
+  ASSERT_TRUE(fread(magic, 1, 8, file) == 8 && strcmp(magic, "ADOPGFL") == 0, "the header starts with the magic");
+  fclose(file);
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(10, fh.totalNumPages, "the page count is read back");
+  CHECK(closePageFile(&fh));
+
+  // one damaged byte in the page count is caught by the checksum
+  overwriteHeader("testbuffer.bin", 16, "\x0b", 1);
+  ASSERT_TRUE(openPageFile("testbuffer.bin", &fh) == RC_FILE_HANDLE_NOT_INIT, "a damaged superblock is refused");
+
+  // a file from before the superblock
+  overwriteHeader("testbuffer.bin", 0, legacy, sizeof(legacy));
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(7, fh.totalNumPages, "the decimal page count is read");
+  CHECK(appendEmptyBlock(&fh));
+  CHECK(closePageFile(&fh));
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(8, fh.totalNumPages, "the file got a superblock");
+  CHECK(closePageFile(&fh));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  TEST_DONE();
+}
+
+void
+overwriteHeader (char *fileName, long offset, char *bytes, int size)
+{
+  FILE *file = fopen(fileName, "r+b");
+
+  fseek(file, offset, SEEK_SET);
+  fwrite(bytes, 1, size, file);
+  fclose(file);
+}
+
+// a damaged page of a file with checksums is refused, by the storage manager and by pinPage
+void
+testChecksums (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  SM_FileHandle fh, other;
+  SM_PageHandle ph = malloc(PAGE_SIZE);
+  testName = "Testing page checksums";
+
+  // more than one checksum block, 1024 pages each
+  CHECK(createPageFileWithFlags("testbuffer.bin", SM_CREATE_CHECKSUMS));
+  writeAndReadBack(bm, &options, 1100);
+  options.mappedFile = true;
+  writeAndReadBack(bm, &options, 1100);
+  options.mappedFile = false;
+  options.directIO = true;
+  writeAndReadBack(bm, &options, 1100);
+
+  // page 5 sits behind the header and the first checksum block, page 1030 behind the second one
+  overwriteHeader("testbuffer.bin", 4096 + (1 + 5) * 4096 + 100, "X", 1);
+  overwriteHeader("testbuffer.bin", 4096 + (1 + 1024 + 1 + 6) * 4096, "X", 1);
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_TRUE(readBlock(5, &fh, ph) == RC_CHECKSUM_MISMATCH, "a damaged page is detected");
+  CHECK(readBlock(6, &fh, ph));
+  ASSERT_EQUALS_STRING("Page-6", ph, "the next page is fine");
+  ASSERT_TRUE(readBlock(1030, &fh, ph) == RC_CHECKSUM_MISMATCH, "a damaged page of the second group is detected");
+
+  // a page written again gets a new checksum, its checksum block is on disk without a sync or a close
+  sprintf(ph, "%s-%i", "Page", 1030);
+  CHECK(writeBlock(1030, &fh, ph));
+  CHECK(openPageFile("testbuffer.bin", &other));
+  CHECK(readBlock(1030, &other, ph));
+  ASSERT_EQUALS_STRING("Page-1030", ph, "the rewritten page reads through another handle");
+  CHECK(closePageFile(&other));
+  CHECK(closePageFile(&fh));
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+  ASSERT_TRUE(pinPage(bm, h, 5) == RC_CHECKSUM_MISMATCH, "pinning a damaged page fails");
+  CHECK(pinPage(bm, h, 4));
+  ASSERT_EQUALS_STRING("Page-4", h->data, "pinning the page before works");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(ph);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// pages of a compressed file take a slot of their compressed size, the pool still sees whole pages
+void
+testCompression (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PoolOptions options = { 0 };
+  SM_FileHandle fh;
+  SM_PageHandle ph = malloc(PAGE_SIZE);
+  SM_PageHandle noise = malloc(PAGE_SIZE);
+  SM_IOCompletion done;
+  long size;
+  bool zero = true;
+  testName = "Testing page compression";
+
+  ASSERT_TRUE(createPageFileWithFlags("testbuffer.bin", SM_CREATE_COMPRESSED | SM_CREATE_CHECKSUMS) == RC_WRITE_FAILED,
+	      "compression and checksums do not go together");
+
+  // more than one map block, 1024 pages each, direct and mapped I/O fall back to normal I/O
+  CHECK(createPageFileWithFlags("testbuffer.bin", SM_CREATE_COMPRESSED));
+  writeAndReadBack(bm, &options, 1100);
+  options.directIO = true;
+  writeAndReadBack(bm, &options, 1100);
+  options.directIO = false;
+  options.mappedFile = true;
+  writeAndReadBack(bm, &options, 1100);
+  options.mappedFile = false;
+
+  size = fileBytes("testbuffer.bin");
+  ASSERT_TRUE(size < 1100L * PAGE_SIZE / 4, "a page of some text takes much less than a page on disk");
+
+  // a page that does not compress is stored as it is, a page of zeroes needs no slot
+  srand(42);
+  for (i = 0; i < PAGE_SIZE; i++)
+    noise[i] = rand();
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(writeBlock(7, &fh, noise));
+  memset(ph, 0, PAGE_SIZE);
+  CHECK(writeBlock(8, &fh, ph));
+  CHECK(readBlock(7, &fh, ph));
+  ASSERT_TRUE(memcmp(ph, noise, PAGE_SIZE) == 0, "reading back a page that does not compress");
+  CHECK(readBlock(8, &fh, ph));
+  for (i = 0; i < PAGE_SIZE; i++)
+    zero &= (ph[i] == 0);
+  ASSERT_TRUE(zero, "reading back a page of zeroes");
+
+  // page 7 shrinks again, its old slot is free once the file is opened again
+  sprintf(ph, "%s-%i", "Page", 7);
+  CHECK(writeBlock(7, &fh, ph));
+  CHECK(closePageFile(&fh));
+  size = fileBytes("testbuffer.bin");
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(readBlock(7, &fh, ph));
+  ASSERT_EQUALS_STRING("Page-7", ph, "reading back a page that shrank");
+  CHECK(readBlock(9, &fh, ph));
+  ASSERT_EQUALS_STRING("Page-9", ph, "reading back the page after it");
+
+  // io_uring cannot read a slot, the thread pool reads instead
+  CHECK(initAsyncIO(&fh, 4, SM_ASYNC_RING));
+  ASSERT_EQUALS_INT(SM_ASYNC_THREADS, getAsyncIOMode(&fh), "a compressed file is read by the thread pool");
+  CHECK(submitReadBlock(1099, &fh, ph, NULL));
+  ASSERT_TRUE(reapBlockIO(&fh, &done, 1, 1) == 1 && done.rc == RC_OK, "an asynchronous read completes");
+  ASSERT_EQUALS_STRING("Page-1099", ph, "reading a page asynchronously");
+  CHECK(writeBlock(10, &fh, noise));
+  CHECK(closePageFile(&fh));
+  ASSERT_EQUALS_INT(size, fileBytes("testbuffer.bin"), "a free slot is used again");
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(noise);
+  free(ph);
+  free(bm);
+  TEST_DONE();
+}
+
+long
+fileBytes (char *fileName)
+{
+  struct stat st;
+
+  stat(fileName, &st);
+  return st.st_size;
+}
+
+// changes logged through the pool survive a crash, the log is written before the pages, commits share syncs
+void
+testWriteAheadLog (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  WAL_Log log;
+  WAL_Lsn lsn;
+  SM_FileHandle fh;
+  SM_PageHandle ph = malloc(PAGE_SIZE);
+  pthread_t threads[8];
+  char expected[512];
+  pid_t child;
+  int status;
+  testName = "Testing the write-ahead log";
+
+  remove("testbuffer.log");
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(openLog(&log, "testbuffer.log", 0));
+  options.log = &log;
+
+  // a page is only written once the log holds its change, page 0 is evicted by page 3
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+  CHECK(pinPage(bm, h, 0));
+  sprintf(h->data, "%s-%i", "Page", 0);
+  CHECK(markDirtyLogged(bm, h, 0, 7, &lsn));
+  CHECK(unpinPage(bm, h));
+  ASSERT_TRUE(getFlushedLsn(&log) < lsn, "the change is not durable yet");
+  for (i = 1; i <= 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "the page was evicted");
+  ASSERT_TRUE(getFlushedLsn(&log) >= lsn, "the log was flushed before the page was written");
+  CHECK(shutdownBufferPool(bm));
+  CHECK(closeLog(&log));
+
+  // a crash: the child commits changes to 10 pages and dies without writing the pages still in the pool, a
+  // last change it does not commit is lost
+  child = fork();
+  if (child == 0)
+    {
+      CHECK(openLog(&log, "testbuffer.log", 0));
+      CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+      logUpdates(bm, &log, 10, "Page");
+      CHECK(pinPage(bm, h, 9));
+      sprintf(h->data, "Lost");
+      CHECK(markDirtyLogged(bm, h, 0, 5, &lsn));
+      _exit(0);
+    }
+  waitpid(child, &status, 0);
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_TRUE(fh.totalNumPages < 10 || (readBlock(9, &fh, ph) == RC_OK && strcmp(ph, "Page-9") != 0),
+	      "the last pages never reached the page file");
+  CHECK(closePageFile(&fh));
+
+  CHECK(openLog(&log, "testbuffer.log", 0));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "a committed change is redone");
+      CHECK(unpinPage(bm, h));
+    }
+
+  // after a checkpoint the log has nothing to redo any more
+  logUpdates(bm, &log, 10, "Again");
+  CHECK(checkpointBufferPool(bm));
+  ASSERT_TRUE(getFlushedLsn(&log) == getLogEnd(&log), "the checkpoint flushed the log");
+  CHECK(shutdownBufferPool(bm));
+  CHECK(closeLog(&log));
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  sprintf(ph, "Other");
+  CHECK(writeBlock(3, &fh, ph));
+  CHECK(closePageFile(&fh));
+
+  CHECK(openLog(&log, "testbuffer.log", 0));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+  CHECK(pinPage(bm, h, 3));
+  ASSERT_EQUALS_STRING("Other", h->data, "nothing was redone");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(closeLog(&log));
+
+  // a crash between the write of a page and the write of its checksum: recovery repairs the page instead of failing
+  CHECK(destroyPageFile("testbuffer.bin"));
+  CHECK(createPageFileWithFlags("testbuffer.bin", SM_CREATE_CHECKSUMS));
+  CHECK(openLog(&log, "testbuffer.log", 0));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+  CHECK(pinPage(bm, h, 2));
+  sprintf(h->data, "Before");
+  CHECK(markDirtyLogged(bm, h, 0, 7, &lsn));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(closeLog(&log));
+
+  child = fork();
+  if (child == 0)
+    {
+      CHECK(openLog(&log, "testbuffer.log", 0));
+      CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+      CHECK(pinPage(bm, h, 2));
+      sprintf(h->data, "Repaired");
+      CHECK(markDirtyLogged(bm, h, 0, 9, &lsn));
+      CHECK(flushLog(&log, lsn));
+      _exit(0);
+    }
+  waitpid(child, &status, 0);
+  overwriteHeader("testbuffer.bin", 4096 + (1 + 2) * 4096, "Repaired", 9);
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(RC_CHECKSUM_MISMATCH, readBlock(2, &fh, ph), "the page was written without its checksum");
+  CHECK(closePageFile(&fh));
+
+  CHECK(openLog(&log, "testbuffer.log", 0));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+  CHECK(pinPage(bm, h, 2));
+  ASSERT_EQUALS_STRING("Repaired", h->data, "the change was redone");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(closeLog(&log));
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(readBlock(2, &fh, ph));
+  ASSERT_EQUALS_STRING("Repaired", ph, "recovery stamped the checksum again");
+  CHECK(closePageFile(&fh));
+
+  // group commit, 8 threads committing at once share syncs
+  CHECK(openLog(&log, "testbuffer.log", 1000));
+  for (i = 0; i < 8; i++)
+    pthread_create(&threads[i], NULL, commitWorker, &log);
+  for (i = 0; i < 8; i++)
+    pthread_join(threads[i], NULL);
+  ASSERT_TRUE(getNumLogSyncs(&log) < 8 * 20, "commits were grouped");
+  CHECK(closeLog(&log));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  remove("testbuffer.log");
+
+  free(ph);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// set pages 0 to num-1 to "text-i" through the log and commit
+void
+logUpdates (BM_BufferPool *bm, WAL_Log *log, int num, char *text)
+{
+  int i;
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  WAL_Lsn lsn;
+
+  for (i = 0; i < num; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", text, i);
+      CHECK(markDirtyLogged(bm, h, 0, strlen(h->data) + 1, &lsn));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(flushLog(log, lsn));
+
+  free(h);
+}
+
+// 20 commits of one record each
+void *
+commitWorker (void *arg)
+{
+  WAL_Log *log = (WAL_Log *) arg;
+  WAL_Lsn lsn;
+  char record[100];
+  int i;
+
+  memset(record, 'r', sizeof(record));
+  for (i = 0; i < 20; i++)
+    {
+      CHECK(appendLogRecord(log, i, 0, sizeof(record), record, &lsn));
+      CHECK(flushLog(log, lsn));
+    }
+
+  return NULL;
+}
+
+// record the trace of an LRU pool and replay it through a simulated pool, which has to do the same I/O
+void
+testAccessTrace (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  BM_TraceHeader header;
+  BM_TraceRecord records[200];
+  FILE *trace;
+  int i, numRecords, reads, writes;
+  RC rc;
+  testName = "Testing access traces";
+
+  // a pool on a file that does not exist is not created
+  options.traceFile = "testbuffer.trace";
+  ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, initBufferPoolWithOptions(bm, "testbuffer.bin", 4, RS_LRU, NULL, &options),
+		    "the page file is missing");
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 4, RS_LRU, NULL, &options));
+  for (i = 0; i < 40; i++)
+    {
+      CHECK(pinPage(bm, h, (i * 7) % 10));
+      if (i % 3 == 0)
+	CHECK(markDirty(bm, h));
+      if (i % 10 == 0)
+	CHECK(forcePage(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  reads = getNumReadIO(bm);
+  writes = getNumWriteIO(bm);
+  CHECK(shutdownBufferPool(bm));
+
+  trace = fopen("testbuffer.trace", "rb");
+  ASSERT_TRUE(fread(&header, sizeof(header), 1, trace) == 1, "the trace has a header");
+  ASSERT_TRUE(memcmp(header.magic, BM_TRACE_MAGIC, sizeof(header.magic)) == 0, "the header starts with the magic");
+  ASSERT_EQUALS_INT(4, header.numFrames, "the header holds the pool size");
+  ASSERT_EQUALS_INT(RS_LRU, header.strategy, "the header holds the strategy");
+  numRecords = fread(records, sizeof(BM_TraceRecord), 200, trace);
+  fclose(trace);
+  ASSERT_EQUALS_INT(40 + 14 + 4 + 40, numRecords, "every operation was recorded");
+  ASSERT_TRUE(records[0].op == BM_TRACE_PIN && records[0].pageNum == 0, "the first pin");
+  ASSERT_TRUE(records[1].op == BM_TRACE_DIRTY && records[2].op == BM_TRACE_FORCE && records[3].op == BM_TRACE_UNPIN,
+	      "the operations are in order");
+  ASSERT_TRUE(records[numRecords - 1].time >= records[0].time, "the times grow");
+
+  // the simulated pool needs no page file
+  options.traceFile = NULL;
+  options.simulated = true;
+  CHECK(initBufferPoolWithOptions(bm, "nosuchfile.bin", 4, RS_LRU, NULL, &options));
+  h->data = NULL;
+  for (i = 0; i < numRecords; i++)
+    {
+      h->pageNum = records[i].pageNum;
+      if (records[i].op == BM_TRACE_PIN)
+	CHECK(pinPage(bm, h, h->pageNum));
+      if (records[i].op == BM_TRACE_UNPIN)
+	CHECK(unpinPage(bm, h));
+      if (records[i].op == BM_TRACE_DIRTY)
+	CHECK(markDirty(bm, h));
+      if (records[i].op == BM_TRACE_FORCE)
+	CHECK(forcePage(bm, h));
+    }
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "the replay read the same pages");
+  ASSERT_EQUALS_INT(writes, getNumWriteIO(bm), "the replay wrote the same pages");
+  CHECK(shutdownBufferPool(bm));
+  ASSERT_TRUE(access("nosuchfile.bin", F_OK) != 0, "no page file was created");
+
+  // records the trace file has no room for are lost, the shutdown reports them
+  options.traceFile = "testbuffer.trace";
+  limitFileSize(sizeof(header) + 10 * sizeof(BM_TraceRecord));
+  CHECK(initBufferPoolWithOptions(bm, "nosuchfile.bin", 4, RS_LRU, NULL, &options));
+  for (i = 0; i < 20; i++)
+    {
+      CHECK(pinPage(bm, h, i % 6));
+      CHECK(unpinPage(bm, h));
+    }
+  rc = shutdownBufferPool(bm);
+  ASSERT_EQUALS_INT(RC_WRITE_FAILED, rc, "the trace records could not all be written");
+  limitFileSize(-1);
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  remove("testbuffer.trace");
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// counters and latency histograms of a single threaded pool, and counters merged from several threads
+void
+testPoolStats (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  BM_PoolStats stats;
+  BM_Histogram histogram;
+  pthread_t threads[80];
+  int i;
+  testName = "Testing pool statistics";
+
+  CHECK(createPageFile("testbuffer.bin"));
+
+  // pages 0 to 2 miss, page 0 hits and is dirtied, page 3 evicts it
+  options.latencyStats = true;
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &options));
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(pinPage(bm, h, 0));
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 3));
+  CHECK(unpinPage(bm, h));
+
+  getPoolStats(bm, &stats);
+  ASSERT_TRUE(stats.hits == 1 && stats.misses == 4, "one hit and four misses");
+  ASSERT_TRUE(stats.evictions == 1 && stats.dirtyEvictions == 1, "page 0 was evicted dirty");
+  ASSERT_TRUE(stats.reads == 4 && stats.writes == 1, "four reads and one write");
+  ASSERT_TRUE(stats.pinLatency.count == 5 && stats.readLatency.count == 4 && stats.writeLatency.count == 1,
+	      "every pin, read and write was timed");
+  ASSERT_TRUE(histogramPercentile(&stats.pinLatency, 99) > 0, "pins take time");
+  CHECK(shutdownBufferPool(bm));
+
+  memset(&histogram, 0, sizeof(histogram));
+  histogram.buckets[3] = 10;
+  histogram.buckets[10] = 1;
+  histogram.count = 11;
+  ASSERT_TRUE(histogramPercentile(&histogram, 50) == 15, "the median is in bucket 3");
+  ASSERT_TRUE(histogramPercentile(&histogram, 99.9) == 2047, "the p999 is in bucket 10");
+
+  // four threads, the counters of all of them are merged and untimed pools have no histograms
+  options.latencyStats = false;
+  options.concurrent = true;
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 16, RS_CLOCK, NULL, &options));
+  for (i = 0; i < 4; i++)
+    pthread_create(&threads[i], NULL, statsWorker, bm);
+  for (i = 0; i < 4; i++)
+    pthread_join(threads[i], NULL);
+
+  getPoolStats(bm, &stats);
+  ASSERT_TRUE(stats.hits + stats.misses == 4 * 1000, "every pin was counted");
+  ASSERT_TRUE(stats.misses == stats.reads && stats.reads == getNumReadIO(bm), "every miss read once");
+  ASSERT_TRUE(stats.pinLatency.count == 0, "nothing was timed");
+
+  // more threads than there are slots, they count in slots of threads that exited or in the shared slot
+  for (i = 0; i < 80; i++)
+    pthread_create(&threads[i], NULL, statsWorker, bm);
+  for (i = 0; i < 80; i++)
+    pthread_join(threads[i], NULL);
+
+  getPoolStats(bm, &stats);
+  ASSERT_TRUE(stats.hits + stats.misses == 84 * 1000, "the pins of all threads were counted");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// 1000 pins of pages 0 to 31
+void *
+statsWorker (void *arg)
+{
+  BM_BufferPool *bm = (BM_BufferPool *) arg;
+  BM_PageHandle h;
+  int i;
+
+  for (i = 0; i < 1000; i++)
+    {
+      CHECK(pinPage(bm, &h, (i * 13) % 32));
+      CHECK(unpinPage(bm, &h));
+    }
+
+  return NULL;
+}
+
+// a snapshot fills arrays of the caller, only the ones it gives
+void
+testPoolSnapshot (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolSnapshot snapshot;
+  PageNumber frames[3];
+  bool dirty[3];
+  int fixCounts[3];
+  testName = "Testing pool snapshots";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+  CHECK(pinPage(bm, h, 1));
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 4));
+
+  snapshot.frameContents = frames;
+  snapshot.dirtyFlags = dirty;
+  snapshot.fixCounts = fixCounts;
+  CHECK(getPoolSnapshot(bm, &snapshot));
+  ASSERT_TRUE(frames[0] == 1 && frames[1] == 4 && frames[2] == NO_PAGE, "the pages in the frames");
+  ASSERT_TRUE(dirty[0] && !dirty[1] && !dirty[2], "the dirty flags");
+  ASSERT_TRUE(fixCounts[0] == 0 && fixCounts[1] == 1 && fixCounts[2] == 0, "the fix counts");
+  ASSERT_EQUALS_POOL("[1x0],[4 1],[-1 0]", bm, "the pool content matches the snapshot");
+
+  CHECK(unpinPage(bm, h));
+  fixCounts[1] = -1;
+  snapshot.frameContents = NULL;
+  snapshot.dirtyFlags = NULL;
+  CHECK(getPoolSnapshot(bm, &snapshot));
+  ASSERT_EQUALS_INT(0, fixCounts[1], "only the fix counts were taken");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// a pool grows into new frames and shrinks to the pages its strategy keeps, with their data and dirty flags
+void
+testResize (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  ReplacementStrategy strategy;
+  int i;
+  testName = "Testing pool resizing";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  options.maxFrames = 6;
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_LRU, NULL, &options));
+
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(resizeBufferPool(bm, 6));
+  ASSERT_EQUALS_INT(6, bm->numPages, "the pool grew");
+
+  for (i = 3; i < 6; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0],[3 0],[4 0],[5 0]", bm, "the new frames are used");
+
+  // the most recently used pages 1, 5 and 4 stay, 4 and 5 move down to the frames of 0 and 2
+  CHECK(pinPage(bm, h, 1));
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 5));
+  sprintf(h->data, "%s", "moved");
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 4));
+  CHECK(unpinPage(bm, h));
+
+  CHECK(resizeBufferPool(bm, 3));
+  ASSERT_EQUALS_INT(3, bm->numPages, "the pool shrank");
+  ASSERT_EQUALS_POOL("[4 0],[1x0],[5x0]", bm, "the hot pages stay");
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "no page was written");
+
+  CHECK(pinPage(bm, h, 5));
+  ASSERT_EQUALS_STRING("moved", h->data, "the page moved with its data");
+
+  // page 5 is pinned in the last frame
+  ASSERT_EQUALS_INT(RC_RESIZE_FAILED, resizeBufferPool(bm, 2), "a pinned page is in the way");
+  ASSERT_EQUALS_INT(3, bm->numPages, "the pool keeps its size");
+  CHECK(unpinPage(bm, h));
+
+  CHECK(resizeBufferPool(bm, 2));
+  ASSERT_EQUALS_POOL("[4 0],[5x0]", bm, "the least recently used page was evicted");
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "the dirty page was written first");
+
+  ASSERT_EQUALS_INT(RC_RESIZE_FAILED, resizeBufferPool(bm, 7), "beyond maxFrames");
+  ASSERT_EQUALS_INT(RC_RESIZE_FAILED, resizeBufferPool(bm, 0), "an empty pool");
+
+  CHECK(shutdownBufferPool(bm));
+
+  for (strategy = RS_FIFO; strategy <= RS_ARC; strategy++)
+    resizeAndCheck(strategy);
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// write pages through a pool that is resized every few pins and read them back
+void
+resizeAndCheck (ReplacementStrategy strategy)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions options = { 0 };
+  char expected[32];
+  const int sizes[] = {16, 4, 9, 2, 12, 1};
+  int i;
+
+  options.maxFrames = 16;
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 4, strategy, NULL, &options));
+
+  for (i = 0; i < 300; i++)
+    {
+      CHECK(pinPage(bm, h, (i * 7) % 40));
+      sprintf(h->data, "%s-%i", "Page", h->pageNum);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+
+      // hits as well, so the pages of the frequency lists move too
+      CHECK(pinPage(bm, h, i % 5));
+      CHECK(unpinPage(bm, h));
+
+      if (i % 25 == 0)
+	CHECK(resizeBufferPool(bm, sizes[(i / 25) % 6]));
+    }
+
+  for (i = 0; i < 40; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "reading back a page of a resized pool");
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+
+  free(bm);
+  free(h);
+}
+
+// scans and bulk writes with an access ring only recycle the ring's frames, the hot pages stay
+void
+testAccessHints (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_AccessRing ring;
+  bool hot = true;
+  int i;
+  testName = "Testing access hints";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 16, RS_LRU, NULL));
+
+  for (i = 0; i < 6; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+
+  // a ring has at most an eighth of the frames
+  CHECK(initAccessRing(bm, &ring, BM_HINT_SCAN, 0));
+  ASSERT_EQUALS_INT(2, ring.numFrames, "the ring is capped");
+
+  for (i = 100; i < 120; i++)
+    {
+      CHECK(pinPageHinted(bm, h, i, &ring));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(freeAccessRing(&ring));
+
+  for (i = 0; i < 6; i++)
+    hot &= isResident(bm, i);
+  ASSERT_TRUE(hot, "the scan left the hot pages alone");
+  ASSERT_TRUE(isResident(bm, 118) && isResident(bm, 119) && !isResident(bm, 117), "the scan recycled its ring");
+  ASSERT_EQUALS_INT(26, getNumReadIO(bm), "every scanned page was read once");
+
+  // the dirty frames of a bulk write are written back as the ring goes round
+  CHECK(initAccessRing(bm, &ring, BM_HINT_BULK_WRITE, 0));
+  for (i = 200; i < 210; i++)
+    {
+      CHECK(pinPageHinted(bm, h, i, &ring));
+      sprintf(h->data, "%s-%i", "Page", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(freeAccessRing(&ring));
+
+  ASSERT_EQUALS_INT(8, getNumWriteIO(bm), "the recycled frames were written");
+  for (i = 0; i < 6; i++)
+    hot &= isResident(bm, i);
+  ASSERT_TRUE(hot, "the bulk write left the hot pages alone");
+
+  // a normal hint pins like pinPage
+  CHECK(initAccessRing(bm, &ring, BM_HINT_NORMAL, 0));
+  CHECK(pinPageHinted(bm, h, 200, &ring));
+  ASSERT_EQUALS_STRING("Page-200", h->data, "reading back a bulk written page");
+  CHECK(unpinPage(bm, h));
+  CHECK(freeAccessRing(&ring));
+
+  // the cap follows the size of the pool
+  CHECK(initAccessRing(bm, &ring, BM_HINT_SCAN, 0));
+  CHECK(resizeBufferPool(bm, 8));
+  CHECK(pinPageHinted(bm, h, 300, &ring));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(1, ring.numFrames, "the ring shrank with the pool");
+  CHECK(freeAccessRing(&ring));
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
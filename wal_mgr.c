@@ -0,0 +1,642 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dberror.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "storage_mgr.h"
+#include "wal_mgr.h"
+
+/* module wide constants */
+
+/* the log file starts with a header block, the records follow. The record at log position p is at byte
+WAL_HEADER_SIZE+p of the file. */
+#define WAL_HEADER_SIZE 4096
+#define WAL_MAGIC "ADOWAL"
+#define WAL_FORMAT_VERSION 1
+
+/* records are padded to a multiple of WAL_ALIGN bytes */
+#define WAL_ALIGN 8
+
+/* the append buffer starts this large and doubles when a group commit takes long enough to fill it */
+#define WAL_BUFFER_SIZE (64*1024)
+
+/* the part of the log before the start position is given back to the file system in blocks of this size */
+#define WAL_HOLE_ALIGN 4096
+
+/************************************************************
+ *                    data structures                       *
+ ************************************************************/
+
+/* the header of the log, startLsn is where recovery begins. checksum is the CRC32C of the header with checksum 0. */
+typedef struct WAL_Header {
+
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	int64_t startLsn;
+	uint32_t checksum;
+	uint32_t pad;
+
+} WAL_Header;
+
+/* a redo record: the dataLength bytes that follow are written at offset of page pageNum. lsn is the position right
+after the record, so a record left over from an older log at the same place is told apart. checksum is the CRC32C of
+the record from length on, the data included. */
+typedef struct WAL_Record {
+
+	uint32_t checksum;
+	uint32_t length;
+	int64_t lsn;
+	int32_t pageNum;
+	uint16_t offset;
+	uint16_t dataLength;
+
+} WAL_Record;
+
+/* an open log.
+	1, latch protects everything below it. Records are appended to buffer, which holds the log from bufferLsn up to
+	endLsn. Everything before flushedLsn is on disk.
+	2, group commit: one flushLog at a time is the leader (flushing is set). It takes the whole buffer, gives the
+	appenders the spare one and writes and syncs without the latch. The others wait on flushed and are done if the
+	leader got far enough, otherwise one of them leads the next group.
+*/
+typedef struct WAL_mgmtData {
+
+	int fd;
+	int groupDelayUs;
+
+	pthread_mutex_t latch;
+	pthread_cond_t flushed;
+
+	char *buffer;
+	int used;
+	int capacity;
+	char *spare;
+	int spareCapacity;
+
+	WAL_Lsn bufferLsn;
+	WAL_Lsn endLsn;
+	WAL_Lsn flushedLsn;
+	WAL_Lsn startLsn;
+	int flushing;
+	int numSyncs;
+
+} WAL_mgmtData;
+
+/************************************************************
+ *                    helpers                               *
+ ************************************************************/
+
+/* pread or pwrite the whole buffer, -1 on an error or (for reads) at the end of the file */
+static int transferFull (int fd, char *buf, size_t size, off_t offset, int isWrite) {
+
+	ssize_t n;
+
+	while(size>0)
+	{
+		n=isWrite ? pwrite(fd, buf, size, offset) : pread(fd, buf, size, offset);
+
+		if(n<0 && errno==EINTR)
+		{
+			continue;
+		}
+		if(n<=0)
+		{
+			return -1;
+		}
+
+		buf+=n;
+		size-=n;
+		offset+=n;
+	}
+
+	return 0;
+
+}
+
+/* bytes a record with length bytes of data takes in the log */
+static int recordSize (int length) {
+
+	return (int)((sizeof(WAL_Record)+length+WAL_ALIGN-1)/WAL_ALIGN*WAL_ALIGN);
+
+}
+
+/* write the header with the start position and sync it */
+static int writeLogHeader (WAL_mgmtData *wal, WAL_Lsn startLsn) {
+
+	char block[WAL_HEADER_SIZE];
+	WAL_Header header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, WAL_MAGIC, sizeof(WAL_MAGIC));
+	header.version=WAL_FORMAT_VERSION;
+	header.startLsn=startLsn;
+	header.checksum=computeChecksum(&header, sizeof(header));
+
+	memset(block, 0, sizeof(block));
+	memcpy(block, &header, sizeof(header));
+
+	if(transferFull(wal->fd, block, WAL_HEADER_SIZE, 0, 1)!=0 || fdatasync(wal->fd)!=0)
+	{
+		return -1;
+	}
+
+	return 0;
+
+}
+
+/* the start position in the header, -1 if the header is damaged or of a newer format */
+static WAL_Lsn readLogHeader (WAL_mgmtData *wal) {
+
+	WAL_Header header;
+	uint32_t checksum;
+
+	if(transferFull(wal->fd, (char *)&header, sizeof(header), 0, 0)!=0)
+	{
+		return -1;
+	}
+
+	checksum=header.checksum;
+	header.checksum=0;
+
+	if(memcmp(header.magic, WAL_MAGIC, sizeof(WAL_MAGIC))!=0 || header.version>WAL_FORMAT_VERSION
+		|| computeChecksum(&header, sizeof(header))!=checksum || header.startLsn<0)
+	{
+		return -1;
+	}
+
+	return header.startLsn;
+
+}
+
+/* read the record at position pos into rec and data (PAGE_SIZE bytes). Returns -1 at the end of the log, which is the
+first record that is missing, torn or damaged. */
+static int readRecord (WAL_mgmtData *wal, WAL_Lsn pos, WAL_Record *rec, char *data) {
+
+	uint32_t checksum;
+	char *record;
+	int size;
+
+	if(transferFull(wal->fd, (char *)rec, sizeof(WAL_Record), WAL_HEADER_SIZE+pos, 0)!=0 || rec->dataLength>PAGE_SIZE
+		|| rec->length!=(uint32_t)recordSize(rec->dataLength) || rec->lsn!=pos+rec->length)
+	{
+		return -1;
+	}
+
+	size=rec->length;
+	record=(char *)malloc(size);
+
+	if(transferFull(wal->fd, record, size, WAL_HEADER_SIZE+pos, 0)!=0)
+	{
+		free(record);
+		return -1;
+	}
+
+	checksum=computeChecksum(record+sizeof(uint32_t), sizeof(WAL_Record)-sizeof(uint32_t)+rec->dataLength);
+	memcpy(data, record+sizeof(WAL_Record), rec->dataLength);
+	free(record);
+
+	return (checksum==rec->checksum) ? 0 : -1;
+
+}
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/*
+	1, open the log file, or create it with an empty log if there is none.
+	2, the records from the start position in the header on are read up to the first one that is missing or damaged,
+	that is the end of the log. Whatever follows it (a group commit cut short by a crash) is cut off, so it cannot be
+	mistaken for records later.
+	3, new records are appended at the end, everything before it counts as flushed.
+*/
+RC openLog (WAL_Log *log, char *logFileName, int groupDelayUs) {
+
+	WAL_mgmtData *wal;
+	WAL_Record rec;
+	WAL_Lsn pos;
+	struct stat st;
+	char *data;
+	int fd;
+
+	fd=open(logFileName, O_RDWR|O_CREAT, 0644);
+	if(fd<0)
+	{
+		return RC_FILE_NOT_FOUND;
+	}
+
+	wal=(WAL_mgmtData *)calloc(1, sizeof(WAL_mgmtData));
+	wal->fd=fd;
+	wal->groupDelayUs=groupDelayUs;
+
+	if(fstat(fd, &st)!=0)
+	{
+		close(fd);
+		free(wal);
+		return RC_FILE_HANDLE_NOT_INIT;
+	}
+
+	//a new log, or the start position of an existing one
+	if(st.st_size==0)
+	{
+		pos=0;
+		if(writeLogHeader(wal, 0)!=0)
+		{
+			close(fd);
+			free(wal);
+			return RC_WRITE_FAILED;
+		}
+	}
+	else if((pos=readLogHeader(wal))<0)
+	{
+		close(fd);
+		free(wal);
+		return RC_FILE_HANDLE_NOT_INIT;
+	}
+	wal->startLsn=pos;
+
+	//find the end of the log
+	data=(char *)malloc(PAGE_SIZE);
+	while(readRecord(wal, pos, &rec, data)==0)
+	{
+		pos=rec.lsn;
+	}
+	free(data);
+
+	if(ftruncate(fd, WAL_HEADER_SIZE+pos)!=0)
+	{
+		close(fd);
+		free(wal);
+		return RC_WRITE_FAILED;
+	}
+
+	wal->bufferLsn=pos;
+	wal->endLsn=pos;
+	wal->flushedLsn=pos;
+	wal->capacity=WAL_BUFFER_SIZE;
+	wal->buffer=(char *)malloc(wal->capacity);
+	wal->spareCapacity=WAL_BUFFER_SIZE;
+	wal->spare=(char *)malloc(wal->spareCapacity);
+
+	pthread_mutex_init(&wal->latch, NULL);
+	pthread_cond_init(&wal->flushed, NULL);
+
+	log->logFile=logFileName;
+	log->mgmtData=wal;
+
+	return RC_OK;
+
+}
+
+/*
+	flush every record appended so far and close the log
+*/
+RC closeLog (WAL_Log *log) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+	RC ret=flushLog(log, getLogEnd(log));
+
+	close(wal->fd);
+	pthread_mutex_destroy(&wal->latch);
+	pthread_cond_destroy(&wal->flushed);
+	free(wal->buffer);
+	free(wal->spare);
+	free(wal);
+	log->mgmtData=NULL;
+
+	return ret;
+
+}
+
+/*
+	Append a redo record for page pageNum and return its LSN in lsn. It is only copied into the append buffer,
+	flushLog makes it durable.
+*/
+RC appendLogRecord (WAL_Log *log, int pageNum, int offset, int length, char *data, WAL_Lsn *lsn) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+	WAL_Record rec;
+	char *record;
+	int size=recordSize(length);
+
+	if(pageNum<0 || offset<0 || length<0 || offset+length>PAGE_SIZE)
+	{
+		return RC_WRITE_FAILED;
+	}
+
+	pthread_mutex_lock(&wal->latch);
+
+	//make room, the buffer doubles
+	if(wal->used+size>wal->capacity)
+	{
+		while(wal->used+size>wal->capacity)
+		{
+			wal->capacity*=2;
+		}
+		wal->buffer=(char *)realloc(wal->buffer, wal->capacity);
+	}
+
+	record=wal->buffer+wal->used;
+	memset(record, 0, size);
+
+	rec.length=size;
+	rec.lsn=wal->endLsn+size;
+	rec.pageNum=pageNum;
+	rec.offset=(uint16_t)offset;
+	rec.dataLength=(uint16_t)length;
+	memcpy(record, &rec, sizeof(rec));
+	memcpy(record+sizeof(rec), data, length);
+
+	rec.checksum=computeChecksum(record+sizeof(uint32_t), sizeof(rec)-sizeof(uint32_t)+length);
+	memcpy(record, &rec.checksum, sizeof(uint32_t));
+
+	wal->used+=size;
+	wal->endLsn+=size;
+	*lsn=wal->endLsn;
+
+	pthread_mutex_unlock(&wal->latch);
+
+	return RC_OK;
+
+}
+
+/*
+	the position after the last record appended, a record boundary
+*/
+WAL_Lsn getLogEnd (WAL_Log *log) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+	WAL_Lsn lsn;
+
+	pthread_mutex_lock(&wal->latch);
+	lsn=wal->endLsn;
+	pthread_mutex_unlock(&wal->latch);
+
+	return lsn;
+
+}
+
+/*
+	Make every record up to lsn durable, with group commit.
+	1, if a leader is already writing, wait for it. Its group may already contain lsn.
+	2, otherwise become the leader: wait groupDelayUs for more records, take the append buffer, write it at its position
+	and sync the file. Commits that arrived in the meantime are all covered by that one sync.
+	3, every waiter is woken up when the leader is done, even if it failed, so another one can try.
+*/
+RC flushLog (WAL_Log *log, WAL_Lsn lsn) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+	char *data;
+	int size, capacity, failed;
+	WAL_Lsn pos;
+
+	if(__atomic_load_n(&wal->flushedLsn, __ATOMIC_ACQUIRE)>=lsn)
+	{
+		return RC_OK;
+	}
+
+	pthread_mutex_lock(&wal->latch);
+
+	if(lsn>wal->endLsn)
+	{
+		lsn=wal->endLsn;
+	}
+
+	while(wal->flushedLsn<lsn)
+	{
+		if(wal->flushing)
+		{
+			pthread_cond_wait(&wal->flushed, &wal->latch);
+			continue;
+		}
+
+		wal->flushing=1;
+
+		if(wal->groupDelayUs>0)
+		{
+			pthread_mutex_unlock(&wal->latch);
+			usleep(wal->groupDelayUs);
+			pthread_mutex_lock(&wal->latch);
+		}
+
+		//take the buffer, the appenders go on in the spare one
+		data=wal->buffer;
+		size=wal->used;
+		capacity=wal->capacity;
+		pos=wal->bufferLsn;
+
+		wal->buffer=wal->spare;
+		wal->capacity=wal->spareCapacity;
+		wal->used=0;
+		wal->bufferLsn=wal->endLsn;
+
+		pthread_mutex_unlock(&wal->latch);
+
+		failed=transferFull(wal->fd, data, size, WAL_HEADER_SIZE+pos, 1)!=0 || fdatasync(wal->fd)!=0;
+
+		pthread_mutex_lock(&wal->latch);
+
+		wal->spare=data;
+		wal->spareCapacity=capacity;
+		wal->flushing=0;
+
+		if(failed)
+		{
+			//the records go back in front of the ones appended since, the next leader writes them again
+			if(wal->used+size>wal->capacity)
+			{
+				while(wal->used+size>wal->capacity)
+				{
+					wal->capacity*=2;
+				}
+				wal->buffer=(char *)realloc(wal->buffer, wal->capacity);
+			}
+			memmove(wal->buffer+size, wal->buffer, wal->used);
+			memcpy(wal->buffer, data, size);
+			wal->used+=size;
+			wal->bufferLsn=pos;
+
+			pthread_cond_broadcast(&wal->flushed);
+			pthread_mutex_unlock(&wal->latch);
+			return RC_WRITE_FAILED;
+		}
+
+		__atomic_store_n(&wal->flushedLsn, pos+size, __ATOMIC_RELEASE);
+		wal->numSyncs++;
+		pthread_cond_broadcast(&wal->flushed);
+	}
+
+	pthread_mutex_unlock(&wal->latch);
+
+	return RC_OK;
+
+}
+
+/*
+	the position up to which the log is durable
+*/
+WAL_Lsn getFlushedLsn (WAL_Log *log) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+
+	return __atomic_load_n(&wal->flushedLsn, __ATOMIC_ACQUIRE);
+
+}
+
+/*
+	the number of syncs of the log, each one a group commit
+*/
+int getNumLogSyncs (WAL_Log *log) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+	int numSyncs;
+
+	pthread_mutex_lock(&wal->latch);
+	numSyncs=wal->numSyncs;
+	pthread_mutex_unlock(&wal->latch);
+
+	return numSyncs;
+
+}
+
+/*
+	Drop the records before lsn.
+	1, the log is flushed up to lsn first, so the new start is on disk before the header points at it.
+	2, the header gets the new start, recovery begins there from now on.
+	3, the blocks before it are punched out of the file, if the file system supports that.
+*/
+RC truncateLog (WAL_Log *log, WAL_Lsn lsn) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+	RC ret;
+
+	if((ret=flushLog(log, lsn))!=RC_OK)
+	{
+		return ret;
+	}
+
+	pthread_mutex_lock(&wal->latch);
+
+	if(lsn>wal->startLsn)
+	{
+		if(writeLogHeader(wal, lsn)!=0)
+		{
+			ret=RC_WRITE_FAILED;
+		}
+		else
+		{
+			wal->startLsn=lsn;
+
+			if(lsn/WAL_HOLE_ALIGN>0)
+			{
+				fallocate(wal->fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, WAL_HEADER_SIZE,
+					lsn/WAL_HOLE_ALIGN*WAL_HOLE_ALIGN);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&wal->latch);
+
+	return ret;
+
+}
+
+/*
+	Redo: apply the records from the start of the log to its end to the page file.
+	1, the records are physical, they set bytes of a page to what they were. Applied in log order they give the pages
+	as they were after the last record, whatever part of that had been written before the crash.
+	2, one page is kept in memory, it is written back when a record for another page comes up. Pages past the end of
+	the file are added. A page is read without checking its checksum: a crash between the write of a page and the write
+	of its checksum leaves a mismatch, the redo of every change since the checkpoint repairs the page and its write
+	stamps the checksum again.
+	3, at last the page file is synced, then the log is no longer needed and starts at its end.
+*/
+RC recoverLog (WAL_Log *log, char *pageFileName) {
+
+	WAL_mgmtData *wal=log->mgmtData;
+	SM_FileHandle fh;
+	SM_PageHandle page;
+	WAL_Record rec;
+	WAL_Lsn pos, end=getLogEnd(log);
+	char *data;
+	int pageNum=-1;
+	RC ret;
+
+	if(wal->startLsn==end)
+	{
+		return RC_OK;
+	}
+
+	//without memory for the pages nothing is opened or written, the log stays for the next recovery
+	data=(char *)malloc(PAGE_SIZE);
+	if(data==NULL || posix_memalign((void **)&page, 4096, PAGE_SIZE)!=0)
+	{
+		free(data);
+		return RC_WRITE_FAILED;
+	}
+
+	if((ret=openPageFile(pageFileName, &fh))!=RC_OK)
+	{
+		free(data);
+		free(page);
+		return ret;
+	}
+
+	for(pos=wal->startLsn; pos<end && ret==RC_OK; pos=rec.lsn)
+	{
+		if(readRecord(wal, pos, &rec, data)!=0)
+		{
+			ret=RC_READ_NON_EXISTING_PAGE;
+			break;
+		}
+
+		if(rec.pageNum!=pageNum)
+		{
+			if(pageNum>=0)
+			{
+				ret=writeBlock(pageNum, &fh, page);
+			}
+
+			pageNum=rec.pageNum;
+
+			if(ret==RC_OK)
+			{
+				ret=ensureCapacity(pageNum+1, &fh);
+			}
+			//the page may have been written without its checksum before the crash, the redo and the write
+			//below give it the right content and checksum again
+			if(ret==RC_OK)
+			{
+				ret=readBlockUnverified(pageNum, &fh, page);
+			}
+		}
+
+		memcpy(page+rec.offset, data, rec.dataLength);
+	}
+
+	if(ret==RC_OK && pageNum>=0)
+	{
+		ret=writeBlock(pageNum, &fh, page);
+	}
+	if(ret==RC_OK)
+	{
+		ret=syncPageFile(&fh);
+	}
+
+	closePageFile(&fh);
+	free(page);
+	free(data);
+
+	return (ret==RC_OK) ? truncateLog(log, end) : ret;
+
+}
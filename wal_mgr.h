@@ -0,0 +1,41 @@
+#ifndef WAL_MGR_H
+#define WAL_MGR_H
+
+#include "dberror.h"
+
+/* a position in the log. The LSN of a record is the position right after it, so a log flushed up to an LSN holds
+   that record and every one before it. 0 is the start of the log. */
+typedef long long WAL_Lsn;
+
+/************************************************************
+ *                    handle data structures                *
+ ************************************************************/
+typedef struct WAL_Log {
+  char *logFile;
+  void *mgmtData;
+} WAL_Log;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* opening and closing a log, openLog creates the file if there is none. A leader of a group commit waits
+   groupDelayUs microseconds for more commits to join before it syncs, 0 syncs at once. */
+extern RC openLog (WAL_Log *log, char *logFileName, int groupDelayUs);
+extern RC closeLog (WAL_Log *log);
+
+/* appending redo records, the length bytes from offset on of page pageNum are set to data */
+extern RC appendLogRecord (WAL_Log *log, int pageNum, int offset, int length, char *data, WAL_Lsn *lsn);
+extern WAL_Lsn getLogEnd (WAL_Log *log);
+
+/* durability, flushLog returns once every record up to lsn is on disk. Concurrent calls share one sync. */
+extern RC flushLog (WAL_Log *log, WAL_Lsn lsn);
+extern WAL_Lsn getFlushedLsn (WAL_Log *log);
+extern int getNumLogSyncs (WAL_Log *log);
+
+/* the records before lsn, a position returned by getLogEnd or appendLogRecord, are not needed any more */
+extern RC truncateLog (WAL_Log *log, WAL_Lsn lsn);
+
+/* apply every record in the log to the page file, sync it and truncate the log */
+extern RC recoverLog (WAL_Log *log, char *pageFileName);
+
+#endif
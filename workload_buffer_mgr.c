@@ -0,0 +1,294 @@
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define WORKLOAD_FILE "workloadbuffer.bin"
+
+// defaults for the arguments, a pool holding an eighth of the file
+#define DEFAULT_FRAMES 1024
+#define DEFAULT_PAGES 8192
+#define DEFAULT_OPS 200000
+#define DEFAULT_WRITE_PERCENT 10
+
+// skew of the zipfian workloads, the most popular page gets about 10% of the pins of 8192 pages
+#define ZIPF_THETA 0.99
+
+// the mixed workload starts a scan of SCAN_LENGTH consecutive pages instead of a lookup every SCAN_PERIOD ops
+#define SCAN_LENGTH 64
+#define SCAN_PERIOD 640
+
+// pins before the measurement starts, as a multiple of the pool size
+#define WARMUP_ROUNDS 4
+
+typedef enum Workload {
+  WL_UNIFORM = 0,
+  WL_ZIPF = 1,
+  WL_SCAN = 2,
+  WL_MIXED = 3,
+  WL_HINTED = 4
+} Workload;
+
+typedef struct WorkloadState {
+  Workload workload;
+  int numPages;
+  unsigned long long seed;
+  // zipf generator of Gray et al., "Quickly Generating Billion-Record Synthetic Databases"
+  double zetan;
+  double eta;
+  double alpha;
+  double half;
+  // position of the running scan and the pages it has left
+  int scanPage;
+  int scanLeft;
+  bool scanning;
+  long ops;
+} WorkloadState;
+
+static char *strategyNames[] = { "fifo", "lru", "clock", "lfu", "lru-k", "arc" };
+static char *workloadNames[] = { "uniform", "zipf", "scan", "mixed", "hinted" };
+
+#define NUM_STRATEGIES ((int) (sizeof(strategyNames) / sizeof(strategyNames[0])))
+#define NUM_WORKLOADS ((int) (sizeof(workloadNames) / sizeof(workloadNames[0])))
+
+// workloads
+static void runWorkload (ReplacementStrategy strategy, Workload workload, int numFrames, int numPages,
+			 int numOps, int writePercent);
+static void initWorkload (WorkloadState *state, Workload workload, int numPages);
+static int nextPage (WorkloadState *state);
+static int nextZipf (WorkloadState *state);
+
+// helper methods
+static int findName (char *name, char **names, int numNames);
+static double nowNanos (void);
+static double nextUniform (WorkloadState *state);
+static int compareDoubles (const void *a, const void *b);
+
+// main method, the arguments are the replacement strategy (fifo, lru, clock, lfu, lru-k, arc or all),
+// the workload (uniform, zipf, scan, mixed, hinted or all), the number of frames, the number of pages in the
+// file, the number of measured pins and the percentage of pins that dirty their page
+int
+main (int argc, char *argv[])
+{
+  int strategy = (argc > 1) ? findName(argv[1], strategyNames, NUM_STRATEGIES) : -1;
+  int workload = (argc > 2) ? findName(argv[2], workloadNames, NUM_WORKLOADS) : -1;
+  int numFrames = (argc > 3) ? atoi(argv[3]) : DEFAULT_FRAMES;
+  int numPages = (argc > 4) ? atoi(argv[4]) : DEFAULT_PAGES;
+  int numOps = (argc > 5) ? atoi(argv[5]) : DEFAULT_OPS;
+  int writePercent = (argc > 6) ? atoi(argv[6]) : DEFAULT_WRITE_PERCENT;
+  int s, w;
+
+  if (strategy == -2 || workload == -2 || numFrames < 1 || numPages < 1 || numOps < 1)
+    {
+      fprintf(stderr, "usage: %s [strategy|all] [workload|all] [frames] [pages] [ops] [write %%]\n", argv[0]);
+      return 1;
+    }
+
+  initStorageManager();
+
+  printf("%d frames, %d pages, %d pins, %d%% writes\n\n", numFrames, numPages, numOps, writePercent);
+  printf("%8s %8s %8s %10s %10s %12s %10s %10s %10s\n", "strategy", "workload", "hit %", "reads", "writes",
+	 "pins/s", "p50 ns", "p99 ns", "p999 ns");
+
+  for (s = 0; s < NUM_STRATEGIES; s++)
+    for (w = 0; w < NUM_WORKLOADS; w++)
+      if ((strategy < 0 || strategy == s) && (workload < 0 || workload == w))
+	runWorkload(s, w, numFrames, numPages, numOps, writePercent);
+
+  return 0;
+}
+
+// run one workload against a new pool on a file of numPages pages. The pool is warmed up first, then
+// every pin and unpin is timed and the I/O counters are compared before and after the measured pins.
+void
+runWorkload (ReplacementStrategy strategy, Workload workload, int numFrames, int numPages, int numOps,
+	     int writePercent)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  WorkloadState state;
+  BM_AccessRing ring;
+  double *latencies = malloc(sizeof(double) * numOps);
+  double start, elapsed, before;
+  int reads, writes, i;
+
+  // create the file at its full size, so the measured pins only read
+  CHECK(createPageFile(WORKLOAD_FILE));
+  CHECK(initBufferPool(bm, WORKLOAD_FILE, 1, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, numPages - 1));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(initBufferPool(bm, WORKLOAD_FILE, numFrames, strategy, NULL));
+  CHECK(initAccessRing(bm, &ring, (workload == WL_HINTED) ? BM_HINT_SCAN : BM_HINT_NORMAL, 0));
+  initWorkload(&state, workload, numPages);
+
+  for (i = 0; i < WARMUP_ROUNDS * numFrames; i++)
+    {
+      CHECK(pinPageHinted(bm, h, nextPage(&state), state.scanning ? &ring : NULL));
+      if (nextUniform(&state) * 100 < writePercent)
+	CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  reads = getNumReadIO(bm);
+  writes = getNumWriteIO(bm);
+
+  start = nowNanos();
+  for (i = 0; i < numOps; i++)
+    {
+      before = nowNanos();
+      CHECK(pinPageHinted(bm, h, nextPage(&state), state.scanning ? &ring : NULL));
+      if (nextUniform(&state) * 100 < writePercent)
+	CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+      latencies[i] = nowNanos() - before;
+    }
+  elapsed = nowNanos() - start;
+
+  reads = getNumReadIO(bm) - reads;
+  writes = getNumWriteIO(bm) - writes;
+  qsort(latencies, numOps, sizeof(double), compareDoubles);
+
+  printf("%8s %8s %8.2f %10i %10i %12.0f %10.0f %10.0f %10.0f\n", strategyNames[strategy],
+	 workloadNames[workload], 100.0 * (numOps - reads) / numOps, reads, writes, numOps / (elapsed / 1e9),
+	 latencies[numOps / 2], latencies[(long) numOps * 99 / 100], latencies[(long) numOps * 999 / 1000]);
+
+  CHECK(freeAccessRing(&ring));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile(WORKLOAD_FILE));
+
+  free(latencies);
+  free(bm);
+  free(h);
+}
+
+void
+initWorkload (WorkloadState *state, Workload workload, int numPages)
+{
+  double zeta2 = 1 + pow(0.5, ZIPF_THETA);
+  int i;
+
+  memset(state, 0, sizeof(WorkloadState));
+  state->workload = workload;
+  state->numPages = numPages;
+  state->seed = 42;
+
+  if (workload == WL_ZIPF || workload == WL_MIXED || workload == WL_HINTED)
+    {
+      for (i = 1; i <= numPages; i++)
+	state->zetan += 1 / pow(i, ZIPF_THETA);
+      state->alpha = 1 / (1 - ZIPF_THETA);
+      state->eta = (1 - pow(2.0 / numPages, 1 - ZIPF_THETA)) / (1 - zeta2 / state->zetan);
+      state->half = zeta2;
+    }
+}
+
+// the page of the next pin:
+// uniform, every page is equally likely
+// zipf, page i is pinned with a probability proportional to 1 / (i + 1)^ZIPF_THETA
+// scan, all pages in order, over and over
+// mixed, zipfian lookups, and every SCAN_PERIOD ops a scan of SCAN_LENGTH pages from a random page on
+// hinted, mixed with the scans pinned through a BM_HINT_SCAN ring
+int
+nextPage (WorkloadState *state)
+{
+  state->ops++;
+  state->scanning = false;
+
+  switch (state->workload)
+    {
+    case WL_UNIFORM:
+      return (int) (nextUniform(state) * state->numPages);
+    case WL_ZIPF:
+      return nextZipf(state);
+    case WL_SCAN:
+      state->scanPage = (state->scanPage + 1) % state->numPages;
+      return state->scanPage;
+    case WL_MIXED:
+    case WL_HINTED:
+      if (state->scanLeft == 0 && state->ops % SCAN_PERIOD == 0)
+	{
+	  state->scanPage = (int) (nextUniform(state) * state->numPages);
+	  state->scanLeft = SCAN_LENGTH;
+	}
+      if (state->scanLeft > 0)
+	{
+	  state->scanning = (state->workload == WL_HINTED);
+	  state->scanLeft--;
+	  state->scanPage = (state->scanPage + 1) % state->numPages;
+	  return state->scanPage;
+	}
+      return nextZipf(state);
+    }
+
+  return 0;
+}
+
+int
+nextZipf (WorkloadState *state)
+{
+  double u = nextUniform(state);
+  double uz = u * state->zetan;
+  int page;
+
+  if (uz < 1)
+    return 0;
+  if (uz < state->half)
+    return 1;
+
+  page = (int) (state->numPages * pow(state->eta * u - state->eta + 1, state->alpha));
+  return (page < state->numPages) ? page : state->numPages - 1;
+}
+
+// index of name in names, -1 for "all" and -2 for an unknown name
+int
+findName (char *name, char **names, int numNames)
+{
+  int i;
+
+  if (strcmp(name, "all") == 0)
+    return -1;
+  for (i = 0; i < numNames; i++)
+    if (strcmp(name, names[i]) == 0)
+      return i;
+
+  return -2;
+}
+
+double
+nowNanos (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// a random number in [0, 1), from a 64 bit xorshift
+double
+nextUniform (WorkloadState *state)
+{
+  unsigned long long x = state->seed;
+
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  state->seed = x;
+
+  return (x >> 11) * (1.0 / (1ULL << 53));
+}
+
+int
+compareDoubles (const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}